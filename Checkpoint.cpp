@@ -0,0 +1,308 @@
+#include "Base.h"
+#include "SSDPUtils.h"
+#include "Checkpoint.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define FS_CHECKPOINT_MAGIC     0x46534350  // "FSCP"
+#define FS_CHECKPOINT_VERSION   2           // 2: the master term follows the role
+#define FS_CHECKPOINT_HEAD_LEN  12          // magic, version, reserved, save time
+#define FS_CHECKPOINT_HASH_LEN  4
+
+/**
+ * @brief append big endian integers and length prefixed strings to the image
+ */
+static inline ORA_VOID PutUInt16( vector< ORA_UINT8 > &image, ORA_UINT16 value )
+{
+    image.push_back( static_cast< ORA_UINT8 >( value >> 8 ) );
+    image.push_back( static_cast< ORA_UINT8 >( value ) );
+}
+
+static inline ORA_VOID PutUInt32( vector< ORA_UINT8 > &image, ORA_UINT32 value )
+{
+    PutUInt16( image, static_cast< ORA_UINT16 >( value >> 16 ) );
+    PutUInt16( image, static_cast< ORA_UINT16 >( value ) );
+}
+
+static inline ORA_VOID PutString( vector< ORA_UINT8 > &image, const string &str )
+{
+    ORA_UINT16 len = str.size() < 0xFFFF ? str.size() : 0xFFFF;
+    PutUInt16( image, len );
+    image.insert( image.end(), str.begin(), str.begin() + len );
+}
+
+/**
+ * @brief read big endian integers and length prefixed strings from the image,
+ * a read beyond the image fails and leaves the cursor at the end.
+ */
+static inline ORA_BOOL GetUInt16( const ORA_UINT8 *pData, ORA_SIZE size, ORA_SIZE &pos, ORA_UINT16 &value )
+{
+    if( size - pos < 2 )
+    {
+        pos = size;
+        return ORA_FALSE;
+    }
+    value = ( pData[pos] << 8 ) | pData[pos + 1];
+    pos += 2;
+    return ORA_TRUE;
+}
+
+static inline ORA_BOOL GetUInt32( const ORA_UINT8 *pData, ORA_SIZE size, ORA_SIZE &pos, ORA_UINT32 &value )
+{
+    ORA_UINT16 high, low;
+    if( !GetUInt16( pData, size, pos, high ) || !GetUInt16( pData, size, pos, low ) )
+        return ORA_FALSE;
+    value = ( static_cast< ORA_UINT32 >( high ) << 16 ) | low;
+    return ORA_TRUE;
+}
+
+static inline ORA_BOOL GetString( const ORA_UINT8 *pData, ORA_SIZE size, ORA_SIZE &pos, string &str )
+{
+    ORA_UINT16 len;
+    if( !GetUInt16( pData, size, pos, len ) )
+        return ORA_FALSE;
+    if( size - pos < len )
+    {
+        pos = size;
+        return ORA_FALSE;
+    }
+    str.assign( reinterpret_cast< const ORA_CHAR* >( pData + pos ), len );
+    pos += len;
+    return ORA_TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: CCheckpoint
+/**
+ * @brief constructor
+ *
+ * @param pPath checkpoint file path
+ */
+CCheckpoint::CCheckpoint( const ORA_CHAR *pPath /* = FS_CHECKPOINT_FILE */ )
+{
+    ORA_ASSERT( pPath );
+    m_Path         = pPath;
+    m_Role         = 0;
+    m_Term         = 0;
+    m_LastSaveTime = 0;
+}
+
+CCheckpoint::~CCheckpoint()
+{
+    // Do nothing.
+}
+
+/**
+ * @brief load the checkpoint file
+ *
+ * @return ORA_TRUE if a valid checkpoint not older than FS_CHECKPOINT_MAX_AGE is loaded
+ */
+ORA_BOOL CCheckpoint::Load()
+{
+    ORA_INT hFile = open( m_Path.c_str(), O_RDONLY | O_CLOEXEC );
+    if( hFile < 0 )
+    {
+        if( errno != ENOENT )
+            printf( "Can't open checkpoint %s [%s]\n", m_Path.c_str(), strerror( errno ) );
+        return ORA_FALSE;
+    }
+
+    // 1. read the whole file, it is small
+    vector< ORA_UINT8 > image( FS_CHECKPOINT_MAX_SIZE );
+    ORA_SIZE size = 0;
+    while( size < image.size() )
+    {
+        ssize_t len = read( hFile, &image[size], image.size() - size );
+        if( len < 0 && errno == EINTR )
+            continue;
+        if( len <= 0 )
+            break;
+        size += len;
+    }
+    close( hFile );
+
+    // 2. parse it, nothing is kept from a broken or outdated checkpoint
+    if( !Parse( &image[0], size ) )
+    {
+        m_Role       = 0;
+        m_Term       = 0;
+        m_MasterInfo = MASTER_INFO();
+        m_Neighbors.clear();
+        return ORA_FALSE;
+    }
+
+    printf( "Checkpoint loaded: role %u, term %u, master %u (%s), %zu neighbors\n",
+            m_Role, m_Term, m_MasterInfo.DeviceID, m_MasterInfo.IPAddr.c_str(), m_Neighbors.size() );
+    return ORA_TRUE;
+}
+
+/**
+ * @brief write the checkpoint file, it is only rewritten when the content is changed,
+ * or it would become too old to be trusted.
+ *
+ * @param role       current role (CRoleManager::RoleStateType)
+ * @param term       the latest master term
+ * @param master     last master's information
+ * @param neighbors  confirmed SSDP neighbors
+ *
+ * @return ORA_TRUE if written successfully or not changed, otherwise return ORA_FALSE
+ */
+ORA_BOOL CCheckpoint::Save( ORA_UINT32 role, ORA_UINT32 term, const MASTER_INFO &master, const CNbrRecordList &neighbors )
+{
+    // 1. serialize the content
+    vector< ORA_UINT8 > body;
+    body.reserve( m_LastBody.size() );
+    PutUInt32( body, role );
+    PutUInt32( body, term );
+    PutUInt32( body, master.DeviceID );
+    PutString( body, master.IPAddr );
+
+    ORA_UINT32 count = neighbors.size() < FS_CHECKPOINT_MAX_NEIGHBORS ? neighbors.size() : FS_CHECKPOINT_MAX_NEIGHBORS;
+    PutUInt32( body, count );
+    for( ORA_UINT32 i = 0; i < count; i++ )
+    {
+        PutString( body, neighbors[i].Location );
+        PutString( body, neighbors[i].Usn );
+        PutString( body, neighbors[i].SmId );
+        PutString( body, neighbors[i].DeviceType );
+        PutUInt32( body, neighbors[i].IfAddr );
+    }
+
+    // 2. skip the write if nothing is changed, it saves the flash
+    ORA_INT64 currentTime = time( ORA_NULL );
+    if( body == m_LastBody && currentTime - m_LastSaveTime < FS_CHECKPOINT_MAX_AGE / 2 )
+    {
+        return ORA_TRUE;
+    }
+
+    if( !WriteFile( body, currentTime ) )
+    {
+        return ORA_FALSE;
+    }
+
+    m_LastBody.swap( body );
+    m_LastSaveTime = currentTime;
+    return ORA_TRUE;
+}
+
+/**
+ * @brief check and parse the checkpoint image
+ *
+ * @param pData checkpoint image
+ * @param size  image size
+ *
+ * @return ORA_TRUE if the checkpoint is valid and not outdated
+ */
+ORA_BOOL CCheckpoint::Parse( const ORA_UINT8 *pData, ORA_SIZE size )
+{
+    // 1. check the hash, then the header
+    if( size < FS_CHECKPOINT_HEAD_LEN + FS_CHECKPOINT_HASH_LEN )
+        return ORA_FALSE;
+
+    ORA_SIZE   pos = size - FS_CHECKPOINT_HASH_LEN;
+    ORA_UINT32 hash;
+    GetUInt32( pData, size, pos, hash );
+    size -= FS_CHECKPOINT_HASH_LEN;
+    if( hash != CSSDPUtils::Hash( reinterpret_cast< const ORA_CHAR* >( pData ), size ) )
+    {
+        printf( "Checkpoint %s is broken, ignored\n", m_Path.c_str() );
+        return ORA_FALSE;
+    }
+
+    ORA_UINT32 magic, saveTime;
+    ORA_UINT16 version, reserved;
+    pos = 0;
+    GetUInt32( pData, size, pos, magic );
+    GetUInt16( pData, size, pos, version );
+    GetUInt16( pData, size, pos, reserved );
+    GetUInt32( pData, size, pos, saveTime );
+    if( magic != FS_CHECKPOINT_MAGIC || version != FS_CHECKPOINT_VERSION )
+        return ORA_FALSE;
+
+    ORA_INT64 age = time( ORA_NULL ) - static_cast< ORA_INT64 >( saveTime );
+    if( age < 0 || age > FS_CHECKPOINT_MAX_AGE )
+    {
+        printf( "Checkpoint %s is %llds old, ignored\n", m_Path.c_str(), static_cast< long long >( age ) );
+        return ORA_FALSE;
+    }
+
+    // 2. role, term and master
+    ORA_UINT32 masterID, count;
+    if( !GetUInt32( pData, size, pos, m_Role ) ||
+            !GetUInt32( pData, size, pos, m_Term ) ||
+            !GetUInt32( pData, size, pos, masterID ) ||
+            !GetString( pData, size, pos, m_MasterInfo.IPAddr ) ||
+            !GetUInt32( pData, size, pos, count ) ||
+            count > FS_CHECKPOINT_MAX_NEIGHBORS )
+        return ORA_FALSE;
+    m_MasterInfo.DeviceID = masterID;
+
+    // 3. neighbors
+    m_Neighbors.resize( count );
+    for( ORA_UINT32 i = 0; i < count; i++ )
+    {
+        SSDP_NBR_RECORD_T &record = m_Neighbors[i];
+        if( !GetString( pData, size, pos, record.Location ) ||
+                !GetString( pData, size, pos, record.Usn ) ||
+                !GetString( pData, size, pos, record.SmId ) ||
+                !GetString( pData, size, pos, record.DeviceType ) ||
+                !GetUInt32( pData, size, pos, record.IfAddr ) )
+            return ORA_FALSE;
+    }
+
+    return pos == size;
+}
+
+/**
+ * @brief write the checkpoint to a temporary file, and rename it to the checkpoint file
+ *
+ * @param body      serialized content
+ * @param saveTime  s, current time
+ *
+ * @return ORA_TRUE if written successfully, otherwise return ORA_FALSE
+ */
+ORA_BOOL CCheckpoint::WriteFile( const vector< ORA_UINT8 > &body, ORA_INT64 saveTime )
+{
+    vector< ORA_UINT8 > image;
+    image.reserve( FS_CHECKPOINT_HEAD_LEN + body.size() + FS_CHECKPOINT_HASH_LEN );
+    PutUInt32( image, FS_CHECKPOINT_MAGIC );
+    PutUInt16( image, FS_CHECKPOINT_VERSION );
+    PutUInt16( image, 0 );
+    PutUInt32( image, static_cast< ORA_UINT32 >( saveTime ) );
+    image.insert( image.end(), body.begin(), body.end() );
+    PutUInt32( image, CSSDPUtils::Hash( reinterpret_cast< const ORA_CHAR* >( &image[0] ), image.size() ) );
+
+    string tmpPath = m_Path + ".tmp";
+    ORA_INT hFile = open( tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR );
+    if( hFile < 0 )
+    {
+        printf( "Can't open checkpoint %s [%s]\n", tmpPath.c_str(), strerror( errno ) );
+        return ORA_FALSE;
+    }
+
+    ORA_SIZE written = 0;
+    while( written < image.size() )
+    {
+        ssize_t len = write( hFile, &image[written], image.size() - written );
+        if( len < 0 && errno == EINTR )
+            continue;
+        if( len <= 0 )
+            break;
+        written += len;
+    }
+
+    ORA_BOOL bDone = written == image.size() && fsync( hFile ) == 0;
+    close( hFile );
+    if( !bDone || rename( tmpPath.c_str(), m_Path.c_str() ) != 0 )
+    {
+        printf( "Can't write checkpoint %s [%s]\n", m_Path.c_str(), strerror( errno ) );
+        unlink( tmpPath.c_str() );
+        return ORA_FALSE;
+    }
+
+    return ORA_TRUE;
+}
+// END: CCheckpoint
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,112 @@
+#ifndef __FS_CHECKPOINT_H__
+#define __FS_CHECKPOINT_H__
+
+#include "SSDPNeighbor.h"
+#include "RSEvent.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define FS_CHECKPOINT_FILE          "/var/lib/fastsetupd.ckpt"
+#define FS_CHECKPOINT_INTERVAL      ( 30 * 1000 )   ///< ms, how often the checkpoint is written
+#define FS_CHECKPOINT_MAX_AGE       ( 10 * 60 )     ///< s, an older checkpoint is not trusted
+#define FS_CHECKPOINT_MAX_SIZE      ( 256 * 1024 )  ///< bytes
+#define FS_CHECKPOINT_MAX_NEIGHBORS 1024
+
+typedef vector< SSDP_NBR_RECORD_T > CNbrRecordList;
+
+/**
+ * @name CCheckpoint the state kept across daemon restarts: the SSDP neighbors, the last master
+ * information and the last role. it is written periodically and at shutdown, and loaded at start,
+ * where the entries are only hints until the network re-confirms them.
+ *
+ * @note the file is binary, big endian, and ends with a hash of its content:
+ * magic, version, save time, role, master term, master id, master ip, neighbor count, neighbors.
+ * it is replaced atomically by rename(), so a crash while writing keeps the previous one.
+ * @{ */
+class CCheckpoint
+{
+// Constructor & Destructor
+public:
+    /**
+     * @brief constructor
+     *
+     * @param pPath checkpoint file path
+     */
+    CCheckpoint( const ORA_CHAR *pPath = FS_CHECKPOINT_FILE );
+    ~CCheckpoint();
+
+// Operations
+public:
+    /**
+     * @brief load the checkpoint file
+     *
+     * @return ORA_TRUE if a valid checkpoint not older than FS_CHECKPOINT_MAX_AGE is loaded
+     */
+    ORA_BOOL Load();
+
+    /**
+     * @brief write the checkpoint file, it is only rewritten when the content is changed,
+     * or it would become too old to be trusted.
+     *
+     * @param role       current role (CRoleManager::RoleStateType)
+     * @param term       the latest master term
+     * @param master     last master's information
+     * @param neighbors  confirmed SSDP neighbors
+     *
+     * @return ORA_TRUE if written successfully or not changed, otherwise return ORA_FALSE
+     */
+    ORA_BOOL Save( ORA_UINT32 role, ORA_UINT32 term, const MASTER_INFO &master, const CNbrRecordList &neighbors );
+
+    /**
+     * @brief the role of the loaded checkpoint
+     */
+    inline ORA_UINT32 GetRole() const
+    {
+        return m_Role;
+    }
+
+    /**
+     * @brief the master term of the loaded checkpoint
+     */
+    inline ORA_UINT32 GetTerm() const
+    {
+        return m_Term;
+    }
+
+    /**
+     * @brief the master's information of the loaded checkpoint
+     */
+    inline const MASTER_INFO& GetMasterInfo() const
+    {
+        return m_MasterInfo;
+    }
+
+    /**
+     * @brief the SSDP neighbors of the loaded checkpoint
+     */
+    inline const CNbrRecordList& GetNeighbors() const
+    {
+        return m_Neighbors;
+    }
+
+// Assistants
+private:
+    ORA_BOOL Parse( const ORA_UINT8 *pData, ORA_SIZE size );
+    ORA_BOOL WriteFile( const vector< ORA_UINT8 > &body, ORA_INT64 saveTime );
+
+// Properties
+private:
+    string              m_Path;         ///< checkpoint file path
+    ORA_UINT32          m_Role;         ///< loaded role
+    ORA_UINT32          m_Term;         ///< loaded master term
+    MASTER_INFO         m_MasterInfo;   ///< loaded master's information
+    CNbrRecordList      m_Neighbors;    ///< loaded SSDP neighbors
+    vector< ORA_UINT8 > m_LastBody;     ///< content written last, without the header
+    ORA_INT64           m_LastSaveTime; ///< s, when the checkpoint is written last
+};
+/**  @} */
+
+#endif /* __FS_CHECKPOINT_H__ */
@@ -5,8 +5,9 @@
 // BEG: CDaemon
 CDaemon::CDaemon()
 {
-    m_pConfig         = ORA_NULL;
-    m_hWaitingForExit = ORA_NULL;
+    m_pConfig          = ORA_NULL;
+    m_hWaitingForExit  = ORA_NULL;
+    m_hCheckpointTimer = ORA_NULL;
 }
 
 CDaemon::~CDaemon()
@@ -37,8 +38,18 @@ ORA_BOOL CDaemon::Start()
             goto ERR;
 
         m_pNwSrv->BindNwDataReceiver( m_pRoleManager );
+        m_pRoleManager->SetStateCallback( RoleStateHandler, this );
 
         m_DeviceID = m_pConfig->GetDeviceID();
+        m_pRoleManager->SetDeviceID( static_cast< DEVICE_ID_T >( m_DeviceID ) );
+
+        // warm start from the checkpoint of the last run
+        if( m_Checkpoint.Load() )
+        {
+            m_pRoleManager->SetWarmStart( static_cast< CRoleManager::RoleStateType >( m_Checkpoint.GetRole() ),
+                                          m_Checkpoint.GetTerm(), m_Checkpoint.GetMasterInfo() );
+            m_pNwSrv->SetRestoredNeighbors( m_Checkpoint.GetNeighbors() );
+        }
 
         RegisterListener( m_pIPCCtrl );
         RegisterListener( m_pNwSrv );
@@ -57,11 +68,16 @@ ORA_BOOL CDaemon::Start()
 
         if( !m_pNwSrv->Start() )
             goto ERR;
+
+        m_hCheckpointTimer = ORACreateTimer( CheckpointHandler, this );
+        ORASetTimer( m_hCheckpointTimer, FS_CHECKPOINT_INTERVAL );
+        return ORA_TRUE;
     }
 
 ERR:
     if( m_pRoleManager )
     {
+        m_pNwSrv->BindNwDataReceiver( ORA_NULL );
         m_pRoleManager->Stop();
         delete m_pRoleManager;
         m_pRoleManager = ORA_NULL;
@@ -83,9 +99,15 @@ ERR:
 ORA_VOID CDaemon::Stop()
 {
     ORA_ASSERT( m_pRoleManager );
+    ORADestroyTimer( m_hCheckpointTimer );
+    m_hCheckpointTimer = ORA_NULL;
+    SaveCheckpoint();
+
+    // nothing is queued to the role manager any more when it stops
     UnregisterListener( m_pRoleManager );
     m_pNwSrv->UnregisterListener( m_pRoleManager );
     m_pIPCCtrl->UnregisterListener( m_pRoleManager );
+    m_pNwSrv->BindNwDataReceiver( ORA_NULL );
     m_pRoleManager->Stop();
     delete m_pRoleManager;
     m_pRoleManager = ORA_NULL;
@@ -132,7 +154,9 @@ ORA_VOID CDaemon::OnMsgProcedure( const _MSG_HEAD *pMsg )
             // TODO: Request IPCCtrl to close BLE
 
             // TODO: Change Role State to NO_ROLE;
-            m_pRoleManager->SetState( CRoleManager::RST_NO_ROLE );
+            // a master announces the address of this device on the private mesh
+            m_pRoleManager->SetDeviceAddress( m_pNwSrv->GetMeshIpAddr() );
+            m_pRoleManager->PostState( CRoleManager::RST_NO_ROLE );
         }
         break;
     }
@@ -162,5 +186,64 @@ ORA_VOID CDaemon::OnMsgProcedure( const _MSG_HEAD *pMsg )
         ORA_ASSERT( ORA_FALSE );
     };
 }
+
+/**
+ * @brief write the SSDP neighbors, the master's information and the role to the checkpoint
+ */
+ORA_VOID CDaemon::SaveCheckpoint()
+{
+    ORA_ASSERT( m_pRoleManager );
+    ORA_ASSERT( m_pNwSrv );
+
+    // the role thread changes them meanwhile, take a consistent copy
+    CRoleManager::RoleStateType role;
+    ORA_UINT32                  term;
+    MASTER_INFO                 info;
+    m_pRoleManager->GetRoleSnapshot( role, term, info );
+
+    CNbrRecordList neighbors;
+    m_pNwSrv->GetNeighborRecords( neighbors );
+    m_Checkpoint.Save( role, term, info, neighbors );
+}
+
+/**
+ * @brief write the checkpoint periodically
+ *
+ * @param hTimer    timer handler
+ * @param pContext  context of CDaemon
+ */
+ORA_VOID CDaemon::CheckpointHandler( ORA_HTIMER hTimer, ORA_VOID *pContext )
+{
+    ORA_ASSERT( pContext );
+    reinterpret_cast< CDaemon* >( pContext )->SaveCheckpoint();
+    ORASetTimer( hTimer, FS_CHECKPOINT_INTERVAL );
+}
+
+/**
+ * @brief tell the SSDP discovery whether the role is resolved, called in the role thread
+ *
+ * @param state     the new role state
+ * @param pContext  context of CDaemon
+ */
+ORA_VOID CDaemon::RoleStateHandler( CRoleManager::RoleStateType state, ORA_VOID *pContext )
+{
+    ORA_ASSERT( pContext );
+    CNetworkService *pNwSrv = reinterpret_cast< CDaemon* >( pContext )->m_pNwSrv;
+    switch( state )
+    {
+    case CRoleManager::RST_SLAVE:
+    case CRoleManager::RST_MASTER:
+        pNwSrv->SetRoleResolved( ORA_TRUE );
+        break;
+
+    case CRoleManager::RST_NO_ROLE:
+        pNwSrv->SetRoleResolved( ORA_FALSE );
+        break;
+
+    default:
+        // PRE_ROLE and DEFINER are on the way from NO_ROLE, still unresolved
+        break;
+    }
+}
 // END: CDaemon
 //////////////////////////////////////////////////////////////////////////////
@@ -6,6 +6,7 @@
 #include "Profile.h"
 #include "IPCCtrl.h"
 #include "RoleState.h"
+#include "Checkpoint.h"
 
 /**
  * @name CDaemon the daemon process for FastSetup
@@ -64,6 +65,31 @@ public:
 private:
     ORA_VOID OnMsgProcedure( const _MSG_HEAD *pMsg );
 
+// Assistants
+private:
+    /**
+     * @brief write the SSDP neighbors, the master's information and the role to the checkpoint
+     */
+    ORA_VOID SaveCheckpoint();
+
+// Callbacks
+private:
+    /**
+     * @brief write the checkpoint periodically
+     *
+     * @param hTimer    timer handler
+     * @param pContext  context of CDaemon
+     */
+    static ORA_VOID CheckpointHandler( ORA_HTIMER hTimer, ORA_VOID *pContext );
+
+    /**
+     * @brief tell the SSDP discovery whether the role is resolved, called in the role thread
+     *
+     * @param state     the new role state
+     * @param pContext  context of CDaemon
+     */
+    static ORA_VOID RoleStateHandler( CRoleManager::RoleStateType state, ORA_VOID *pContext );
+
 // Properties
 private:
     CNetworkService *m_pNwSrv;
@@ -72,6 +98,8 @@ private:
     ORA_HEVENT       m_hWaitingForExit;
     ORA_UINT64       m_DeviceID;
     CRoleManager    *m_pRoleManager;
+    CCheckpoint      m_Checkpoint;       ///< state kept across daemon restarts
+    ORA_HTIMER       m_hCheckpointTimer;
 
     mutable ORA_CRITICAL_SECTION m_PropLock;
 };
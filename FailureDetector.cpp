@@ -0,0 +1,136 @@
+#include "Base.h"
+#include "FailureDetector.h"
+
+#include <math.h>
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: CFailureDetector
+/**
+ * @brief constructor
+ *
+ * @param minStdDev ms, the floor of the standard deviation
+ * @param pause     ms, the silence which is accepted on top of the mean
+ */
+CFailureDetector::CFailureDetector( ORA_UINT32 minStdDev, ORA_UINT32 pause )
+{
+    m_MinStdDev = minStdDev ? minStdDev : 1;
+    m_Pause     = pause;
+    Reset( 1000 );
+}
+
+/**
+ * @brief forget the monitored node, the window is seeded with the expected interval.
+ * the monitoring starts with the next Heartbeat().
+ *
+ * @param interval  ms, the heartbeat interval expected before any is measured
+ */
+ORA_VOID CFailureDetector::Reset( ORA_UINT32 interval )
+{
+    m_Count         = 0;
+    m_Next          = 0;
+    m_Sum           = 0;
+    m_SumSquares    = 0;
+    m_LastHeartbeat = 0;
+
+    // the first heartbeats are judged by the expected interval, +/- a quarter of it
+    AddSample( interval - interval / 4 );
+    AddSample( interval + interval / 4 );
+}
+
+/**
+ * @brief a heartbeat of the monitored node arrived
+ *
+ * @param now   ms, RoleGetTickMs()
+ */
+ORA_VOID CFailureDetector::Heartbeat( ORA_UINT64 now )
+{
+    // the first heartbeat after Reset() only starts the clock
+    if( m_LastHeartbeat == 0 )
+    {
+        m_LastHeartbeat = now ? now : 1;
+        return;
+    }
+
+    ORA_UINT64 interval = now > m_LastHeartbeat ? now - m_LastHeartbeat : 0;
+    AddSample( static_cast< ORA_UINT32 >( interval < FD_MAX_INTERVAL ? interval : FD_MAX_INTERVAL ) );
+    m_LastHeartbeat = now;
+}
+
+/**
+ * @brief the suspicion level of the monitored node
+ *
+ * @param now   ms, RoleGetTickMs()
+ *
+ * @return phi
+ */
+double CFailureDetector::Phi( ORA_UINT64 now ) const
+{
+    double mean, stdDev;
+    GetDistribution( mean, stdDev );
+
+    // the logistic approximation of the normal distribution's tail, as Cassandra and Akka use it
+    double elapsed = static_cast< double >( now > m_LastHeartbeat ? now - m_LastHeartbeat : 0 );
+    double y       = ( elapsed - mean ) / stdDev;
+    double e       = exp( -y * ( 1.5976 + 0.070566 * y * y ) );
+    double pLater  = elapsed > mean ? e / ( 1.0 + e ) : 1.0 - 1.0 / ( 1.0 + e );
+    return pLater > 0 ? -log10( pLater ) : FD_PHI_MAX;
+}
+
+/**
+ * @brief the silence after the last heartbeat which reaches a suspicion level
+ *
+ * @param threshold phi, at least 1
+ *
+ * @return ms after the last heartbeat
+ */
+ORA_UINT32 CFailureDetector::SuspectAfter( double threshold ) const
+{
+    ORA_ASSERT( threshold >= 1 );
+    double mean, stdDev;
+    GetDistribution( mean, stdDev );
+
+    // Phi() inverted: 0.070566 y^3 + 1.5976 y + ln( p / ( 1 - p ) ) = 0 with p = 10^-threshold,
+    // the cubic is monotonic, its only real root comes from Cardano's formula.
+    double pLater = pow( 10.0, -threshold );
+    double p      = 1.5976 / 0.070566;
+    double q      = log( pLater / ( 1.0 - pLater ) ) / 0.070566;
+    double root   = sqrt( q * q / 4 + p * p * p / 27 );
+    double y      = cbrt( -q / 2 + root ) + cbrt( -q / 2 - root );
+
+    // round up, the suspicion is reached by then
+    return static_cast< ORA_UINT32 >( ceil( mean + y * stdDev ) );
+}
+
+ORA_VOID CFailureDetector::AddSample( ORA_UINT32 interval )
+{
+    // the window is full: the oldest sample leaves the sums
+    if( m_Count == FD_WINDOW_SIZE )
+    {
+        ORA_UINT64 oldest = m_Samples[m_Next];
+        m_Sum        -= oldest;
+        m_SumSquares -= oldest * oldest;
+    }
+    else
+    {
+        m_Count++;
+    }
+
+    m_Samples[m_Next] = interval;
+    m_Sum            += interval;
+    m_SumSquares     += static_cast< ORA_UINT64 >( interval ) * interval;
+    m_Next            = ( m_Next + 1 ) % FD_WINDOW_SIZE;
+}
+
+ORA_VOID CFailureDetector::GetDistribution( double &mean, double &stdDev ) const
+{
+    ORA_ASSERT( m_Count > 0 );
+    double average  = static_cast< double >( m_Sum ) / m_Count;
+    double variance = static_cast< double >( m_SumSquares ) / m_Count - average * average;
+    stdDev = variance > 0 ? sqrt( variance ) : 0;
+    if( stdDev < m_MinStdDev )
+        stdDev = m_MinStdDev;
+
+    mean = average + m_Pause;
+}
+// END: CFailureDetector
+//////////////////////////////////////////////////////////////////////////////
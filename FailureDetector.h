@@ -0,0 +1,116 @@
+#ifndef __FAILURE_DETECTOR_H__
+#define __FAILURE_DETECTOR_H__
+
+#include <time.h>
+
+#define FD_WINDOW_SIZE      32          ///< inter-arrival samples kept per monitored node
+#define FD_MAX_INTERVAL     ( 60 * 1000 )   ///< ms, a longer silence is sampled as this
+#define FD_PHI_MAX          100.0       ///< the suspicion level once the probability underflows
+
+#ifdef ROLE_TICK_CLOCK
+ORA_UINT64 ROLE_TICK_CLOCK();           ///< the simulator's virtual clock, see Simulator/Makefile
+#endif
+
+/**
+ * @brief the monotonic clock the heartbeats are timed with
+ *
+ * @return ms
+ */
+static inline ORA_UINT64 RoleGetTickMs()
+{
+#ifdef ROLE_TICK_CLOCK
+    return ROLE_TICK_CLOCK();
+#else
+    timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return static_cast< ORA_UINT64 >( now.tv_sec ) * 1000 + now.tv_nsec / 1000000;
+#endif
+}
+
+/**
+ * @name CFailureDetector a phi accrual failure detector of one monitored node.
+ *
+ * @note the inter-arrival times of its heartbeats are kept in a fixed sliding window, with their
+ * sum and sum of squares updated on every heartbeat, so the mean and the variance cost O(1).
+ * the suspicion level phi is -log10 of the probability that the next heartbeat comes later
+ * than now, under a normal distribution of the window; a quiet mesh is suspected sooner than
+ * a lossy one. the expected pause is added to the mean, so a single lost heartbeat is not
+ * suspected.
+ * @{ */
+class CFailureDetector
+{
+// Constructor & Destructor
+public:
+    /**
+     * @brief constructor
+     *
+     * @param minStdDev ms, the floor of the standard deviation, a too regular window would
+     *                  suspect on the slightest delay
+     * @param pause     ms, the silence which is accepted on top of the mean
+     */
+    CFailureDetector( ORA_UINT32 minStdDev, ORA_UINT32 pause );
+
+// Operations
+public:
+    /**
+     * @brief forget the monitored node, the window is seeded with the expected interval.
+     * the monitoring starts with the next Heartbeat().
+     *
+     * @param interval  ms, the heartbeat interval expected before any is measured
+     */
+    ORA_VOID Reset( ORA_UINT32 interval );
+
+    /**
+     * @brief a heartbeat of the monitored node arrived
+     *
+     * @param now   ms, RoleGetTickMs()
+     */
+    ORA_VOID Heartbeat( ORA_UINT64 now );
+
+    /**
+     * @brief the suspicion level of the monitored node
+     *
+     * @param now   ms, RoleGetTickMs()
+     *
+     * @return phi, 1 means a 10% chance that the heartbeat is still coming, 2 means 1%, ...
+     */
+    double Phi( ORA_UINT64 now ) const;
+
+    /**
+     * @brief the silence after the last heartbeat which reaches a suspicion level
+     *
+     * @param threshold phi, at least 1
+     *
+     * @return ms after the last heartbeat
+     */
+    ORA_UINT32 SuspectAfter( double threshold ) const;
+
+    /**
+     * @brief the arrival of the last heartbeat
+     *
+     * @return ms, RoleGetTickMs()
+     */
+    inline ORA_UINT64 GetLastHeartbeat() const
+    {
+        return m_LastHeartbeat;
+    }
+
+// Assistants
+private:
+    ORA_VOID AddSample( ORA_UINT32 interval );
+    ORA_VOID GetDistribution( double &mean, double &stdDev ) const;
+
+// Properties
+private:
+    ORA_UINT32  m_Samples[FD_WINDOW_SIZE];  ///< ring of the inter-arrival times, ms
+    ORA_UINT32  m_Count;                    ///< valid samples
+    ORA_UINT32  m_Next;                     ///< the slot the next sample replaces
+    ORA_UINT64  m_Sum;                      ///< of the valid samples, exact
+    ORA_UINT64  m_SumSquares;               ///< of the valid samples, exact
+    ORA_UINT64  m_LastHeartbeat;            ///< ms, 0 before the first heartbeat
+    ORA_UINT32  m_MinStdDev;
+    ORA_UINT32  m_Pause;
+};
+/**  @} */
+
+#endif /* __FAILURE_DETECTOR_H__ */
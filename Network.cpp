@@ -2,9 +2,13 @@
 #include "Network.h"
 #include "Daemon.h"
 
+#include <ifaddrs.h>    // getifaddrs, freeifaddrs
+#include <arpa/inet.h>  // inet_addr, inet_ntop
+
 #define PUBLIC_MESH_ESSID_PREFIX  "ora_mesh_"
 #define PRIVATE_MESH_ESSID_PREFIX "unique_ssid_ora_mesh_"
 #define DEFAULT_MESH_CHANNEL      6
+#define DEFAULT_MESH_INTERFACE    "mesh0"   ///< the mesh interface until it holds the mesh IP address
 
 ///////////////////////////////////////////////////////////////////////////////
 // BEG: CNetworkService
@@ -22,11 +26,13 @@ CNetworkService::CNetworkService(CDaemon *pDaemon)
     m_PublicNwStat = NCS_NONE;
     m_hMsgSyncEvent = ORA_NULL;
     m_pDataRecv = ORA_NULL;
+    m_pSSDPService = ORA_NULL;
+    ORAInitializeCriticalSection( &m_DataRecvLock );
 }
 
 CNetworkService::~CNetworkService()
 {
-    // do nothing.
+    ORADeleteCriticalSection( &m_DataRecvLock );
 }
 
 /**
@@ -53,26 +59,6 @@ ORA_BOOL CNetworkService::Start()
         m_UserID       = m_pConfig->GetUserID();
         m_GroupID      = m_pConfig->GetGroupID();
 
-        SSDP_CONTEXT_T ssdpContext =
-        {
-            .Interface =
-            {
-                .search_target       = "ST_P2P",
-                .unique_service_name = "f835dd000001",
-                .sm_id               = "700000123",
-                .device_type         = "DEV_TYPE",
-                .location.suffix     = ":5678"
-            },
-
-            // callback
-            .NeighborFoundCallback  = NeighborDeviceFound,
-            .NeighborLostCallback   = NeighborDeviceLost,
-            .PacketReceivedCallback = RecvDataPacket
-        };
-
-        m_pSSDPService = new CSSDPService( &ssdpContext );
-        ORA_ASSERT( m_pSSDPService );
-
         m_PublicMeshInfo = m_pConfig->GetPublicMeshInfo();
         if( !m_PublicMeshInfo.IsValid() )
         {
@@ -90,6 +76,30 @@ ORA_BOOL CNetworkService::Start()
         }
 
         m_PrivMeshInfo = m_pConfig->GetPrivMeshInfo();
+
+        SSDP_CONTEXT_T ssdpContext =
+        {
+            .Header =
+            {
+                .SearchTarget   = "ST_P2P",
+                .Usn            = "f835dd000001",
+                .SmId           = "700000123",
+                .DeviceType     = "DEV_TYPE",
+                .LocationSuffix = ":5678"
+            },
+
+            // callback
+            .NeighborFoundCallback  = NeighborDeviceFound,
+            .NeighborLostCallback   = NeighborDeviceLost,
+            .PacketReceivedCallback = RecvDataPacket
+        };
+
+        // SSDP runs on the interface of the mesh to join, it follows the mesh from JoinMeshNetwork on;
+        // the service keeps its own copy of the context
+        GetMeshInterfaces( m_PrivMeshInfo.IsValid() ? m_PrivMeshInfo : m_PublicMeshInfo, ssdpContext.Interfaces );
+        m_pSSDPService = new CSSDPService( ssdpContext );
+        ORA_ASSERT( m_pSSDPService );
+
         if( m_PrivMeshInfo.IsValid() )
         {
             m_PrivNwStat = NCS_CONNECTING;
@@ -101,7 +111,14 @@ ORA_BOOL CNetworkService::Start()
             JoinMeshNetwork( m_PublicMeshInfo );
         }
 
-        m_pSSDPService->join();
+        // the discovery backs off toward the profile interval of the joined mesh once it's stable
+        ORA_INT32 interval = m_PrivMeshInfo.IsValid() ? m_pConfig->GetVisibleInterval() : m_pConfig->GetScanningInterval();
+        m_pSSDPService->SSDPSetStableInterval( interval > 0 ? interval * 1000 : 0 );
+
+        // warm start: the neighbors of the last run are probed first
+        m_pSSDPService->SSDPRestoreNeighbors( m_RestoredNeighbors );
+        m_RestoredNeighbors.clear();
+        m_pSSDPService->SSDPJoin();
 
         return ORA_TRUE;
     }
@@ -144,6 +161,8 @@ ORA_BOOL CNetworkService::ValidateAPConnection( const AP_INFO &apInfo )
  */
 ORA_VOID CNetworkService::BindNwDataReceiver( INwDataReceiver *recv )
 {
+    // a packet being delivered to the previous receiver is waited for
+    CORASectionLock lock( m_DataRecvLock );
     m_pDataRecv = recv;
 }
 
@@ -170,6 +189,49 @@ NwConnStat CNetworkService::GetAPConnStatus()
     return m_APConnStat;
 }
 
+/**
+ * @brief Get the confirmed SSDP neighbors for the checkpoint
+ *
+ * @param records receives the neighbors
+ */
+ORA_VOID CNetworkService::GetNeighborRecords( CNbrRecordList &records ) const
+{
+    records.clear();
+    if( m_pSSDPService )
+        m_pSSDPService->SSDPGetNeighbors( records );
+}
+
+/**
+ * @brief Set the SSDP neighbors of the checkpoint, they are restored as stale when the service starts
+ *
+ * @param records neighbors of the checkpoint
+ */
+ORA_VOID CNetworkService::SetRestoredNeighbors( const CNbrRecordList &records )
+{
+    m_RestoredNeighbors = records;
+}
+
+/**
+ * @brief tell the SSDP discovery whether the role of this device is resolved
+ *
+ * @param bResolved ORA_TRUE from SLAVE or MASTER, ORA_FALSE from NO_ROLE
+ */
+ORA_VOID CNetworkService::SetRoleResolved( ORA_BOOL bResolved )
+{
+    if( m_pSSDPService )
+        m_pSSDPService->SSDPSetRoleResolved( bResolved );
+}
+
+/**
+ * @brief get the IP address of this device on the mesh: the private one once it's known
+ *
+ * @return IP address
+ */
+string CNetworkService::GetMeshIpAddr() const
+{
+    return m_PrivMeshInfo.IsValid() ? m_PrivMeshInfo.IpAddr : m_PublicMeshInfo.IpAddr;
+}
+
 /**
  * @brief Make device is visible on the public mesh network,
  * and scan current environment if exists private mesh network
@@ -178,7 +240,7 @@ ORA_VOID CNetworkService::ScanNetwork()
 {
     NotifyEvent( FS_MSG_IPC_SCAN_PRIV_MESH() );
     // TODO: start SSDP scanning ... (Timeout impl within SSDP)
-    m_pSSDPService->SendMSearch();
+    m_pSSDPService->SSDPSendMsearch();
     // INwDeviceDiscory interface need be used within SSDP for different status.
 }
 
@@ -215,6 +277,7 @@ ORA_VOID CNetworkService::CreatePrivMesh()
  */
 ORA_VOID CNetworkService::RecvDataPacket( const DEVICE_ID_T &sender, const ORA_VOID *pPacket, ORA_SIZE size )
 {
+    CORASectionLock lock( m_DataRecvLock );
     if( m_pDataRecv )
         m_pDataRecv->RecvDataPacket( sender, pPacket, size );
 }
@@ -341,6 +404,58 @@ ORA_VOID CNetworkService::JoinMeshNetwork( const MESH_INFO &mInfo )
     ORAResetEvent( m_hMsgSyncEvent );
     NotifyEvent( FS_MSG_IPC_START_MESH() );
     ORAWaitEvent( m_hMsgSyncEvent );
+
+    // SSDP follows the mesh interface, which holds the mesh IP address now
+    if( m_pSSDPService )
+    {
+        vector< CSSDPService::SSDP_IF_T > interfaces;
+        GetMeshInterfaces( mInfo, interfaces );
+        m_pSSDPService->SSDPNetworkInterfaceUpdate( interfaces );
+    }
+}
+
+/**
+ * @brief get the interface SSDP runs on for a mesh: the one which holds the mesh IP address.
+ * before the mesh is started, it is DEFAULT_MESH_INTERFACE with the configured address, SSDP tracks it
+ * by name and opens its sockets once it is up.
+ *
+ * @param mInfo         mesh info
+ * @param interfaces    receives the interface
+ */
+ORA_VOID CNetworkService::GetMeshInterfaces( const MESH_INFO &mInfo, vector< CSSDPService::SSDP_IF_T > &interfaces ) const
+{
+    interfaces.clear();
+
+    CSSDPService::SSDP_IF_T ifc;
+    ifc.Name    = DEFAULT_MESH_INTERFACE;
+    ifc.Ip      = mInfo.IpAddr;
+    ifc.Addr    = inet_addr( mInfo.IpAddr.c_str() );
+    ifc.Netmask = inet_addr( mInfo.SubMask.c_str() );
+
+    struct ifaddrs *pAddrs = ORA_NULL;
+    if( getifaddrs( &pAddrs ) != 0 )
+    {
+        printf("getifaddrs failed, errno = %s (%d)\n", strerror(errno), errno);
+    }
+
+    for( struct ifaddrs *pAddr = pAddrs; pAddr != ORA_NULL; pAddr = pAddr->ifa_next )
+    {
+        if( pAddr->ifa_addr == ORA_NULL || pAddr->ifa_addr->sa_family != AF_INET || pAddr->ifa_name == ORA_NULL )
+            continue;
+
+        if( ((struct sockaddr_in *)pAddr->ifa_addr)->sin_addr.s_addr != ifc.Addr )
+            continue;
+
+        ifc.Name = pAddr->ifa_name;
+        if( pAddr->ifa_netmask != ORA_NULL )
+            ifc.Netmask = ((struct sockaddr_in *)pAddr->ifa_netmask)->sin_addr.s_addr;
+        break;
+    }
+
+    if( pAddrs != ORA_NULL )
+        freeifaddrs( pAddrs );
+
+    interfaces.push_back( ifc );
 }
 
 ORA_VOID CNetworkService::LeaveMeshNetwork()
@@ -4,6 +4,7 @@
 #include "Common.h"
 #include "Profile.h"
 #include "CommService.h"
+#include "Checkpoint.h"
 
 class CDaemon;
 class CNetworkService : public CCommService, public INwDeviceDiscovery, public INwDataReceiver
@@ -46,8 +47,9 @@ public:
 
     /**
      * @brief Bind the network data receiver for receiving data
+     * @note it returns after the packet being delivered to the previous receiver, if any.
      *
-     * @param recv  INwDataReceiver interface.
+     * @param recv  INwDataReceiver interface, ORA_NULL to unbind it.
      */
     ORA_VOID BindNwDataReceiver( INwDataReceiver *recv );
 
@@ -64,6 +66,35 @@ public:
      */
     NwConnStat GetAPConnStatus();
 
+    /**
+     * @brief Get the confirmed SSDP neighbors for the checkpoint
+     *
+     * @param records receives the neighbors
+     */
+    ORA_VOID GetNeighborRecords( CNbrRecordList &records ) const;
+
+    /**
+     * @brief Set the SSDP neighbors of the checkpoint, they are restored as stale when the service starts
+     * @note the function should be called before Start().
+     *
+     * @param records neighbors of the checkpoint
+     */
+    ORA_VOID SetRestoredNeighbors( const CNbrRecordList &records );
+
+    /**
+     * @brief tell the SSDP discovery whether the role of this device is resolved
+     *
+     * @param bResolved ORA_TRUE from SLAVE or MASTER, ORA_FALSE from NO_ROLE
+     */
+    ORA_VOID SetRoleResolved( ORA_BOOL bResolved );
+
+    /**
+     * @brief get the IP address of this device on the mesh: the private one once it's known
+     *
+     * @return IP address
+     */
+    string GetMeshIpAddr() const;
+
 // Overrides
 public:
     /**
@@ -137,6 +168,7 @@ private:
     ORA_VOID PrivateMeshNetworkFound( const MESH_INFO &mInfo );
     ORA_VOID JoinMeshNetwork( const MESH_INFO &mInfo );
     ORA_VOID LeaveMeshNetwork();
+    ORA_VOID GetMeshInterfaces( const MESH_INFO &mInfo, vector< CSSDPService::SSDP_IF_T > &interfaces ) const;
 
 // Thread Routines
 private:
@@ -165,12 +197,14 @@ private:
     ORA_BOOL         m_bApValid;
 
     CNwNeighborList  m_NeighborList;
+    CNbrRecordList   m_RestoredNeighbors;  ///< SSDP neighbors of the checkpoint, until the service starts
 
     ORA_HTHREAD      m_hMsgProcedureThread;
     ORA_HTIMER       m_hTimer;
     INwDataReceiver *m_pDataRecv;
     NwConnStat       m_APConnStat;
     mutable ORA_CRITICAL_SECTION m_NeighborListLock;  ///< Lock m_NeighborList
+    mutable ORA_CRITICAL_SECTION m_DataRecvLock;      ///< Lock m_pDataRecv, held while a packet is delivered
     mutable ORA_HEVENT m_hMsgSyncEvent;
 
     CSSDPService    *m_pSSDPService;
@@ -16,6 +16,13 @@ enum RoleEventID
 
     REID_FETACH_AP_RSSI,
     REID_FETACH_AP_RSSI_RESP,
+
+    REID_MASTER_HEARTBEAT,
+    REID_SLAVE_ALIVE,
+
+    REID_EVENT_COUNT,   ///< the RoleEventID's total amount
+
+    REID_EVENT_BUNDLE = 0x7FFF  ///< an envelope of events, unpacked on receipt and never dispatched
 };
 
 struct MASTER_INFO
@@ -39,6 +46,7 @@ struct MASTER_INFO
     {
         DeviceID = info.DeviceID;
         IPAddr   = info.IPAddr;
+        return *this;
     }
 };
 
@@ -57,58 +65,75 @@ enum RSEventType
 #define ROLE_EVENT_ID_FLAG  0x5EA7  ///< REVT - id flag for identifying if the data is a role event.
 /**
  * @name ROLE_EVENT base role event structure
+ * @note the header is kept in the host order, it is put on the wire by CRoleEventCodec in
+ * its compact form. the data of the events is kept big-endian as it goes on the wire.
  * @{ */
 struct _ORA_ALIGN( 1 ) ROLE_EVENT
 {
+    friend class CRoleEventCodec;
+
 // Properties
 private:
     ORA_UINT16  IdFlag;     ///< always equal '0x5EA7' - id flag for identifying if the data is a role event.
     ORA_UINT16  Id;         ///< Event ID
     DEVICE_ID_T Sender;     ///< Sender's device id type
     ORA_UINT32  Type;       ///< Event???
+    ORA_UINT32  Term;       ///< the latest master term the sender knows, stamped when it is encoded
     ORA_SIZE    DataSize;   ///< the event data's size, exclude the event header
 
 // Construct
 protected:
     ROLE_EVENT( ORA_UINT16 eId, DEVICE_ID_T sender, RSEventType evtType, ORA_SIZE datSize )
     {
-        IdFlag   = ORA_UINT16_TO_BE( ROLE_EVENT_ID_FLAG );
-        Id       = ORA_UINT16_TO_BE( eId );
-        Sender   = ORA_UINT32_TO_BE( sender );
-        Type     = ORA_UINT32_TO_BE( evtType );
-        DataSize = ORA_UINT32_TO_BE( datSize - sizeof( ROLE_EVENT ) );
+        IdFlag   = ROLE_EVENT_ID_FLAG;
+        Id       = eId;
+        Sender   = sender;
+        Type     = evtType;
+        Term     = 0;
+        DataSize = datSize - sizeof( ROLE_EVENT );
+    }
+
+private:
+    ROLE_EVENT()
+    {
+        // the decoder fills it
     }
 
 // Getter & Setter
 public:
     inline ORA_BOOL IsValid() const
     {
-        return ORA_BE_TO_UINT16( IdFlag ) == ROLE_EVENT_ID_FLAG;
+        return IdFlag == ROLE_EVENT_ID_FLAG;
     }
 
     inline ORA_UINT16 GetEventID() const
     {
-        return ORA_BE_TO_UINT16( Id );
+        return Id;
     }
 
     inline DEVICE_ID_T GetSender() const
     {
-        return ORA_BE_TO_UINT32( Sender );
+        return Sender;
     }
 
     inline RSEventType GetEventType() const
     {
-        return static_cast< RSEventType >( ORA_BE_TO_UINT32( Type ) );
+        return static_cast< RSEventType >( Type );
+    }
+
+    inline ORA_UINT32 GetTerm() const
+    {
+        return Term;
     }
 
     inline ORA_VOID SetDataSize( ORA_SIZE size )
     {
-        DataSize = ORA_UINT32_TO_BE( size );
+        DataSize = size;
     }
 
     inline ORA_SIZE GetDataSize() const
     {
-        return ORA_BE_TO_UINT32( DataSize );
+        return DataSize;
     }
 };
 /**  @} */
@@ -131,14 +156,195 @@ private:
     ORA_UINT32 DeviceID;
     ORA_CHAR   IpAddr[ IPADDR_LEN ];
 
+// Construct
+public:
+    REVENT_MASTER_DETECTED( DEVICE_ID_T sender, const MASTER_INFO &info )
+        : ROLE_EVENT( REID_MASTER_DETECTED, sender, ET_BROADCAST, sizeof( REVENT_MASTER_DETECTED ) )
+    {
+        DeviceID = ORA_UINT32_TO_BE( info.DeviceID );
+        memset( IpAddr, 0, sizeof( IpAddr ) );
+        strncpy( IpAddr, info.IPAddr.c_str(), sizeof( IpAddr ) - 1 );
+    }
+
+// Getters & Setters
+public:
+    /**
+     * @brief copy the master's information into info, the string keeps its capacity.
+     *
+     * @param info receives the master's information
+     */
+    ORA_VOID GetMasterInfo( MASTER_INFO &info ) const
+    {
+        info.DeviceID = ORA_BE_TO_UINT32( DeviceID );
+        info.IPAddr.assign( IpAddr, strnlen( IpAddr, sizeof( IpAddr ) ) );
+    }
+};
+
+struct REVENT_SET_MASTER_INFO : public ROLE_EVENT
+{
+// Construct
+public:
+    REVENT_SET_MASTER_INFO( DEVICE_ID_T sender )
+        : ROLE_EVENT( REID_SET_MASTER_INFO, sender, ET_UNICAST, sizeof( REVENT_SET_MASTER_INFO ) )
+    {
+        // Do nothing.
+    }
+};
+
+struct REVENT_FETACH_AP_RSSI : public ROLE_EVENT
+{
+// Construct
+public:
+    REVENT_FETACH_AP_RSSI( DEVICE_ID_T sender )
+        : ROLE_EVENT( REID_FETACH_AP_RSSI, sender, ET_BROADCAST, sizeof( REVENT_FETACH_AP_RSSI ) )
+    {
+        // Do nothing.
+    }
+};
+
+struct REVENT_FETACH_AP_RSSI_RESP : public ROLE_EVENT
+{
+//properties
+private:
+    ORA_UINT32 RSSI;    ///< dBm, the smoothed AP RSSI of the sender
+
+// Construct
+public:
+    REVENT_FETACH_AP_RSSI_RESP( DEVICE_ID_T sender, ORA_INT32 rssi )
+        : ROLE_EVENT( REID_FETACH_AP_RSSI_RESP, sender, ET_UNICAST, sizeof( REVENT_FETACH_AP_RSSI_RESP ) )
+    {
+        RSSI = ORA_UINT32_TO_BE( static_cast< ORA_UINT32 >( rssi ) );
+    }
+
+// Getters & Setters
+public:
+    inline ORA_INT32 GetRSSI() const
+    {
+        return static_cast< ORA_INT32 >( ORA_BE_TO_UINT32( RSSI ) );
+    }
+};
+
+struct REVENT_DEFINER_DETECTED : public ROLE_EVENT
+{
+// Construct
+public:
+    REVENT_DEFINER_DETECTED( DEVICE_ID_T sender )
+        : ROLE_EVENT( REID_DEFINER_DETECTED, sender, ET_BROADCAST, sizeof( REVENT_DEFINER_DETECTED ) )
+    {
+        // Do nothing.
+    }
+};
+
+#define ROLE_SUCCESSOR_COUNT    3   ///< the slaves a master ranks to take over from it
+
+/**
+ * @name REVENT_MASTER_HEARTBEAT the periodic announcement of the master, the term is the
+ * header's. it ranks the slaves which take over when the heartbeats stop: the first one
+ * after the missed-heartbeat window, each next one a heartbeat interval later.
+ * @{ */
+struct REVENT_MASTER_HEARTBEAT : public ROLE_EVENT
+{
+//properties
+private:
+    ORA_UINT32 DeviceID;
+    ORA_CHAR   IpAddr[ IPADDR_LEN ];
+    ORA_UINT32 Beat;                                ///< counts the heartbeats of the term
+    ORA_UINT32 Successors[ ROLE_SUCCESSOR_COUNT ];  ///< ranked successors, 0 for none
+
+// Construct
+public:
+    REVENT_MASTER_HEARTBEAT( DEVICE_ID_T sender, const MASTER_INFO &info, ORA_UINT32 beat,
+                             const DEVICE_ID_T *pSuccessors, ORA_UINT32 count )
+        : ROLE_EVENT( REID_MASTER_HEARTBEAT, sender, ET_BROADCAST, sizeof( REVENT_MASTER_HEARTBEAT ) )
+    {
+        DeviceID = ORA_UINT32_TO_BE( info.DeviceID );
+        memset( IpAddr, 0, sizeof( IpAddr ) );
+        strncpy( IpAddr, info.IPAddr.c_str(), sizeof( IpAddr ) - 1 );
+        Beat = ORA_UINT32_TO_BE( beat );
+        for( ORA_UINT32 i = 0; i < ROLE_SUCCESSOR_COUNT; i++ )
+            Successors[i] = ORA_UINT32_TO_BE( i < count ? pSuccessors[i] : 0 );
+    }
+
 // Getters & Setters
 public:
-    const MASTER_INFO* GetMasterInfo() const
+    /**
+     * @brief copy the master's information into info, the string keeps its capacity.
+     *
+     * @param info receives the master's information
+     */
+    ORA_VOID GetMasterInfo( MASTER_INFO &info ) const
+    {
+        info.DeviceID = ORA_BE_TO_UINT32( DeviceID );
+        info.IPAddr.assign( IpAddr, strnlen( IpAddr, sizeof( IpAddr ) ) );
+    }
+
+    inline ORA_UINT32 GetBeat() const
     {
-        MASTER_INFO *pInfo = new MASTER_INFO(DeviceID, IpAddr);
-        return pInfo;
+        return ORA_BE_TO_UINT32( Beat );
+    }
+
+    /**
+     * @brief the rank of a device among the successors
+     *
+     * @param id    device id
+     *
+     * @return 1 for the first successor, 0 if the device is not ranked
+     */
+    ORA_UINT32 GetSuccessorRank( DEVICE_ID_T id ) const
+    {
+        for( ORA_UINT32 i = 0; i < ROLE_SUCCESSOR_COUNT; i++ )
+        {
+            if( ORA_BE_TO_UINT32( Successors[i] ) == id )
+                return i + 1;
+        }
+        return 0;
     }
 };
+/**  @} */
+
+/**
+ * @name REVENT_SLAVE_ALIVE unicast by a slave to its master when it joins, and by a ranked
+ * successor on every heartbeat, so the master ranks live slaves only.
+ * @{ */
+struct REVENT_SLAVE_ALIVE : public ROLE_EVENT
+{
+//properties
+private:
+    ORA_UINT32 Beat;    ///< the heartbeat answered
+
+// Construct
+public:
+    REVENT_SLAVE_ALIVE( DEVICE_ID_T sender, ORA_UINT32 beat )
+        : ROLE_EVENT( REID_SLAVE_ALIVE, sender, ET_UNICAST, sizeof( REVENT_SLAVE_ALIVE ) )
+    {
+        Beat = ORA_UINT32_TO_BE( beat );
+    }
+
+// Getters & Setters
+public:
+    inline ORA_UINT32 GetBeat() const
+    {
+        return ORA_BE_TO_UINT32( Beat );
+    }
+};
+/**  @} */
+
+/**
+ * @name REVENT_BUNDLE the envelope of the events coalesced into one datagram: the header is
+ * followed by the encoded events back to back, each with its own header, and its data size
+ * covers them all, so the datagram is sized like any other event.
+ * @{ */
+struct REVENT_BUNDLE : public ROLE_EVENT
+{
+// Construct
+public:
+    REVENT_BUNDLE( DEVICE_ID_T sender, RSEventType evtType, ORA_SIZE eventsSize )
+        : ROLE_EVENT( REID_EVENT_BUNDLE, sender, evtType, sizeof( REVENT_BUNDLE ) )
+    {
+        SetDataSize( eventsSize );
+    }
+};
+/**  @} */
 
 struct REVENT_TIMEOUT: public ROLE_EVENT
 {
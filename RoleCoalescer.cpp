@@ -0,0 +1,114 @@
+#include "Base.h"
+#include "RoleCoalescer.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: CRoleCoalescer
+/**
+ * @brief constructor
+ *
+ * @param pDelivery the network data delivery interface.
+ */
+CRoleCoalescer::CRoleCoalescer( INwDataDelivery *pDelivery )
+{
+    ORA_ASSERT( pDelivery );
+    m_pDelivery    = pDelivery;
+    m_Sender       = 0;
+    m_Pending      = 0;
+    m_Since        = 0;
+    m_Term         = 0;
+    m_Stats.Events = 0;
+    m_Stats.Frames = 0;
+}
+
+/**
+ * @brief copy the event into the buffer of its destination with the term stamped on it
+ *
+ * @param bBroadcast    to all the devices, or to target only
+ * @param target        the target device id of a unicast
+ * @param event         the event data
+ * @param term          the master term to stamp
+ * @param now           ms, RoleGetTickMs()
+ */
+ORA_VOID CRoleCoalescer::Add( ORA_BOOL bBroadcast, DEVICE_ID_T target, const ROLE_EVENT &event, ORA_UINT32 term, ORA_UINT64 now )
+{
+    // 1. find the batch of the destination
+    ROLE_BATCH *pBatch = ORA_NULL;
+    for( ORA_UINT32 i = 0; i < m_Pending; i++ )
+    {
+        if( m_Batches[i].bBroadcast == bBroadcast && ( bBroadcast || m_Batches[i].Target == target ) )
+        {
+            pBatch = &m_Batches[i];
+            break;
+        }
+    }
+
+    if( pBatch == ORA_NULL )
+    {
+        // a new destination, all the buffers are taken: make room
+        if( m_Pending == ROLE_COALESCE_TARGETS )
+            Flush();
+
+        if( m_Pending == 0 )
+            m_Since = now;
+
+        pBatch = &m_Batches[m_Pending++];
+        pBatch->bBroadcast = bBroadcast;
+        pBatch->Target     = target;
+        pBatch->Count      = 0;
+        pBatch->Size       = 0;
+    }
+
+    // 2. encode it behind the room of the bundle header, a full batch leaves first
+    ORA_SIZE size = CRoleEventCodec::Encode( event, term, pBatch->Data + ROLE_WIRE_HEADER_MAX + pBatch->Size,
+                                             ROLE_COALESCE_MTU - ROLE_WIRE_HEADER_MAX - pBatch->Size );
+    if( size == 0 )
+    {
+        FlushBatch( *pBatch );
+        size = CRoleEventCodec::Encode( event, term, pBatch->Data + ROLE_WIRE_HEADER_MAX,
+                                        ROLE_COALESCE_MTU - ROLE_WIRE_HEADER_MAX );
+        ORA_ASSERT( size > 0 );
+    }
+
+    pBatch->Count++;
+    pBatch->Size += size;
+    m_Term = term;
+}
+
+/**
+ * @brief send all the buffers
+ */
+ORA_VOID CRoleCoalescer::Flush()
+{
+    for( ORA_UINT32 i = 0; i < m_Pending; i++ )
+        FlushBatch( m_Batches[i] );
+    m_Pending = 0;
+}
+
+ORA_VOID CRoleCoalescer::FlushBatch( ROLE_BATCH &batch )
+{
+    if( batch.Count == 0 )
+        return;
+
+    // a lone event goes as it is, several go behind the bundle header, right before them
+    ORA_UINT8 *pPacket = batch.Data + ROLE_WIRE_HEADER_MAX;
+    if( batch.Count > 1 )
+    {
+        ORA_UINT8     header[ROLE_WIRE_HEADER_MAX];
+        REVENT_BUNDLE bundle( m_Sender, batch.bBroadcast ? ET_BROADCAST : ET_UNICAST, batch.Size );
+        ORA_SIZE      size = CRoleEventCodec::EncodeHeader( bundle, m_Term, header, sizeof( header ) );
+        pPacket -= size;
+        memcpy( pPacket, header, size );
+    }
+
+    if( batch.bBroadcast )
+        m_pDelivery->BroadcastDataPacket( pPacket );
+    else
+        m_pDelivery->UnicastDataPacket( batch.Target, pPacket );
+
+    m_Stats.Events += batch.Count;
+    m_Stats.Frames++;
+    batch.Count = 0;
+    batch.Size  = 0;
+}
+// END: CRoleCoalescer
+//////////////////////////////////////////////////////////////////////////////
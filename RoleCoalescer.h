@@ -0,0 +1,113 @@
+#ifndef __ROLE_COALESCER_H__
+#define __ROLE_COALESCER_H__
+
+#include "Network.h"
+#include "RSEvent.h"
+#include "RoleEventCodec.h"
+
+#define ROLE_COALESCE_MTU       1400    ///< bytes, the largest datagram of coalesced events
+#define ROLE_COALESCE_WINDOW    5       ///< ms, the longest an event waits for company
+#define ROLE_COALESCE_TARGETS   4       ///< destinations buffered at once, the broadcast included
+
+/* Struct : ROLE_COALESCE_STATS, counters of the coalescer */
+typedef struct ROLE_COALESCE_STATS
+{
+    ORA_UINT64  Events;     // events sent
+    ORA_UINT64  Frames;     // datagrams they were sent in
+}ROLE_COALESCE_STATS_T;
+
+/**
+ * @name CRoleCoalescer packs the events bound for the same destination into one datagram.
+ *
+ * @note the events are encoded into a buffer per destination, and sent when the buffer is
+ * full, when the oldest event waited ROLE_COALESCE_WINDOW, or when the role thread flushes
+ * them before it goes idle. a buffer of one event is sent as the plain event, several are
+ * sent behind a REVENT_BUNDLE header. it is used by the role thread only.
+ * @{ */
+class CRoleCoalescer
+{
+// Constructor & Destructor
+public:
+    /**
+     * @brief constructor
+     *
+     * @param pDelivery the network data delivery interface.
+     */
+    CRoleCoalescer( INwDataDelivery *pDelivery );
+
+// Operations
+public:
+    /**
+     * @brief set the device id the bundles are sent with
+     *
+     * @param id    device id
+     */
+    inline ORA_VOID SetSender( DEVICE_ID_T id )
+    {
+        m_Sender = id;
+    }
+
+    /**
+     * @brief encode the event into the buffer of its destination with the term stamped on it
+     *
+     * @param bBroadcast    to all the devices, or to target only
+     * @param target        the target device id of a unicast
+     * @param event         the event data
+     * @param term          the master term to stamp
+     * @param now           ms, RoleGetTickMs()
+     */
+    ORA_VOID Add( ORA_BOOL bBroadcast, DEVICE_ID_T target, const ROLE_EVENT &event, ORA_UINT32 term, ORA_UINT64 now );
+
+    /**
+     * @brief send the buffers whose oldest event has waited the window
+     *
+     * @param now   ms, RoleGetTickMs()
+     */
+    inline ORA_VOID FlushDue( ORA_UINT64 now )
+    {
+        if( m_Pending && now - m_Since >= ROLE_COALESCE_WINDOW )
+            Flush();
+    }
+
+    /**
+     * @brief send all the buffers
+     */
+    ORA_VOID Flush();
+
+    /**
+     * @brief get the counters
+     */
+    inline ROLE_COALESCE_STATS_T GetStats() const
+    {
+        return m_Stats;
+    }
+
+// Assistant Structure
+private:
+    /* the encoded events waiting for one destination, Data starts with the room of the bundle header */
+    struct ROLE_BATCH
+    {
+        ORA_BOOL    bBroadcast;
+        DEVICE_ID_T Target;
+        ORA_UINT32  Count;
+        ORA_SIZE    Size;       ///< of the encoded events, the header excluded
+        ORA_UINT8   Data[ROLE_COALESCE_MTU];
+    };
+
+// Assistants
+private:
+    ORA_VOID FlushBatch( ROLE_BATCH &batch );
+
+// Properties
+private:
+    INwDataDelivery      *m_pDelivery;
+    DEVICE_ID_T           m_Sender;
+    ROLE_BATCH            m_Batches[ROLE_COALESCE_TARGETS];
+    ORA_UINT32            m_Pending;        ///< batches in use, they are the first ones
+    ORA_UINT64            m_Since;          ///< ms, the oldest pending event was added then
+    ORA_UINT32            m_Term;           ///< the latest term stamped, the bundles carry it too
+    ROLE_COALESCE_STATS_T m_Stats;
+};
+/**  @} */
+
+#endif /* __ROLE_COALESCER_H__ */
@@ -0,0 +1,213 @@
+#ifndef __ROLE_EVENT_CODEC_H__
+#define __ROLE_EVENT_CODEC_H__
+
+#include "RSEvent.h"
+
+#include <new>
+
+#define ROLE_WIRE_MAGIC         0xE0    ///< the high nibble of the first byte of a role event on the wire
+#define ROLE_WIRE_VERSION       1       ///< the low nibble, a decoder drops the versions it doesn't know
+#define ROLE_WIRE_VARINT_MAX    5       ///< bytes of a 32-bit varint
+#define ROLE_WIRE_HEADER_MAX    ( 1 + 4 + 4 * ROLE_WIRE_VARINT_MAX )   ///< flag, sender and 4 varints
+#define ROLE_WIRE_PACKET_MAX    0xFFFF  ///< the largest datagram
+
+/* Struct : ROLE_WIRE_HEADER, a decoded header, in the host order */
+typedef struct ROLE_WIRE_HEADER
+{
+    ORA_UINT16  Id;
+    DEVICE_ID_T Sender;
+    ORA_UINT32  Type;
+    ORA_UINT32  Term;
+    ORA_SIZE    DataSize;   // the event data which follows the header
+    ORA_SIZE    Size;       // of the encoded header
+}ROLE_WIRE_HEADER_T;
+
+/**
+ * @name CRoleEventCodec the wire form of the role events.
+ *
+ * @note the header is a flag byte (magic and version), the id and the type as varints, the
+ * sender as 4 big-endian bytes, then the term and the data size as varints: 9 bytes for an
+ * event of an early term without data. the event data follows as it is, it is big-endian
+ * already. the varints are LEB128: 7 bits a byte, the low ones first, the high bit set on
+ * all the bytes but the last one.
+ * @{ */
+class CRoleEventCodec
+{
+// Operations
+public:
+    /**
+     * @brief encode the header of an event, its data is not copied
+     *
+     * @param event     the event, its data size is the one encoded
+     * @param term      the master term to stamp
+     * @param pOut      the buffer
+     * @param capacity  of the buffer
+     *
+     * @return the bytes written, 0 if they don't fit
+     */
+    static inline ORA_SIZE EncodeHeader( const ROLE_EVENT &event, ORA_UINT32 term, ORA_UINT8 *pOut, ORA_SIZE capacity )
+    {
+        ORA_UINT8 header[ROLE_WIRE_HEADER_MAX];
+        ORA_UINT8 *p = header;
+
+        *p++ = ROLE_WIRE_MAGIC | ROLE_WIRE_VERSION;
+        p    = PutVarint( p, event.Id );
+        p    = PutVarint( p, event.Type );
+        *p++ = static_cast< ORA_UINT8 >( event.Sender >> 24 );
+        *p++ = static_cast< ORA_UINT8 >( event.Sender >> 16 );
+        *p++ = static_cast< ORA_UINT8 >( event.Sender >> 8 );
+        *p++ = static_cast< ORA_UINT8 >( event.Sender );
+        p    = PutVarint( p, term );
+        p    = PutVarint( p, static_cast< ORA_UINT32 >( event.DataSize ) );
+
+        ORA_SIZE size = p - header;
+        if( size > capacity )
+            return 0;
+
+        memcpy( pOut, header, size );
+        return size;
+    }
+
+    /**
+     * @brief encode an event with its data
+     *
+     * @param event     the event
+     * @param term      the master term to stamp
+     * @param pOut      the buffer
+     * @param capacity  of the buffer
+     *
+     * @return the bytes written, 0 if they don't fit
+     */
+    static inline ORA_SIZE Encode( const ROLE_EVENT &event, ORA_UINT32 term, ORA_UINT8 *pOut, ORA_SIZE capacity )
+    {
+        ORA_SIZE size = EncodeHeader( event, term, pOut, capacity );
+        if( size == 0 || event.DataSize > capacity - size )
+            return 0;
+
+        memcpy( pOut + size, reinterpret_cast< const ORA_UINT8* >( &event ) + sizeof( ROLE_EVENT ), event.DataSize );
+        return size + event.DataSize;
+    }
+
+    /**
+     * @brief decode the header of an encoded event
+     *
+     * @param pIn       the encoded event
+     * @param size      the bytes available
+     * @param header    receives the header
+     *
+     * @return ORA_TRUE if the header is valid and its data is within size
+     */
+    static inline ORA_BOOL DecodeHeader( const ORA_UINT8 *pIn, ORA_SIZE size, ROLE_WIRE_HEADER_T &header )
+    {
+        const ORA_UINT8 *p    = pIn;
+        const ORA_UINT8 *pEnd = pIn + size;
+        ORA_UINT32 id, type, dataSize;
+
+        if( p == pEnd || *p++ != ( ROLE_WIRE_MAGIC | ROLE_WIRE_VERSION ) )
+            return ORA_FALSE;
+
+        if( !GetVarint( p, pEnd, id ) || id > 0xFFFF || !GetVarint( p, pEnd, type ) || pEnd - p < 4 )
+            return ORA_FALSE;
+
+        header.Sender = static_cast< DEVICE_ID_T >( p[0] ) << 24 | static_cast< DEVICE_ID_T >( p[1] ) << 16 |
+                        static_cast< DEVICE_ID_T >( p[2] ) << 8  | p[3];
+        p += 4;
+
+        if( !GetVarint( p, pEnd, header.Term ) || !GetVarint( p, pEnd, dataSize ) )
+            return ORA_FALSE;
+
+        header.Id       = static_cast< ORA_UINT16 >( id );
+        header.Type     = type;
+        header.DataSize = dataSize;
+        header.Size     = p - pIn;
+        return dataSize <= static_cast< ORA_SIZE >( pEnd - p );
+    }
+
+    /**
+     * @brief build the event header in memory, the data is to be copied behind it
+     *
+     * @param header    the decoded header
+     * @param pEvent    sizeof( ROLE_EVENT ) bytes at least
+     */
+    static inline ORA_VOID ToEvent( const ROLE_WIRE_HEADER_T &header, ORA_VOID *pEvent )
+    {
+        ROLE_EVENT *pHeader = new ( pEvent ) ROLE_EVENT;
+        pHeader->IdFlag   = ROLE_EVENT_ID_FLAG;
+        pHeader->Id       = header.Id;
+        pHeader->Sender   = header.Sender;
+        pHeader->Type     = header.Type;
+        pHeader->Term     = header.Term;
+        pHeader->DataSize = header.DataSize;
+    }
+
+    /**
+     * @brief decode an event with its data
+     *
+     * @param pIn       the encoded event
+     * @param size      the bytes available
+     * @param pOut      receives the event as its struct
+     * @param capacity  of pOut
+     *
+     * @return the encoded bytes taken, 0 if the event is malformed or doesn't fit
+     */
+    static inline ORA_SIZE Decode( const ORA_UINT8 *pIn, ORA_SIZE size, ORA_UINT8 *pOut, ORA_SIZE capacity )
+    {
+        ROLE_WIRE_HEADER_T header;
+        if( !DecodeHeader( pIn, size, header ) || capacity < sizeof( ROLE_EVENT ) ||
+            header.DataSize > capacity - sizeof( ROLE_EVENT ) )
+            return 0;
+
+        ToEvent( header, pOut );
+        memcpy( pOut + sizeof( ROLE_EVENT ), pIn + header.Size, header.DataSize );
+        return header.Size + header.DataSize;
+    }
+
+    /**
+     * @brief the size of an encoded packet, for the transports which only get the pointer
+     * @note the packet is trusted, it is one of ours on its way out
+     *
+     * @param pPacket   the encoded event
+     *
+     * @return bytes, the header included
+     */
+    static inline ORA_SIZE PacketSize( const ORA_VOID *pPacket )
+    {
+        ROLE_WIRE_HEADER_T header;
+        ORA_BOOL bValid = DecodeHeader( reinterpret_cast< const ORA_UINT8* >( pPacket ), ROLE_WIRE_PACKET_MAX, header );
+        ORA_ASSERT( bValid );
+        return bValid ? header.Size + header.DataSize : 0;
+    }
+
+// Assistants
+private:
+    static inline ORA_UINT8* PutVarint( ORA_UINT8 *p, ORA_UINT32 value )
+    {
+        while( value >= 0x80 )
+        {
+            *p++    = static_cast< ORA_UINT8 >( value | 0x80 );
+            value >>= 7;
+        }
+        *p++ = static_cast< ORA_UINT8 >( value );
+        return p;
+    }
+
+    static inline ORA_BOOL GetVarint( const ORA_UINT8 *&p, const ORA_UINT8 *pEnd, ORA_UINT32 &value )
+    {
+        value = 0;
+        for( ORA_UINT32 shift = 0; p < pEnd && shift < 7 * ROLE_WIRE_VARINT_MAX; shift += 7 )
+        {
+            ORA_UINT8 byte = *p++;
+            // the 5th byte holds the top 4 bits only
+            if( shift == 28 && byte > 0x0F )
+                return ORA_FALSE;
+
+            value |= static_cast< ORA_UINT32 >( byte & 0x7F ) << shift;
+            if( !( byte & 0x80 ) )
+                return ORA_TRUE;
+        }
+        return ORA_FALSE;
+    }
+};
+/**  @} */
+
+#endif /* __ROLE_EVENT_CODEC_H__ */
@@ -0,0 +1,216 @@
+#include "Base.h"
+#include "RoleEventQueue.h"
+
+#include <sys/eventfd.h>
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: CRoleEventQueue
+CRoleEventQueue::CRoleEventQueue()
+    : m_Cells( ROLE_EVENT_QUEUE_LEN )
+{
+    for( ORA_UINT32 i = 0; i < ROLE_EVENT_QUEUE_LEN; i++ )
+        m_Cells[i].Seq.store( i, memory_order_relaxed );
+
+    m_EnqueuePos.store( 0, memory_order_relaxed );
+    m_DequeuePos.store( 0, memory_order_relaxed );
+    m_bSleeping.store( ORA_FALSE, memory_order_relaxed );
+    m_EventFd = -1;
+
+    m_Posted.store( 0, memory_order_relaxed );
+    m_Processed.store( 0, memory_order_relaxed );
+    for( ORA_UINT32 i = 0; i < RQP_PRIORITY_COUNT; i++ )
+        m_Shed[i].store( 0, memory_order_relaxed );
+    m_Oversized.store( 0, memory_order_relaxed );
+    m_MaxDepth.store( 0, memory_order_relaxed );
+}
+
+CRoleEventQueue::~CRoleEventQueue()
+{
+    Close();
+}
+
+/**
+ * @brief create the eventfd for waking up the consumer
+ *
+ * @return ORA_TRUE if created successfully, otherwise return ORA_FALSE
+ */
+ORA_BOOL CRoleEventQueue::Create()
+{
+    ORA_ASSERT( m_EventFd < 0 );
+    m_EventFd = eventfd( 0, EFD_CLOEXEC );
+    if( m_EventFd < 0 )
+    {
+        printf( "create role eventfd failed [%s]\n", strerror( errno ) );
+        return ORA_FALSE;
+    }
+    return ORA_TRUE;
+}
+
+/**
+ * @brief close the eventfd, the queued items are dropped
+ */
+ORA_VOID CRoleEventQueue::Close()
+{
+    if( m_EventFd >= 0 )
+        close( m_EventFd );
+    m_EventFd = -1;
+
+    while( Front() )
+        Pop();
+}
+
+/**
+ * @brief queue an item, called by any thread, it never blocks
+ *
+ * @return ORA_TRUE if queued, ORA_FALSE if shed
+ */
+ORA_BOOL CRoleEventQueue::Push( RoleQueueItemKind kind, RoleQueuePriority priority, ORA_UINT32 state, ORA_UINT32 epoch,
+                                const ORA_VOID *pData /* = ORA_NULL */, ORA_SIZE size /* = 0 */,
+                                const ORA_VOID *pTail /* = ORA_NULL */, ORA_SIZE tailSize /* = 0 */ )
+{
+    ORA_ASSERT( priority < RQP_PRIORITY_COUNT );
+    if( size > ROLE_EVENT_MAX_SIZE || tailSize > ROLE_EVENT_MAX_SIZE - size )
+    {
+        m_Oversized.fetch_add( 1, memory_order_relaxed );
+        return ORA_FALSE;
+    }
+
+    // 1. shed the low priority items early, so the state changes still find room
+    ORA_UINT32 pos   = m_EnqueuePos.load( memory_order_relaxed );
+    ORA_UINT32 depth = pos - m_DequeuePos.load( memory_order_relaxed );
+    if( priority == RQP_LOW && depth >= ROLE_EVENT_LOW_WATER )
+    {
+        m_Shed[priority].fetch_add( 1, memory_order_relaxed );
+        return ORA_FALSE;
+    }
+
+    // 2. claim a position
+    CELL *pCell;
+    while( ORA_TRUE )
+    {
+        pCell = &m_Cells[ pos & ( ROLE_EVENT_QUEUE_LEN - 1 ) ];
+        ORA_INT32 diff = static_cast< ORA_INT32 >( pCell->Seq.load( memory_order_acquire ) - pos );
+        if( diff == 0 )
+        {
+            if( m_EnqueuePos.compare_exchange_weak( pos, pos + 1, memory_order_relaxed ) )
+                break;
+        }
+        else if( diff < 0 )
+        {
+            // the consumer hasn't released this slot: full
+            m_Shed[priority].fetch_add( 1, memory_order_relaxed );
+            return ORA_FALSE;
+        }
+        else
+        {
+            // another producer took it
+            pos = m_EnqueuePos.load( memory_order_relaxed );
+        }
+    }
+
+    // 3. fill and publish it
+    ROLE_QUEUE_ITEM_T &item = pCell->Item;
+    item.Kind  = kind;
+    item.State = state;
+    item.Epoch = epoch;
+    item.Size  = size + tailSize;
+    if( size > 0 )
+        memcpy( item.Data, pData, size );
+    if( tailSize > 0 )
+        memcpy( item.Data + size, pTail, tailSize );
+    pCell->Seq.store( pos + 1, memory_order_release );
+
+    m_Posted.fetch_add( 1, memory_order_relaxed );
+    // the consumer may have passed this position already, then the depth is not counted
+    ORA_INT32  ahead    = static_cast< ORA_INT32 >( pos + 1 - m_DequeuePos.load( memory_order_relaxed ) );
+    if( ahead > ROLE_EVENT_QUEUE_LEN )
+        ahead = ROLE_EVENT_QUEUE_LEN;
+    ORA_UINT32 maxDepth = m_MaxDepth.load( memory_order_relaxed );
+    while( ahead > 0 && static_cast< ORA_UINT32 >( ahead ) > maxDepth &&
+            !m_MaxDepth.compare_exchange_weak( maxDepth, ahead, memory_order_relaxed ) )
+        ;
+
+    // 4. the consumer only needs a signal when it is going to sleep
+    atomic_thread_fence( memory_order_seq_cst );
+    if( m_bSleeping.exchange( ORA_FALSE, memory_order_seq_cst ) )
+        Wakeup();
+
+    return ORA_TRUE;
+}
+
+/**
+ * @brief the oldest item, called by the consumer only
+ *
+ * @return the item, ORA_NULL if the queue is empty. it is valid until Pop()
+ */
+const ROLE_QUEUE_ITEM_T* CRoleEventQueue::Front()
+{
+    ORA_UINT32 pos  = m_DequeuePos.load( memory_order_relaxed );
+    CELL      *pCell = &m_Cells[ pos & ( ROLE_EVENT_QUEUE_LEN - 1 ) ];
+    if( pCell->Seq.load( memory_order_acquire ) != pos + 1 )
+        return ORA_NULL;
+    return &pCell->Item;
+}
+
+/**
+ * @brief release the item returned by Front(), called by the consumer only
+ */
+ORA_VOID CRoleEventQueue::Pop()
+{
+    ORA_UINT32 pos  = m_DequeuePos.load( memory_order_relaxed );
+    CELL      *pCell = &m_Cells[ pos & ( ROLE_EVENT_QUEUE_LEN - 1 ) ];
+    ORA_ASSERT( pCell->Seq.load( memory_order_relaxed ) == pos + 1 );
+
+    // give the slot back to the producers of the next round
+    pCell->Seq.store( pos + ROLE_EVENT_QUEUE_LEN, memory_order_release );
+    m_DequeuePos.store( pos + 1, memory_order_relaxed );
+    m_Processed.fetch_add( 1, memory_order_relaxed );
+}
+
+/**
+ * @brief sleep until an item is queued or Wakeup() is called, called by the consumer only
+ */
+ORA_VOID CRoleEventQueue::Wait()
+{
+    // announce the sleep first, then check again: a producer which misses the flag
+    // has published its item before this check.
+    m_bSleeping.store( ORA_TRUE, memory_order_seq_cst );
+    atomic_thread_fence( memory_order_seq_cst );
+    if( Front() )
+    {
+        m_bSleeping.store( ORA_FALSE, memory_order_relaxed );
+        return;
+    }
+
+    ORA_UINT64 value;
+    while( read( m_EventFd, &value, sizeof(value) ) < 0 && errno == EINTR )
+        ;
+    m_bSleeping.store( ORA_FALSE, memory_order_relaxed );
+}
+
+/**
+ * @brief wake up the consumer
+ */
+ORA_VOID CRoleEventQueue::Wakeup()
+{
+    ORA_UINT64 value = 1;
+    if( write( m_EventFd, &value, sizeof(value) ) < 0 )
+        printf( "write role eventfd failed [%s]\n", strerror( errno ) );
+}
+
+/**
+ * @brief get the counters of the queue
+ */
+ROLE_QUEUE_STATS_T CRoleEventQueue::GetStats() const
+{
+    ROLE_QUEUE_STATS_T stats;
+    stats.Posted    = m_Posted.load( memory_order_relaxed );
+    stats.Processed = m_Processed.load( memory_order_relaxed );
+    for( ORA_UINT32 i = 0; i < RQP_PRIORITY_COUNT; i++ )
+        stats.Shed[i] = m_Shed[i].load( memory_order_relaxed );
+    stats.Oversized = m_Oversized.load( memory_order_relaxed );
+    stats.MaxDepth  = m_MaxDepth.load( memory_order_relaxed );
+    return stats;
+}
+// END: CRoleEventQueue
+//////////////////////////////////////////////////////////////////////////////
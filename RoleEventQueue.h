@@ -0,0 +1,151 @@
+#ifndef __ROLE_EVENT_QUEUE_H__
+#define __ROLE_EVENT_QUEUE_H__
+
+#include <atomic>
+#include <vector>
+
+using namespace std;
+
+#define ROLE_EVENT_QUEUE_LEN    256     ///< ring slots, power of 2
+#define ROLE_EVENT_MAX_SIZE     256     ///< the largest role event copied into a slot
+#define ROLE_EVENT_LOW_WATER    ( ROLE_EVENT_QUEUE_LEN * 3 / 4 )    ///< low priority items are shed above this depth
+
+/**
+ * @name RoleQueueItemKind what a queued item asks the role thread to do
+ * @{ */
+enum RoleQueueItemKind
+{
+    RQK_EVENT,      ///< process a role event received from the network
+    RQK_TIMEOUT,    ///< process the timeout of the state activated at Epoch
+    RQK_SET_STATE   ///< change to State, requested by another thread
+};
+/**  @} */
+
+/**
+ * @name RoleQueuePriority which items are shed first when the queue is filling up
+ * @{ */
+enum RoleQueuePriority
+{
+    RQP_LOW,        ///< queries which are repeated by their sender, shed above ROLE_EVENT_LOW_WATER
+    RQP_HIGH,       ///< state changes and timeouts, shed only when the queue is full
+
+    RQP_PRIORITY_COUNT
+};
+/**  @} */
+
+/* Struct : ROLE_QUEUE_ITEM, one slot of the queue, the event is copied in */
+typedef struct ROLE_QUEUE_ITEM
+{
+    ORA_UINT32  Kind;       // RoleQueueItemKind
+    ORA_UINT32  State;      // RQK_SET_STATE: the target state
+    ORA_UINT32  Epoch;      // RQK_TIMEOUT: the activation which armed the timer
+    ORA_UINT32  Size;       // RQK_EVENT: event size
+    ORA_UINT8   Data[ROLE_EVENT_MAX_SIZE];
+}ROLE_QUEUE_ITEM_T;
+
+/* Struct : ROLE_QUEUE_STATS, counters of the queue */
+typedef struct ROLE_QUEUE_STATS
+{
+    ORA_UINT64  Posted;                     // items queued
+    ORA_UINT64  Processed;                  // items taken by the role thread
+    ORA_UINT64  Shed[RQP_PRIORITY_COUNT];   // items dropped because the queue is filling up, by priority
+    ORA_UINT64  Oversized;                  // events larger than ROLE_EVENT_MAX_SIZE
+    ORA_UINT32  MaxDepth;                   // the deepest queue seen
+}ROLE_QUEUE_STATS_T;
+
+/**
+ * @name CRoleEventQueue a bounded lock-free multi-producer / single-consumer ring for the role thread.
+ *
+ * @note each slot carries a sequence number: a producer claims a position with CAS, fills the slot
+ * and publishes it by the sequence, the consumer takes the slots in order without any CAS.
+ * the consumer sleeps in an eventfd, which the producers only signal when it is sleeping.
+ * @{ */
+class CRoleEventQueue
+{
+// Constructor & Destructor
+public:
+    CRoleEventQueue();
+    ~CRoleEventQueue();
+
+// Operations
+public:
+    /**
+     * @brief create the eventfd for waking up the consumer
+     *
+     * @return ORA_TRUE if created successfully, otherwise return ORA_FALSE
+     */
+    ORA_BOOL Create();
+
+    /**
+     * @brief close the eventfd, the queued items are dropped
+     */
+    ORA_VOID Close();
+
+    /**
+     * @brief queue an item, called by any thread, it never blocks
+     *
+     * @param kind      RoleQueueItemKind
+     * @param priority  RoleQueuePriority
+     * @param state     RQK_SET_STATE: the target state
+     * @param epoch     RQK_TIMEOUT: the activation which armed the timer
+     * @param pData     RQK_EVENT: the event to copy
+     * @param size      RQK_EVENT: the event size
+     * @param pTail     RQK_EVENT: copied behind pData, e.g. the event data behind its header
+     * @param tailSize  RQK_EVENT: the size of pTail
+     *
+     * @return ORA_TRUE if queued, ORA_FALSE if shed
+     */
+    ORA_BOOL Push( RoleQueueItemKind kind, RoleQueuePriority priority, ORA_UINT32 state, ORA_UINT32 epoch,
+                   const ORA_VOID *pData = ORA_NULL, ORA_SIZE size = 0,
+                   const ORA_VOID *pTail = ORA_NULL, ORA_SIZE tailSize = 0 );
+
+    /**
+     * @brief the oldest item, called by the consumer only
+     *
+     * @return the item, ORA_NULL if the queue is empty. it is valid until Pop()
+     */
+    const ROLE_QUEUE_ITEM_T* Front();
+
+    /**
+     * @brief release the item returned by Front(), called by the consumer only
+     */
+    ORA_VOID Pop();
+
+    /**
+     * @brief sleep until an item is queued or Wakeup() is called, called by the consumer only
+     */
+    ORA_VOID Wait();
+
+    /**
+     * @brief wake up the consumer
+     */
+    ORA_VOID Wakeup();
+
+    /**
+     * @brief get the counters of the queue
+     */
+    ROLE_QUEUE_STATS_T GetStats() const;
+
+// Properties
+private:
+    struct CELL
+    {
+        atomic< ORA_UINT32 > Seq;   ///< == position: free for the producer, == position + 1: ready for the consumer
+        ROLE_QUEUE_ITEM_T    Item;
+    };
+
+    vector< CELL >          m_Cells;
+    atomic< ORA_UINT32 >    m_EnqueuePos;   ///< next position claimed by a producer
+    atomic< ORA_UINT32 >    m_DequeuePos;   ///< next position taken by the consumer
+    atomic< ORA_BOOL >      m_bSleeping;    ///< the consumer is (about to be) blocked in the eventfd
+    ORA_INT32               m_EventFd;
+
+    atomic< ORA_UINT64 >    m_Posted;
+    atomic< ORA_UINT64 >    m_Processed;
+    atomic< ORA_UINT64 >    m_Shed[RQP_PRIORITY_COUNT];
+    atomic< ORA_UINT64 >    m_Oversized;
+    atomic< ORA_UINT32 >    m_MaxDepth;
+};
+/**  @} */
+
+#endif /* __ROLE_EVENT_QUEUE_H__ */
@@ -1,6 +1,93 @@
 #include "Base.h"
 #include "RoleState.h"
 
+/**
+ * @brief the shedding priority of a received role event: the queries are repeated by their
+ * senders, so they are shed first when the role thread falls behind.
+ *
+ * @param id  role event id
+ *
+ * @return RoleQueuePriority
+ */
+static inline RoleQueuePriority EventPriority( ORA_UINT16 id )
+{
+    switch( id )
+    {
+    case REID_QUERY_MASTER_INFO:
+    case REID_QUERY_RSSI_INFO:
+    case REID_NOTIFY_DEFINER_ALIVE:
+    case REID_FETACH_AP_RSSI:
+        return RQP_LOW;
+
+    default:
+        return RQP_HIGH;
+    }
+}
+
+#define RE_DATA_SIZE( event )   ( sizeof( event ) - sizeof( ROLE_EVENT ) )
+#define RE_NOT_SENT             static_cast< ORA_SIZE >( -1 )   ///< no event struct, never on the wire
+
+/**
+ * @brief the data size of every role event, the entries follow RoleEventID. a received event
+ * of another size is dropped before its data is read as the struct.
+ */
+static constexpr ORA_SIZE s_EventDataSizes[REID_EVENT_COUNT] =
+{
+    RE_DATA_SIZE( REVENT_SET_MASTER_INFO ),
+    RE_DATA_SIZE( REVENT_MASTER_DETECTED ),
+    RE_DATA_SIZE( REVENT_QUERY_MASTER_INFO ),
+    RE_DATA_SIZE( REVENT_DEFINER_DETECTED ),
+    RE_DATA_SIZE( REVENT_TIMEOUT ),
+    RE_NOT_SENT,                                    // REID_QUERY_RSSI_INFO
+    RE_NOT_SENT,                                    // REID_QUERY_RSSI_INFO_RESP
+    RE_NOT_SENT,                                    // REID_NOTIFY_DEFINER_ALIVE
+    RE_DATA_SIZE( REVENT_FETACH_AP_RSSI ),
+    RE_DATA_SIZE( REVENT_FETACH_AP_RSSI_RESP ),
+    RE_DATA_SIZE( REVENT_MASTER_HEARTBEAT ),
+    RE_DATA_SIZE( REVENT_SLAVE_ALIVE ),
+};
+static_assert( s_EventDataSizes[REID_EVENT_COUNT - 1] == RE_DATA_SIZE( REVENT_SLAVE_ALIVE ),
+               "the role event data sizes miss an event" );
+
+#define RT_IGNORE           { CRoleManager::RTA_IGNORE, CRoleManager::RST_NONE }
+#define RT_HANDLE           { CRoleManager::RTA_HANDLE, CRoleManager::RST_NONE }
+#define RT_GOTO( state )    { CRoleManager::RTA_GOTO,   CRoleManager::state }
+
+/**
+ * @brief the transition table: current state x RoleEventID -> action, the columns follow RoleEventID.
+ * a row with a missing cell fails to compile, see TransitionsComplete().
+ */
+static constexpr CRoleManager::ROLE_TRANSITION s_RoleTransitions[CRoleManager::RST_STATE_TYPE_COUNT][REID_EVENT_COUNT] =
+{
+    //  SET_MASTER_INFO  MASTER_DETECTED  QUERY_MASTER_INFO  DEFINER_DETECTED      TIMER_TIMEOUT          QUERY_RSSI_INFO  QUERY_RSSI_INFO_RESP  NOTIFY_DEFINER_ALIVE  FETACH_AP_RSSI  FETACH_AP_RSSI_RESP  MASTER_HEARTBEAT  SLAVE_ALIVE
+    /* RST_NONE     */
+    {   RT_IGNORE,       RT_IGNORE,       RT_IGNORE,         RT_IGNORE,            RT_IGNORE,             RT_IGNORE,       RT_IGNORE,            RT_IGNORE,            RT_IGNORE,      RT_IGNORE,           RT_IGNORE,        RT_IGNORE },
+    /* RST_NO_ROLE  */
+    {   RT_IGNORE,       RT_HANDLE,       RT_HANDLE,         RT_GOTO(RST_PRE_ROLE), RT_HANDLE,            RT_IGNORE,       RT_IGNORE,            RT_IGNORE,            RT_IGNORE,      RT_IGNORE,           RT_HANDLE,        RT_IGNORE },
+    /* RST_DEFINER  */
+    {   RT_IGNORE,       RT_HANDLE,       RT_IGNORE,         RT_HANDLE,            RT_HANDLE,             RT_IGNORE,       RT_IGNORE,            RT_IGNORE,            RT_IGNORE,      RT_HANDLE,           RT_HANDLE,        RT_IGNORE },
+    /* RST_PRE_ROLE */
+    {   RT_HANDLE,       RT_HANDLE,       RT_IGNORE,         RT_IGNORE,            RT_GOTO(RST_NO_ROLE),  RT_IGNORE,       RT_IGNORE,            RT_IGNORE,            RT_HANDLE,      RT_IGNORE,           RT_HANDLE,        RT_IGNORE },
+    /* RST_SLAVE    */
+    {   RT_IGNORE,       RT_IGNORE,       RT_IGNORE,         RT_IGNORE,            RT_HANDLE,             RT_IGNORE,       RT_IGNORE,            RT_IGNORE,            RT_IGNORE,      RT_IGNORE,           RT_HANDLE,        RT_IGNORE },
+    /* RST_MASTER   */
+    {   RT_IGNORE,       RT_IGNORE,       RT_HANDLE,         RT_IGNORE,            RT_HANDLE,             RT_IGNORE,       RT_IGNORE,            RT_IGNORE,            RT_IGNORE,      RT_IGNORE,           RT_HANDLE,        RT_HANDLE },
+};
+
+/**
+ * @brief check at compile time that every cell of the transition table is filled,
+ * and every RTA_GOTO has a next state.
+ */
+static constexpr ORA_BOOL TransitionsComplete( ORA_UINT32 cell = 0 )
+{
+    return cell == CRoleManager::RST_STATE_TYPE_COUNT * REID_EVENT_COUNT ||
+           ( s_RoleTransitions[cell / REID_EVENT_COUNT][cell % REID_EVENT_COUNT].Action != CRoleManager::RTA_UNSET &&
+             ( s_RoleTransitions[cell / REID_EVENT_COUNT][cell % REID_EVENT_COUNT].Action != CRoleManager::RTA_GOTO ||
+               s_RoleTransitions[cell / REID_EVENT_COUNT][cell % REID_EVENT_COUNT].Next != CRoleManager::RST_NONE ) &&
+             TransitionsComplete( cell + 1 ) );
+}
+static_assert( TransitionsComplete(), "the role transition table misses a state or an event" );
+
 //////////////////////////////////////////////////////////////////////////////
 // BEG: CRoleManager
 /**
@@ -9,15 +96,39 @@
  * @param pDelivery the network data delivery interface.
  */
 CRoleManager::CRoleManager( INwDataDelivery* pDelivery )
+    : m_NoRoleState( this ),
+      m_PreRoleState( this ),
+      m_DefinerState( this ),
+      m_SlaveState( this ),
+      m_MasterState( this ),
+      m_Coalescer( pDelivery )
 {
     ORA_ASSERT( pDelivery );
-    m_pDelivery  = pDelivery;
-    m_pCurrState = ORA_NULL;
+    m_pDelivery     = pDelivery;
+    m_pCurrState    = ORA_NULL;
+    m_CurrStateType = RST_NONE;
+
+    m_pStates[RST_NONE]     = ORA_NULL;
+    m_pStates[RST_NO_ROLE]  = &m_NoRoleState;
+    m_pStates[RST_DEFINER]  = &m_DefinerState;
+    m_pStates[RST_PRE_ROLE] = &m_PreRoleState;
+    m_pStates[RST_SLAVE]    = &m_SlaveState;
+    m_pStates[RST_MASTER]   = &m_MasterState;
+
+    m_WarmRole   = RST_NONE;
+    m_StateEpoch = 0;
+    m_Term       = 0;
+    m_pStateCallback = ORA_NULL;
+    m_pStateContext  = ORA_NULL;
+    m_hRssiTimer = ORA_NULL;
+    m_hListenEventThread = ORA_NULL;
+    m_bQuit      = ORA_FALSE;
+    ORAInitializeCriticalSection( &m_RoleLock );
 }
 
 CRoleManager::~CRoleManager()
 {
-    // Do nothing;
+    ORADeleteCriticalSection( &m_RoleLock );
 }
 
 /**
@@ -29,53 +140,30 @@ ORA_BOOL CRoleManager::Start()
 {
     if( CCommService::Start() )
     {
-        CRoleState *pNoRole  = ORA_NULL;
-        CRoleState *pPreRole = ORA_NULL;
-        CRoleState *pDefiner = ORA_NULL;
-        CRoleState *pSlave   = ORA_NULL;
-        CRoleState *pMaster  = ORA_NULL;
-
-        pNoRole = new CNoRoleState( this );
-        if( pNoRole )
-            m_RoleStateMap.insert( CRoleStateMap::value_type( RST_NO_ROLE, pNoRole ) );
-        else
-            goto ERR;
-
-        pPreRole = new CPreRoleState( this );
-        if( pPreRole )
-            m_RoleStateMap.insert( CRoleStateMap::value_type( RST_NO_ROLE, pPreRole ) );
-        else
-            goto ERR;
-
-        pDefiner = new CDefinerState( this );
-        if( pDefiner )
-            m_RoleStateMap.insert( CRoleStateMap::value_type( RST_NO_ROLE, pDefiner ) );
-        else
-            goto ERR;
-
-        pSlave = new CSlaveState( this );
-        if( pSlave )
-            m_RoleStateMap.insert( CRoleStateMap::value_type( RST_NO_ROLE, pSlave ) );
-        else
-            goto ERR;
-
-        pMaster = new CMasterState( this );
-        if( pMaster )
-            m_RoleStateMap.insert( CRoleStateMap::value_type( RST_NO_ROLE, pMaster ) );
-        else
-            goto ERR;
+        // the role thread takes over the state changes from now on
+        if( !m_EventQueue.Create() )
+            return ORA_FALSE;
+
+        m_bQuit = ORA_FALSE;
+        m_hListenEventThread = ORACreateThread( ListenEventThread,
+                                        reinterpret_cast< ORA_VOID* >( this ),
+                                        ORA_TRUE,
+                                        ORA_NULL,
+                                        ORATP_NORMAL,
+                                        DEFAULT_THREAD_STACK_SIZE );
+        if( !m_hListenEventThread )
+        {
+            m_EventQueue.Close();
+            return ORA_FALSE;
+        }
 
+        // the RSSI is sampled on its own schedule, the role thread only reads it
+        m_RssiSampler.Reset();
+        m_hRssiTimer = ORACreateTimer( RssiTimerHandler, this );
+        RssiTimerHandler( m_hRssiTimer, this );
         return ORA_TRUE;
     }
 
-ERR:
-    while( m_RoleStateMap.size() )
-    {
-        CRoleStateMap::iterator it = m_RoleStateMap.begin();
-        ORA_ASSERT( it->second );
-        delete it->second;
-        m_RoleStateMap.erase( it );
-    }
     return ORA_FALSE;
 }
 
@@ -84,13 +172,36 @@ ERR:
  */
 ORA_VOID CRoleManager::Stop()
 {
-    while( m_RoleStateMap.size() )
+    // 1. the producers return without queuing, the role thread stops at the next item
+    m_bQuit = ORA_TRUE;
+
+    // 2. unhook the timers which post to the queue
+    if( m_hRssiTimer )
+    {
+        ORADestroyTimer( m_hRssiTimer );
+        m_hRssiTimer = ORA_NULL;
+    }
+
+    // 3. stop the role thread, then nothing touches the states any more
+    if( m_hListenEventThread )
+    {
+        m_EventQueue.Wakeup();
+        ORAWaitThreadDead( m_hListenEventThread );
+        m_hListenEventThread = ORA_NULL;
+    }
+
+    // 4. the state's timer goes with it
+    if( m_pCurrState )
     {
-        CRoleStateMap::iterator it = m_RoleStateMap.begin();
-        ORA_ASSERT( it->second );
-        delete it->second;
-        m_RoleStateMap.erase( it );
+        m_pCurrState->Deactivate( ORA_TRUE );
+        m_pCurrState    = ORA_NULL;
+        CORASectionLock lock( m_RoleLock );
+        m_CurrStateType = RST_NONE;
     }
+
+    // 5. nothing posts any more: the receiver is unbound by the owner before Stop()
+    m_EventQueue.Close();
+
     CCommService::Stop();
 }
 
@@ -104,59 +215,171 @@ ORA_VOID CRoleManager::Stop()
  */
 ORA_VOID CRoleManager::SetState( RoleStateType state, ORA_VOID *pParam /* = ORA_NULL */, ORA_BOOL bForced /* = ORA_FALSE */ )
 {
-    ORA_ASSERT( state < RST_STATE_TYPE_COUNT );
+    ORA_ASSERT( state > RST_NONE && state < RST_STATE_TYPE_COUNT );
     if( m_pCurrState )
         m_pCurrState->Deactivate( bForced );
 
-    CRoleState *pNewStat = m_RoleStateMap.find( state )->second;
+    CRoleState *pNewStat = m_pStates[state];
     ORA_ASSERT( pNewStat );
+    pNewStat->SetEpoch( ++m_StateEpoch );
+    m_pCurrState    = pNewStat;
+    CORASectionLock lock( m_RoleLock );
+    m_CurrStateType = state;
+    lock.Unlock();
+
+    // before the activation, which may change the state again
+    if( m_pStateCallback )
+        m_pStateCallback( state, m_pStateContext );
     pNewStat->Activate( pParam );
-    m_pCurrState = pNewStat;
+}
+
+/**
+ * @brief dispatch a role event to the current state by the transition table
+ *
+ * @param pEvent role event
+ */
+ORA_VOID CRoleManager::DispatchEvent( const ROLE_EVENT *pEvent )
+{
+    ORA_UINT16 id = pEvent->GetEventID();
+    if( m_pCurrState == ORA_NULL || id >= REID_EVENT_COUNT )
+        return;
+
+    const ROLE_TRANSITION &transition = s_RoleTransitions[m_CurrStateType][id];
+    switch( transition.Action )
+    {
+    case RTA_GOTO:
+        SetState( transition.Next );
+        break;
+
+    case RTA_HANDLE:
+        m_pCurrState->ProcessEvent( pEvent );
+        break;
+
+    default:
+        // RTA_IGNORE: the event means nothing in this state
+        break;
+    }
 }
 
 /**
  * @brief send the event the all devices via broadcast approach.
  *
- * @param pEvent the event data
+ * @param event the event data
  */
-ORA_VOID CRoleManager::SendEvent( const ROLE_EVENT *pEvent )
+ORA_VOID CRoleManager::SendEvent( const ROLE_EVENT &event )
 {
-    ORA_ASSERT( pEvent && pEvent->IsValid() );
-    if( m_pDelivery )
+    ORA_ASSERT( event.IsValid() );
+    switch( event.GetEventType() )
     {
-        switch( pEvent->GetEventType() )
-        {
-        case ET_BROADCAST:
-            m_pDelivery->BroadcastDataPacket( reinterpret_cast< const ORA_VOID* >( pEvent ) );
-            break;
+    case ET_BROADCAST:
+        m_Coalescer.Add( ORA_TRUE, 0, event, m_Term, RoleGetTickMs() );
+        break;
 
-        case ET_UNICAST:
-            ORA_ASSERT( pEvent->GetSender() );
-            m_pDelivery->UnicastDataPacket( pEvent->GetSender(), reinterpret_cast< const ORA_VOID* >( pEvent ) );
-            break;
+    case ET_UNICAST:
+        ORA_ASSERT( event.GetSender() );
+        m_Coalescer.Add( ORA_FALSE, event.GetSender(), event, m_Term, RoleGetTickMs() );
+        break;
 
-        case ET_MULTICAST:
-            // TODO: wrapper the multicast interface
-            break;
+    case ET_MULTICAST:
+        // TODO: wrapper the multicast interface
+        break;
 
-        case ET_TIMEOUT:
-            // TODO: internal timeout event.
-            break;
-        }
+    case ET_TIMEOUT:
+        // TODO: internal timeout event.
+        break;
     }
 }
 
 /**
- * @brief get devices' wifi rssi
- * !!! TBD: if need cache RSSI, and always return one value.
+ * @brief send the event to the specified device via unicast approach.
+ *
+ * @param target  the target device id
+ * @param event   the event data
+ */
+ORA_VOID CRoleManager::SendEventTo( DEVICE_ID_T target, const ROLE_EVENT &event )
+{
+    ORA_ASSERT( event.IsValid() );
+    m_Coalescer.Add( ORA_FALSE, target, event, m_Term, RoleGetTickMs() );
+}
+
+/**
+ * @brief set the device id the role states announce themselves with
+ *
+ * @param id    device id
+ */
+ORA_VOID CRoleManager::SetDeviceID( DEVICE_ID_T id )
+{
+    for( ORA_UINT32 i = RST_NO_ROLE; i < RST_STATE_TYPE_COUNT; i++ )
+        m_pStates[i]->SetDeviceID( id );
+    m_Coalescer.SetSender( id );
+}
+
+/**
+ * @brief set the mesh IP address of this device, it is announced while this device is the master
  *
- * @return RSSI value
+ * @param ipAddr  IP address on the mesh
+ */
+ORA_VOID CRoleManager::SetDeviceAddress( const string &ipAddr )
+{
+    CORASectionLock lock( m_RoleLock );
+    m_DeviceAddr = ipAddr;
+}
+
+/**
+ * @brief get the mesh IP address of this device
+ *
+ * @return IP address, empty before it is set
+ */
+string CRoleManager::GetDeviceAddress() const
+{
+    CORASectionLock lock( m_RoleLock );
+    return m_DeviceAddr;
+}
+
+/**
+ * @brief warm start from the checkpoint of the last run.
+ *
+ * @param role    the role of the last run
+ * @param term    the master term of the last run
+ * @param info    the master's information of the last run
+ */
+ORA_VOID CRoleManager::SetWarmStart( RoleStateType role, ORA_UINT32 term, const MASTER_INFO& info )
+{
+    // only a resolved role is worth confirming
+    if( role != RST_SLAVE && role != RST_MASTER )
+        return;
+
+    if( role == RST_SLAVE && info.DeviceID == 0 )
+        return;
+
+    // the term is resumed too, the slaves drop the heartbeats of an older one
+    m_WarmRole = role;
+    SetTerm( term );
+    SaveMasterInfo( info );
+}
+
+/**
+ * @brief get the smoothed AP RSSI of this device, it never blocks.
+ *
+ * @return dBm, RSSI_UNKNOWN if there is no fresh sample
  */
 ORA_INT32 CRoleManager::GetDeviceRSSI() const
 {
-    //NotifyEvent( FS_MSG_IPC_GET_RSSI() );
-    //!TODO! sync invoked wait event here.
-    return m_DeviceRSSI;
+    return m_RssiSampler.Get( RoleGetTickMs(), RSSI_MAX_AGE );
+}
+
+/**
+ * @brief poll the radio for the RSSI, the response is folded in by OnMsgProcedure()
+ *
+ * @param hTimer    timer handler
+ * @param pContext  CRoleManager
+ */
+ORA_VOID CRoleManager::RssiTimerHandler( ORA_HTIMER hTimer, ORA_VOID *pContext )
+{
+    ORA_ASSERT( pContext );
+    CRoleManager *pThis = reinterpret_cast< CRoleManager* >( pContext );
+    pThis->NotifyEvent( FS_MSG_IPC_GET_RSSI() );
+    ORASetTimer( hTimer, RSSI_SAMPLE_INTERVAL );
 }
 
 /**
@@ -168,11 +391,172 @@ ORA_INT32 CRoleManager::GetDeviceRSSI() const
  */
 ORA_VOID CRoleManager::RecvDataPacket( const DEVICE_ID_T &sender, const ORA_VOID *pPacket, ORA_SIZE size )
 {
-    const ROLE_EVENT *pEvent = reinterpret_cast< const ROLE_EVENT* >( pPacket );
-    ORA_ASSERT( pEvent && pEvent->IsValid() );
-    ORA_ASSERT( sender == pEvent->GetSender() );
-    if( m_pCurrState )
-        m_pCurrState->ProcessEvent( pEvent );
+    // the header is decoded in place, a truncated event is not trusted
+    const ORA_UINT8   *pData = reinterpret_cast< const ORA_UINT8* >( pPacket );
+    ROLE_WIRE_HEADER_T header;
+    if( pData == ORA_NULL || !CRoleEventCodec::DecodeHeader( pData, size, header ) )
+        return;
+
+    // the event must be the sender's own, the device id of the link is the trusted one
+    if( header.Sender != sender )
+    {
+        printf( "role event %u claiming sender %u from %u is dropped\n", header.Id,
+                static_cast< ORA_UINT32 >( header.Sender ), static_cast< ORA_UINT32 >( sender ) );
+        return;
+    }
+
+    if( header.Id != REID_EVENT_BUNDLE )
+    {
+        PushEvent( header, pData + header.Size );
+        return;
+    }
+
+    // a bundle: its events are walked in place, each one is queued straight from the packet
+    pData += header.Size;
+    ORA_SIZE left = header.DataSize;
+    while( left > 0 )
+    {
+        ROLE_WIRE_HEADER_T inner;
+        if( !CRoleEventCodec::DecodeHeader( pData, left, inner ) || inner.Id == REID_EVENT_BUNDLE ||
+            inner.Sender != sender )
+        {
+            printf( "malformed event bundle from %u is dropped\n", static_cast< ORA_UINT32 >( sender ) );
+            return;
+        }
+
+        PushEvent( inner, pData + inner.Size );
+        pData += inner.Size + inner.DataSize;
+        left  -= inner.Size + inner.DataSize;
+    }
+}
+
+/**
+ * @brief queue an event of a received packet for the role thread
+ *
+ * @param header    the decoded header of the event
+ * @param pData     the event data behind the header
+ */
+ORA_VOID CRoleManager::PushEvent( const ROLE_WIRE_HEADER_T &header, const ORA_UINT8 *pData )
+{
+    if( m_bQuit )
+        return;
+
+    // the data is read as the event struct by the states, a size of another struct is not trusted
+    if( header.Id >= REID_EVENT_COUNT || header.DataSize != s_EventDataSizes[header.Id] )
+    {
+        printf( "role event %u of %u data bytes from %u is dropped\n", header.Id,
+                static_cast< ORA_UINT32 >( header.DataSize ), static_cast< ORA_UINT32 >( header.Sender ) );
+        return;
+    }
+
+    // copy the event to the role thread and return at once, the network thread is not held:
+    // the header is built in the host order, the data is copied straight from the packet
+    ORA_UINT8 event[sizeof( ROLE_EVENT )];
+    CRoleEventCodec::ToEvent( header, event );
+    m_EventQueue.Push( RQK_EVENT, EventPriority( header.Id ), RST_NONE, 0, event, sizeof( event ), pData, header.DataSize );
+}
+
+/**
+ * @brief request the role thread to change to specified state, it returns at once.
+ *
+ * @param state   RoleStateType value.
+ */
+ORA_VOID CRoleManager::PostState( RoleStateType state )
+{
+    ORA_ASSERT( state < RST_STATE_TYPE_COUNT );
+    if( m_bQuit )
+        return;
+
+    if( !m_EventQueue.Push( RQK_SET_STATE, RQP_HIGH, state, 0 ) )
+        printf( "role event queue is full, state %d request is dropped\n", state );
+}
+
+/**
+ * @brief post the timeout of a state to the role thread, called by the state's timer.
+ *
+ * @param epoch   the activation epoch of the state which armed the timer
+ */
+ORA_VOID CRoleManager::PostTimeout( ORA_UINT32 epoch )
+{
+    if( m_bQuit )
+        return;
+
+    if( !m_EventQueue.Push( RQK_TIMEOUT, RQP_HIGH, RST_NONE, epoch ) )
+        printf( "role event queue is full, timeout is dropped\n" );
+}
+
+/**
+ * @brief process a queued item in the role thread
+ *
+ * @param item  the queued item
+ */
+ORA_VOID CRoleManager::DispatchItem( const ROLE_QUEUE_ITEM_T &item )
+{
+    switch( item.Kind )
+    {
+    case RQK_EVENT:
+        DispatchEvent( reinterpret_cast< const ROLE_EVENT* >( item.Data ) );
+        break;
+
+    case RQK_TIMEOUT:
+        {
+            // the timer of a state which has been left already
+            if( m_pCurrState == ORA_NULL || item.Epoch != m_StateEpoch )
+                break;
+
+            REVENT_TIMEOUT timeout;
+            DispatchEvent( &timeout );
+        }
+        break;
+
+    case RQK_SET_STATE:
+        SetState( static_cast< RoleStateType >( item.State ) );
+        break;
+    }
+}
+
+/**
+ * @brief the role thread: it owns the current state, and processes the received events,
+ * the timeouts and the state requests in the order they are queued.
+ */
+ORA_INT_PTR CRoleManager::ListenEventThread( ORA_VOID* pContext )
+{
+    CRoleManager *pThis = reinterpret_cast< CRoleManager* >( pContext );
+    ORA_ASSERT( pThis );
+
+    while( !pThis->m_bQuit )
+    {
+        pThis->ProcessQueue();
+
+        if( !pThis->m_bQuit )
+            pThis->m_EventQueue.Wait();
+    }
+
+    return 0;
+}
+
+/**
+ * @brief process the queued events, timeouts and state requests in the caller's thread.
+ *
+ * @return the number of processed items
+ */
+ORA_UINT32 CRoleManager::ProcessQueue()
+{
+    ORA_UINT32 count = 0;
+    const ROLE_QUEUE_ITEM_T *pItem;
+    while( !m_bQuit && ( pItem = m_EventQueue.Front() ) != ORA_NULL )
+    {
+        DispatchItem( *pItem );
+        m_EventQueue.Pop();
+        count++;
+
+        // a busy thread doesn't hold the sent events longer than the window
+        m_Coalescer.FlushDue( RoleGetTickMs() );
+    }
+
+    // the thread goes idle, what the batch sent leaves together
+    m_Coalescer.Flush();
+    return count;
 }
 
 ORA_VOID CRoleManager::OnMsgProcedure( const _MSG_HEAD *pMsg )
@@ -180,10 +564,9 @@ ORA_VOID CRoleManager::OnMsgProcedure( const _MSG_HEAD *pMsg )
     ORA_ASSERT( pMsg );
     switch( pMsg->GetMsgID() )
     {
-//    case MT_IPC_GET_RSSI_RESP:
-//        m_DeviceRSSI = reinterpret_cast< const FS_MSG_IPC_GET_RSSI_RESP* >( pMsg )->GetRSSI();
-//        //!TODO! issue sync event here.
-//        break;
+    case MT_IPC_GET_RSSI_RESP:
+        m_RssiSampler.Update( reinterpret_cast< const FS_MSG_IPC_GET_RSSI_RESP* >( pMsg )->GetRSSI(), RoleGetTickMs() );
+        break;
     }
 }
 // END: CRoleManager
@@ -201,6 +584,9 @@ CRoleManager::CRoleState::CRoleState( CRoleManager *pContext )
 {
     ORA_ASSERT( pContext );
     m_pContext = pContext;
+    m_DeviceID = 0;
+    m_hTimer   = ORA_NULL;
+    m_Epoch    = 0;
 }
 
 /**
@@ -267,7 +653,8 @@ ORA_VOID CRoleManager::CRoleState::ProcessEvent( const ROLE_EVENT *pEvent )
 ORA_VOID CRoleManager::CRoleState::TimeoutHandler( ORA_HTIMER hTimer, ORA_VOID *pContext )
 {
     ORA_ASSERT( pContext );
-    reinterpret_cast< CRoleState* >( pContext )->ProcessEvent( new REVENT_TIMEOUT() );
+    CRoleState *pState = reinterpret_cast< CRoleState* >( pContext );
+    pState->m_pContext->PostTimeout( pState->m_Epoch );
 }
 // END: CRoleState
 //////////////////////////////////////////////////////////////////////////////
@@ -283,7 +670,8 @@ ORA_VOID CRoleManager::CRoleState::TimeoutHandler( ORA_HTIMER hTimer, ORA_VOID *
 CRoleManager::CNoRoleState::CNoRoleState( CRoleManager *pContext )
     : CRoleState( pContext )
 {
-    m_hTimer = ORA_NULL;
+    m_hTimer   = ORA_NULL;
+    m_WarmRole = RST_NONE;
 }
 
 /**
@@ -304,8 +692,25 @@ ORA_VOID CRoleManager::CNoRoleState::Activate( ORA_VOID *pParam /* = ORA_NULL */
 {
     ORA_ASSERT( m_hTimer == ORA_NULL );
     m_hTimer = ORACreateTimer( CRoleState::TimeoutHandler, this );
+
+    // warm start: confirm the role of the last run within one round trip
+    m_WarmRole = TakeWarmRole();
+    if( m_WarmRole == RST_SLAVE )
+    {
+        ORASetTimer( m_hTimer, WARM_START_CONFIRM_TIMEOUT );
+        SendEventTo( GetMasterInfo().DeviceID, REVENT_QUERY_MASTER_INFO( m_DeviceID ) );
+        return;
+    }
+
+    if( m_WarmRole == RST_MASTER )
+    {
+        ORASetTimer( m_hTimer, WARM_START_CONFIRM_TIMEOUT );
+        SendEvent( REVENT_QUERY_MASTER_INFO( m_DeviceID ) );
+        return;
+    }
+
     ORASetTimer( m_hTimer, NO_ROLE_LEISURE_TIMEOUT );
-    SendEvent( new REVENT_QUERY_MASTER_INFO( m_DeviceID ) );
+    SendEvent( REVENT_QUERY_MASTER_INFO( m_DeviceID ) );
 }
 
 /**
@@ -317,7 +722,8 @@ ORA_VOID CRoleManager::CNoRoleState::Activate( ORA_VOID *pParam /* = ORA_NULL */
 ORA_VOID CRoleManager::CNoRoleState::Deactivate( ORA_BOOL bForced /* = ORA_FALSE */ )
 {
     ORADestroyTimer( m_hTimer );
-    m_hTimer = ORA_NULL;
+    m_hTimer   = ORA_NULL;
+    m_WarmRole = RST_NONE;
 }
 
 /**
@@ -328,6 +734,12 @@ ORA_VOID CRoleManager::CNoRoleState::Deactivate( ORA_BOOL bForced /* = ORA_FALSE
 ORA_VOID CRoleManager::CNoRoleState::ProcessEvent( const ROLE_EVENT *pEvent )
 {
     ORA_ASSERT( pEvent );
+
+    // the mesh may have moved on to a newer term while this device was down,
+    // the master role is resumed above the latest term heard
+    if( m_WarmRole == RST_MASTER && pEvent->GetTerm() > GetTerm() )
+        SetTerm( pEvent->GetTerm() );
+
     switch( pEvent->GetEventID() )
     {
     case REID_QUERY_MASTER_INFO:
@@ -338,24 +750,38 @@ ORA_VOID CRoleManager::CNoRoleState::ProcessEvent( const ROLE_EVENT *pEvent )
         }
         break;
 
-    case REID_DEFINER_DETECTED:
-        ChangeState( RST_PRE_ROLE );
-        break;
-
     case REID_MASTER_DETECTED:
         {
-            const MASTER_INFO *pMasterInfo = reinterpret_cast< const REVENT_MASTER_DETECTED* >( pEvent )->GetMasterInfo();
-            if( pMasterInfo )
-            {
-                SaveMasterInfo( *pMasterInfo );
-                delete pMasterInfo;
-                ChangeState( RST_SLAVE );
-            }
+            MASTER_INFO info;
+            reinterpret_cast< const REVENT_MASTER_DETECTED* >( pEvent )->GetMasterInfo( info );
+            SaveMasterInfo( info );
+            ChangeState( RST_SLAVE );
         }
         break;
 
+    case REID_MASTER_HEARTBEAT:
+        // a master of an older term is stale
+        if( pEvent->GetTerm() >= GetTerm() )
+            ChangeState( RST_SLAVE, const_cast< ROLE_EVENT* >( pEvent ) );
+        break;
+
     case REID_TIMER_TIMEOUT:
-        ChangeState( RST_DEFINER );
+        if( m_WarmRole == RST_MASTER )
+        {
+            // no other master answered: resume the master role
+            ChangeState( RST_MASTER );
+        }
+        else if( m_WarmRole == RST_SLAVE )
+        {
+            // the remembered master is gone: fall back to the cold start
+            m_WarmRole = RST_NONE;
+            ORASetTimer( m_hTimer, NO_ROLE_LEISURE_TIMEOUT );
+            SendEvent( REVENT_QUERY_MASTER_INFO( m_DeviceID ) );
+        }
+        else
+        {
+            ChangeState( RST_DEFINER );
+        }
         break;
 
     default:
@@ -397,7 +823,7 @@ ORA_VOID CRoleManager::CPreRoleState::Activate( ORA_VOID *pParam /* = ORA_NULL *
     ORA_ASSERT( m_hTimer == ORA_NULL );
     m_hTimer = ORACreateTimer( CRoleState::TimeoutHandler, this );
     ORASetTimer( m_hTimer, PRE_ROLE_LEISURE_TIMEOUT );
-    SendEvent( new REVENT_QUERY_MASTER_INFO( m_DeviceID ) );
+    SendEvent( REVENT_QUERY_MASTER_INFO( m_DeviceID ) );
 }
 
 /**
@@ -435,19 +861,27 @@ ORA_VOID CRoleManager::CPreRoleState::ProcessEvent( const ROLE_EVENT *pEvent )
         break;
 
     case REID_FETACH_AP_RSSI:
-        //SendEvent( new REVENT_FETACH_AP_RSSI_RESP( GetApRSSI() ) );
+        {
+            // a device without a fresh sample is no candidate
+            ORA_INT32 rssi = GetApRSSI();
+            if( rssi != RSSI_UNKNOWN )
+                SendEventTo( pEvent->GetSender(), REVENT_FETACH_AP_RSSI_RESP( m_DeviceID, rssi ) );
+        }
         break;
 
     case REID_MASTER_DETECTED:
         {
-            const REVENT_MASTER_DETECTED *pInfo = reinterpret_cast< const REVENT_MASTER_DETECTED* >( pEvent );
-            //SaveMasterInfo( pInfo->GetMasterInfo() );
+            MASTER_INFO info;
+            reinterpret_cast< const REVENT_MASTER_DETECTED* >( pEvent )->GetMasterInfo( info );
+            SaveMasterInfo( info );
             ChangeState( RST_SLAVE );
         }
         break;
 
-    case REID_TIMER_TIMEOUT:
-        ChangeState( RST_NO_ROLE );
+    case REID_MASTER_HEARTBEAT:
+        // a master of an older term is stale
+        if( pEvent->GetTerm() >= GetTerm() )
+            ChangeState( RST_SLAVE, const_cast< ROLE_EVENT* >( pEvent ) );
         break;
 
     default:
@@ -468,6 +902,9 @@ ORA_VOID CRoleManager::CPreRoleState::ProcessEvent( const ROLE_EVENT *pEvent )
 CRoleManager::CDefinerState::CDefinerState( CRoleManager *pContext )
     : CRoleState( pContext )
 {
+    m_BestID    = 0;
+    m_BestRSSI  = RSSI_UNKNOWN;
+    m_bProposed = ORA_FALSE;
 }
 
 /**
@@ -486,7 +923,16 @@ CRoleManager::CDefinerState::~CDefinerState()
  */
 ORA_VOID CRoleManager::CDefinerState::Activate( ORA_VOID *pParam /* = ORA_NULL */ )
 {
-    // Do nothing.
+    ORA_ASSERT( m_hTimer == ORA_NULL );
+    m_hTimer = ORACreateTimer( CRoleState::TimeoutHandler, this );
+    ORASetTimer( m_hTimer, DEFINER_LEISURE_TIMEOUT );
+
+    // the definer is a candidate itself, the pre-role devices answer with their AP RSSI
+    m_BestID    = m_DeviceID;
+    m_BestRSSI  = GetApRSSI();
+    m_bProposed = ORA_FALSE;
+    SendEvent( REVENT_DEFINER_DETECTED( m_DeviceID ) );
+    SendEvent( REVENT_FETACH_AP_RSSI( m_DeviceID ) );
 }
 
 /**
@@ -497,7 +943,8 @@ ORA_VOID CRoleManager::CDefinerState::Activate( ORA_VOID *pParam /* = ORA_NULL *
  */
 ORA_VOID CRoleManager::CDefinerState::Deactivate( ORA_BOOL bForced /* = ORA_FALSE */ )
 {
-    // Do nothing.
+    ORADestroyTimer( m_hTimer );
+    m_hTimer = ORA_NULL;
 }
 
 /**
@@ -507,7 +954,61 @@ ORA_VOID CRoleManager::CDefinerState::Deactivate( ORA_BOOL bForced /* = ORA_FALS
  */
 ORA_VOID CRoleManager::CDefinerState::ProcessEvent( const ROLE_EVENT *pEvent )
 {
-    // Do nothing.
+    ORA_ASSERT( pEvent );
+    switch( pEvent->GetEventID() )
+    {
+    case REID_DEFINER_DETECTED:
+        // two definers: the lower device id defines
+        if( pEvent->GetSender() < m_DeviceID )
+            ChangeState( RST_PRE_ROLE );
+        break;
+
+    case REID_MASTER_DETECTED:
+        {
+            MASTER_INFO info;
+            reinterpret_cast< const REVENT_MASTER_DETECTED* >( pEvent )->GetMasterInfo( info );
+            SaveMasterInfo( info );
+            ChangeState( RST_SLAVE );
+        }
+        break;
+
+    case REID_MASTER_HEARTBEAT:
+        // a master of an older term is stale
+        if( pEvent->GetTerm() >= GetTerm() )
+            ChangeState( RST_SLAVE, const_cast< ROLE_EVENT* >( pEvent ) );
+        break;
+
+    case REID_FETACH_AP_RSSI_RESP:
+        {
+            // the best AP link is the master, the lower device id of an equal one
+            ORA_INT32   rssi   = reinterpret_cast< const REVENT_FETACH_AP_RSSI_RESP* >( pEvent )->GetRSSI();
+            DEVICE_ID_T sender = pEvent->GetSender();
+            if( !m_bProposed && rssi != RSSI_UNKNOWN &&
+                    ( rssi > m_BestRSSI || ( rssi == m_BestRSSI && sender < m_BestID ) ) )
+            {
+                m_BestID   = sender;
+                m_BestRSSI = rssi;
+            }
+        }
+        break;
+
+    case REID_TIMER_TIMEOUT:
+        // 1. ask the best candidate to take the master role, it confirms by its heartbeat
+        if( !m_bProposed && m_BestID != m_DeviceID )
+        {
+            m_bProposed = ORA_TRUE;
+            SendEventTo( m_BestID, REVENT_SET_MASTER_INFO( m_DeviceID ) );
+            ORASetTimer( m_hTimer, DEFINER_CONFIRM_TIMEOUT );
+            break;
+        }
+
+        // 2. the definer is the best candidate, or the chosen one didn't confirm
+        ChangeState( RST_MASTER );
+        break;
+
+    default:
+        ORA_ASSERT(ORA_FALSE);
+    }
 }
 // END: CDefinerState
 //////////////////////////////////////////////////////////////////////////////
@@ -521,8 +1022,10 @@ ORA_VOID CRoleManager::CDefinerState::ProcessEvent( const ROLE_EVENT *pEvent )
  * @param pContext  the role manager context for inner state using.
  */
 CRoleManager::CSlaveState::CSlaveState( CRoleManager *pContext )
-    : CRoleState( pContext )
+    : CRoleState( pContext ),
+      m_Detector( MASTER_SUSPICION_MIN_STDDEV, MASTER_SUSPICION_PAUSE )
 {
+    m_Rank = 0;
 }
 
 /**
@@ -541,7 +1044,23 @@ CRoleManager::CSlaveState::~CSlaveState()
  */
 ORA_VOID CRoleManager::CSlaveState::Activate( ORA_VOID *pParam /* = ORA_NULL */ )
 {
-    // Do nothing.
+    ORA_ASSERT( m_hTimer == ORA_NULL );
+    m_hTimer = ORACreateTimer( CRoleState::TimeoutHandler, this );
+    m_Rank   = 0;
+
+    // 1. follow the master whose heartbeat brought us here
+    if( pParam )
+    {
+        Follow( reinterpret_cast< const REVENT_MASTER_HEARTBEAT* >( pParam ), ORA_TRUE );
+        return;
+    }
+
+    // 2. the master was detected without a heartbeat: announce to it, and wait for the first one
+    m_Detector.Reset( MASTER_HEAT_BEAT_INTERVAL );
+    m_Detector.Heartbeat( RoleGetTickMs() );
+    ArmSuspicion();
+    if( GetMasterInfo().DeviceID )
+        SendEventTo( GetMasterInfo().DeviceID, REVENT_SLAVE_ALIVE( m_DeviceID, 0 ) );
 }
 
 /**
@@ -552,7 +1071,9 @@ ORA_VOID CRoleManager::CSlaveState::Activate( ORA_VOID *pParam /* = ORA_NULL */
  */
 ORA_VOID CRoleManager::CSlaveState::Deactivate( ORA_BOOL bForced /* = ORA_FALSE */ )
 {
-    // Do nothing.
+    ORADestroyTimer( m_hTimer );
+    m_hTimer = ORA_NULL;
+    m_Rank   = 0;
 }
 
 /**
@@ -562,7 +1083,95 @@ ORA_VOID CRoleManager::CSlaveState::Deactivate( ORA_BOOL bForced /* = ORA_FALSE
  */
 ORA_VOID CRoleManager::CSlaveState::ProcessEvent( const ROLE_EVENT *pEvent )
 {
-    // Do nothing.
+    ORA_ASSERT( pEvent );
+    switch( pEvent->GetEventID() )
+    {
+    case REID_MASTER_HEARTBEAT:
+        {
+            // a heartbeat of an older term is stale, and of two masters in the same term the lower device id wins
+            DEVICE_ID_T master = GetMasterInfo().DeviceID;
+            if( pEvent->GetTerm() < GetTerm() ||
+                ( pEvent->GetTerm() == GetTerm() && pEvent->GetSender() > master ) )
+                break;
+
+            Follow( reinterpret_cast< const REVENT_MASTER_HEARTBEAT* >( pEvent ), pEvent->GetSender() != master );
+        }
+        break;
+
+    case REID_TIMER_TIMEOUT:
+        {
+            // the timer is armed for the turn of this slave, it's confirmed on the clock
+            ORA_UINT64 now     = RoleGetTickMs();
+            ORA_UINT64 silence = now - m_Detector.GetLastHeartbeat();
+            if( m_Detector.Phi( now ) < MASTER_SUSPICION_THRESHOLD || silence < TurnAfter() )
+            {
+                ArmSuspicion( silence );
+                break;
+            }
+        }
+
+        // the master is suspected: a ranked successor takes over in its turn, the others elect again
+        if( m_Rank > 0 )
+            ChangeState( RST_MASTER );
+        else
+            ChangeState( RST_NO_ROLE );
+        break;
+
+    default:
+        ORA_ASSERT(ORA_FALSE);
+    }
+}
+
+/**
+ * @brief follow the master of a heartbeat, and wait for the next one
+ *
+ * @param pBeat the heartbeat
+ * @param bJoin the master is new to this slave, announce to it
+ */
+ORA_VOID CRoleManager::CSlaveState::Follow( const REVENT_MASTER_HEARTBEAT *pBeat, ORA_BOOL bJoin )
+{
+    ORA_ASSERT( pBeat );
+    MASTER_INFO info;
+    pBeat->GetMasterInfo( info );
+    SaveMasterInfo( info );
+    SetTerm( pBeat->GetTerm() );
+
+    // 1. a new master is measured from scratch
+    if( bJoin )
+        m_Detector.Reset( MASTER_HEAT_BEAT_INTERVAL );
+    m_Detector.Heartbeat( RoleGetTickMs() );
+
+    // 2. the master keeps its slaves only while they answer: the successors answer every
+    // heartbeat, the others every SLAVE_ALIVE_BEATS
+    m_Rank = pBeat->GetSuccessorRank( m_DeviceID );
+    if( bJoin || m_Rank > 0 || pBeat->GetBeat() % SLAVE_ALIVE_BEATS == 0 )
+        SendEventTo( info.DeviceID, REVENT_SLAVE_ALIVE( m_DeviceID, pBeat->GetBeat() ) );
+
+    ArmSuspicion();
+}
+
+/**
+ * @brief the silence of the master after which this slave acts, its suspicion and the turn of
+ * this slave after it: the successors take over one heartbeat interval apart, the others give
+ * up after all of them.
+ *
+ * @return ms after the last heartbeat
+ */
+ORA_UINT32 CRoleManager::CSlaveState::TurnAfter() const
+{
+    ORA_UINT32 turns = m_Rank > 0 ? m_Rank - 1 : ROLE_SUCCESSOR_COUNT;
+    return m_Detector.SuspectAfter( MASTER_SUSPICION_THRESHOLD ) + turns * MASTER_HEAT_BEAT_INTERVAL;
+}
+
+/**
+ * @brief arm the timer for the turn of this slave
+ *
+ * @param silence   ms since the last heartbeat of the master
+ */
+ORA_VOID CRoleManager::CSlaveState::ArmSuspicion( ORA_UINT64 silence /* = 0 */ )
+{
+    ORA_UINT32 turn = TurnAfter();
+    ORASetTimer( m_hTimer, turn > silence ? static_cast< ORA_UINT32 >( turn - silence ) : 1 );
 }
 // END: CSlaveState
 //////////////////////////////////////////////////////////////////////////////
@@ -578,6 +1187,8 @@ ORA_VOID CRoleManager::CSlaveState::ProcessEvent( const ROLE_EVENT *pEvent )
 CRoleManager::CMasterState::CMasterState( CRoleManager *pContext )
     : CRoleState( pContext )
 {
+    m_Beat           = 0;
+    m_SuccessorCount = 0;
 }
 
 /**
@@ -596,7 +1207,19 @@ CRoleManager::CMasterState::~CMasterState()
  */
 ORA_VOID CRoleManager::CMasterState::Activate( ORA_VOID *pParam /* = ORA_NULL */ )
 {
-    // Do nothing.
+    ORA_ASSERT( m_hTimer == ORA_NULL );
+    m_hTimer = ORACreateTimer( CRoleState::TimeoutHandler, this );
+
+    // 1. a new master opens a new term, the heartbeats of the older terms are stale from now on.
+    // it announces the mesh address of this device, the slaves reach it there
+    SetTerm( GetTerm() + 1 );
+    SaveMasterInfo( MASTER_INFO( m_DeviceID, GetDeviceAddress().c_str() ) );
+
+    // 2. the slaves announce themselves again, announce the new term at once
+    m_Beat           = 0;
+    m_SuccessorCount = 0;
+    m_Slaves.clear();
+    Heartbeat();
 }
 
 /**
@@ -607,7 +1230,10 @@ ORA_VOID CRoleManager::CMasterState::Activate( ORA_VOID *pParam /* = ORA_NULL */
  */
 ORA_VOID CRoleManager::CMasterState::Deactivate( ORA_BOOL bForced /* = ORA_FALSE */ )
 {
-    // Do nothing.
+    ORADestroyTimer( m_hTimer );
+    m_hTimer         = ORA_NULL;
+    m_SuccessorCount = 0;
+    m_Slaves.clear();
 }
 
 /**
@@ -617,7 +1243,92 @@ ORA_VOID CRoleManager::CMasterState::Deactivate( ORA_BOOL bForced /* = ORA_FALSE
  */
 ORA_VOID CRoleManager::CMasterState::ProcessEvent( const ROLE_EVENT *pEvent )
 {
-    // Do nothing.
+    ORA_ASSERT( pEvent );
+    switch( pEvent->GetEventID() )
+    {
+    case REID_QUERY_MASTER_INFO:
+        // answer the device directly, it joins as a slave
+        SendEventTo( pEvent->GetSender(),
+                     REVENT_MASTER_HEARTBEAT( m_DeviceID, GetMasterInfo(), m_Beat, m_Successors, m_SuccessorCount ) );
+        break;
+
+    case REID_SLAVE_ALIVE:
+        {
+            ORA_UINT32 beat = reinterpret_cast< const REVENT_SLAVE_ALIVE* >( pEvent )->GetBeat();
+            map< DEVICE_ID_T, SLAVE_ENTRY >::iterator it = m_Slaves.find( pEvent->GetSender() );
+            if( it == m_Slaves.end() )
+            {
+                SLAVE_ENTRY entry = { m_Beat, ORA_FALSE };
+                m_Slaves.insert( make_pair( pEvent->GetSender(), entry ) );
+            }
+            else if( beat > it->second.LastBeat && beat <= m_Beat )
+            {
+                it->second.LastBeat = beat;
+            }
+        }
+        break;
+
+    case REID_MASTER_HEARTBEAT:
+        // two masters: the one of the older term, or the higher device id in the same term, steps down
+        if( pEvent->GetSender() != m_DeviceID &&
+            ( pEvent->GetTerm() > GetTerm() ||
+              ( pEvent->GetTerm() == GetTerm() && pEvent->GetSender() < m_DeviceID ) ) )
+            ChangeState( RST_SLAVE, const_cast< ROLE_EVENT* >( pEvent ) );
+        break;
+
+    case REID_TIMER_TIMEOUT:
+        m_Beat++;
+        Heartbeat();
+        break;
+
+    default:
+        ORA_ASSERT(ORA_FALSE);
+    }
+}
+
+/**
+ * @brief rank the successors, then broadcast the heartbeat and arm the next one
+ */
+ORA_VOID CRoleManager::CMasterState::Heartbeat()
+{
+    RankSuccessors();
+    SendEvent( REVENT_MASTER_HEARTBEAT( m_DeviceID, GetMasterInfo(), m_Beat, m_Successors, m_SuccessorCount ) );
+    ORASetTimer( m_hTimer, MASTER_HEAT_BEAT_INTERVAL );
+}
+
+/**
+ * @brief drop the slaves which stopped answering, and rank the lowest live device ids
+ */
+ORA_VOID CRoleManager::CMasterState::RankSuccessors()
+{
+    m_SuccessorCount = 0;
+    map< DEVICE_ID_T, SLAVE_ENTRY >::iterator it = m_Slaves.begin();
+    while( it != m_Slaves.end() )
+    {
+        // 1. a successor which missed the heartbeats would not take over in time, and a slave
+        // which missed as many of its answers has left the mesh
+        SLAVE_ENTRY &entry  = it->second;
+        ORA_UINT32   window = MASTER_HEAT_BEAT_TIMEOUT / MASTER_HEAT_BEAT_INTERVAL;
+        if( m_Beat - entry.LastBeat > ( entry.bRanked ? window : window * SLAVE_ALIVE_BEATS ) )
+        {
+            m_Slaves.erase( it++ );
+            continue;
+        }
+
+        // 2. the lowest device ids are ranked, as the election prefers them; a slave is newly
+        // ranked only if it answered in the last round, a departed one must not hold a turn
+        if( m_SuccessorCount < ROLE_SUCCESSOR_COUNT &&
+            ( entry.bRanked || m_Beat - entry.LastBeat <= SLAVE_ALIVE_BEATS ) )
+        {
+            entry.bRanked = ORA_TRUE;
+            m_Successors[m_SuccessorCount++] = it->first;
+        }
+        else
+        {
+            entry.bRanked = ORA_FALSE;
+        }
+        ++it;
+    }
 }
 // END: CMasterState
 //////////////////////////////////////////////////////////////////////////////
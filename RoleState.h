@@ -5,6 +5,11 @@
 #include "Profile.h"
 #include "CommService.h"
 #include "RSEvent.h"
+#include "RoleEventQueue.h"
+#include "FailureDetector.h"
+#include "RssiSampler.h"
+#include "RoleEventCodec.h"
+#include "RoleCoalescer.h"
 
 #include <map>
 
@@ -26,6 +31,28 @@ public:
         RST_STATE_TYPE_COUNT    ///< the RoleState Type's total amount
     };
 
+    /**
+     * @name RoleTransitionAction what the current state does on a role event
+     * @{ */
+    enum RoleTransitionAction
+    {
+        RTA_UNSET,      ///< not filled, the transition table is rejected at compile time
+        RTA_IGNORE,     ///< the event means nothing in this state
+        RTA_GOTO,       ///< change to the next state directly
+        RTA_HANDLE      ///< the state's ProcessEvent() decides
+    };
+    /**  @} */
+
+    /* Callback : told every state change in the role thread, before the new state is activated */
+    typedef ORA_VOID (* RoleStateCallback)( RoleStateType state, ORA_VOID *pContext );
+
+    /* Struct : ROLE_TRANSITION, one cell of the state x event transition table */
+    struct ROLE_TRANSITION
+    {
+        RoleTransitionAction Action;
+        RoleStateType        Next;      ///< RTA_GOTO: the next state
+    };
+
 // Inner role state class for role manager.
 protected:
     /**
@@ -58,6 +85,26 @@ protected:
          */
         ORA_VOID ChangeState( RoleStateType state, ORA_VOID *pParam = ORA_NULL, ORA_BOOL bForced = ORA_FALSE );
 
+        /**
+         * @brief set the activation epoch of this state, the timeouts of an earlier activation are dropped.
+         *
+         * @param epoch activation epoch
+         */
+        inline ORA_VOID SetEpoch( ORA_UINT32 epoch )
+        {
+            m_Epoch = epoch;
+        }
+
+        /**
+         * @brief set the device id this state announces itself with
+         *
+         * @param id    device id
+         */
+        inline ORA_VOID SetDeviceID( DEVICE_ID_T id )
+        {
+            m_DeviceID = id;
+        }
+
     // Overrides
     public:
         /**
@@ -95,13 +142,35 @@ protected:
         /**
          * @brief send the event the target devices via broadcast/unicast/multicast approach, or tigger internal timeout event.
          * @note (TBD: or security transfer - TCP)
-         * @param pEvent the event data
+         * @param event the event data, it is serialized before returning, so a temporary is fine.
          */
-        inline ORA_VOID SendEvent( const ROLE_EVENT *pEvent )
+        inline ORA_VOID SendEvent( const ROLE_EVENT &event )
         {
             ORA_ASSERT( m_pContext );
-            ORA_ASSERT( pEvent );
-            m_pContext->SendEvent( pEvent );
+            m_pContext->SendEvent( event );
+        }
+
+        /**
+         * @brief send the event to the specified device via unicast approach.
+         *
+         * @param target  the target device id
+         * @param event   the event data
+         */
+        inline ORA_VOID SendEventTo( DEVICE_ID_T target, const ROLE_EVENT &event )
+        {
+            ORA_ASSERT( m_pContext );
+            m_pContext->SendEventTo( target, event );
+        }
+
+        /**
+         * @brief take the role of the last run for warm start, it is taken only once.
+         *
+         * @return role state type, RST_NONE if there is no warm start
+         */
+        inline RoleStateType TakeWarmRole()
+        {
+            ORA_ASSERT( m_pContext );
+            return m_pContext->TakeWarmRole();
         }
 
         /**
@@ -120,12 +189,45 @@ protected:
          *
          * @return MASTER_INFO handler
          */
-        inline MASTER_INFO& GetMasterInfo() const
+        inline const MASTER_INFO& GetMasterInfo() const
         {
             ORA_ASSERT( m_pContext );
             return m_pContext->GetMasterInfo();
         }
 
+        /**
+         * @brief get the mesh IP address of this device
+         *
+         * @return IP address, empty before it is set
+         */
+        inline string GetDeviceAddress() const
+        {
+            ORA_ASSERT( m_pContext );
+            return m_pContext->GetDeviceAddress();
+        }
+
+        /**
+         * @brief get the latest master term this device knows
+         *
+         * @return master term, 0 before any master is heard
+         */
+        inline ORA_UINT32 GetTerm() const
+        {
+            ORA_ASSERT( m_pContext );
+            return m_pContext->GetTerm();
+        }
+
+        /**
+         * @brief set the latest master term, it is stamped on every event sent from now on
+         *
+         * @param term  master term
+         */
+        inline ORA_VOID SetTerm( ORA_UINT32 term )
+        {
+            ORA_ASSERT( m_pContext );
+            m_pContext->SetTerm( term );
+        }
+
         inline ORA_INT32 GetApRSSI() const
         {
             ORA_ASSERT( m_pContext );
@@ -149,6 +251,7 @@ protected:
     protected:
         DEVICE_ID_T   m_DeviceID;      ///< Device UUID
         ORA_HTIMER    m_hTimer;        ///< Timer handler for timeout event
+        ORA_UINT32    m_Epoch;         ///< activation epoch, posted with the timeout
     };
     /**  @} */
 
@@ -159,10 +262,40 @@ protected:
     {
     // Assistant definition
     private:
-        #define NO_ROLE_LEISURE_TIMEOUT     8 * 1000
-        #define PRE_ROLE_LEISURE_TIMEOUT    8 * 1000
-        #define DEFINER_LEISURE_TIMEOUT     8 * 1000
-        #define MASTER_HEAT_BEAT_TIMEOUT    8 * 1000
+        // the timeouts can be overridden at build time, e.g. to benchmark them in the simulator
+        #ifndef NO_ROLE_LEISURE_TIMEOUT
+        #define NO_ROLE_LEISURE_TIMEOUT     ( 8 * 1000 )
+        #endif
+        #ifndef PRE_ROLE_LEISURE_TIMEOUT
+        #define PRE_ROLE_LEISURE_TIMEOUT    ( 8 * 1000 )
+        #endif
+        #ifndef DEFINER_LEISURE_TIMEOUT
+        #define DEFINER_LEISURE_TIMEOUT     ( 8 * 1000 )
+        #endif
+        #ifndef DEFINER_CONFIRM_TIMEOUT
+        #define DEFINER_CONFIRM_TIMEOUT     ( 1 * 1000 )    ///< wait for the heartbeat of the chosen master
+        #endif
+        #ifndef MASTER_HEAT_BEAT_INTERVAL
+        #define MASTER_HEAT_BEAT_INTERVAL   ( 1 * 1000 )    ///< the master announces itself
+        #endif
+        #ifndef MASTER_HEAT_BEAT_TIMEOUT
+        #define MASTER_HEAT_BEAT_TIMEOUT    ( 3 * MASTER_HEAT_BEAT_INTERVAL )   ///< a ranked successor silent for this long is dropped
+        #endif
+        #ifndef SLAVE_ALIVE_BEATS
+        #define SLAVE_ALIVE_BEATS           5       ///< heartbeats, an unranked slave answers every this many
+        #endif
+        #ifndef MASTER_SUSPICION_THRESHOLD
+        #define MASTER_SUSPICION_THRESHOLD  8.0     ///< phi, the slaves fail over from then on
+        #endif
+        #ifndef MASTER_SUSPICION_PAUSE
+        #define MASTER_SUSPICION_PAUSE      MASTER_HEAT_BEAT_INTERVAL   ///< a single lost heartbeat is not suspected
+        #endif
+        #ifndef MASTER_SUSPICION_MIN_STDDEV
+        #define MASTER_SUSPICION_MIN_STDDEV ( MASTER_HEAT_BEAT_INTERVAL / 10 )
+        #endif
+        #ifndef WARM_START_CONFIRM_TIMEOUT
+        #define WARM_START_CONFIRM_TIMEOUT  ( 1 * 1000 )    ///< wait for the remembered master to confirm
+        #endif
 
     // Constructor & Destructor
     public:
@@ -221,6 +354,10 @@ protected:
          * @param pContext  context of CNoRoleState
          */
         static ORA_VOID TimerHandler( ORA_HTIMER hTimer, ORA_VOID *pContext );
+
+    // Properties
+    private:
+        RoleStateType m_WarmRole;   ///< role of the last run being confirmed, RST_NONE for cold start
     };
     /**  @} */
 
@@ -331,6 +468,12 @@ protected:
         {
             return RST_DEFINER;
         }
+
+    // Properties
+    private:
+        DEVICE_ID_T m_BestID;       ///< the master candidate with the best AP RSSI so far
+        ORA_INT32   m_BestRSSI;     ///< dBm, its RSSI
+        ORA_BOOL    m_bProposed;    ///< the candidate has been asked to take the master role
     };
     /**  @} */
 
@@ -386,6 +529,35 @@ protected:
         {
             return RST_SLAVE;
         }
+
+    // Assistants
+    private:
+        /**
+         * @brief follow the master of a heartbeat, and wait for the next one
+         *
+         * @param pBeat the heartbeat
+         * @param bJoin the master is new to this slave, announce to it
+         */
+        ORA_VOID Follow( const REVENT_MASTER_HEARTBEAT *pBeat, ORA_BOOL bJoin );
+
+        /**
+         * @brief the silence of the master after which this slave acts: its suspicion, and the turn of this slave after it
+         *
+         * @return ms after the last heartbeat
+         */
+        ORA_UINT32 TurnAfter() const;
+
+        /**
+         * @brief arm the timer for the turn of this slave
+         *
+         * @param silence   ms since the last heartbeat of the master
+         */
+        ORA_VOID ArmSuspicion( ORA_UINT64 silence = 0 );
+
+    // Properties
+    private:
+        ORA_UINT32       m_Rank;        ///< the rank among the master's successors, 0 if not ranked
+        CFailureDetector m_Detector;    ///< the liveness of the master, fed by its heartbeats
     };
     /**  @} */
 
@@ -441,6 +613,34 @@ protected:
         {
             return RST_MASTER;
         }
+
+    // Assistant Structure
+    private:
+        /* Struct : SLAVE_ENTRY, a slave which has announced itself to the master */
+        struct SLAVE_ENTRY
+        {
+            ORA_UINT32 LastBeat;    ///< the last heartbeat it answered
+            ORA_BOOL   bRanked;     ///< it is one of the successors
+        };
+
+    // Assistants
+    private:
+        /**
+         * @brief rank the successors, then broadcast the heartbeat and arm the next one
+         */
+        ORA_VOID Heartbeat();
+
+        /**
+         * @brief drop the slaves which stopped answering, and rank the lowest live device ids
+         */
+        ORA_VOID RankSuccessors();
+
+    // Properties
+    private:
+        ORA_UINT32                        m_Beat;       ///< heartbeats sent in this term
+        map< DEVICE_ID_T, SLAVE_ENTRY >   m_Slaves;     ///< the slaves by device id
+        DEVICE_ID_T                       m_Successors[ROLE_SUCCESSOR_COUNT];
+        ORA_UINT32                        m_SuccessorCount;
     };
     /**  @} */
 
@@ -463,38 +663,185 @@ public:
 // Operations
 public:
     /**
-     * @brief set current state to specified state
+     * @brief request the role thread to change to specified state, it returns at once.
      *
      * @param state   RoleStateType value.
-     * @param pParam  Allow the caller passes by a parameter to new state.
-     * @param bForced force to deactive previous status
-     * @note: if forced flag used, it perhaps break out the previous state's handling procedure.
      */
-    ORA_VOID SetState( RoleStateType state, ORA_VOID *pParam = ORA_NULL, ORA_BOOL bForced = ORA_FALSE );
+    ORA_VOID PostState( RoleStateType state );
+
+    /**
+     * @brief post the timeout of a state to the role thread, called by the state's timer.
+     *
+     * @param epoch   the activation epoch of the state which armed the timer
+     */
+    ORA_VOID PostTimeout( ORA_UINT32 epoch );
+
+    /**
+     * @brief get the counters of the role event queue
+     */
+    inline ROLE_QUEUE_STATS_T GetEventQueueStats() const
+    {
+        return m_EventQueue.GetStats();
+    }
+
+    /**
+     * @brief get the counters of the sent events and the datagrams they were coalesced into
+     */
+    inline ROLE_COALESCE_STATS_T GetCoalesceStats() const
+    {
+        return m_Coalescer.GetStats();
+    }
+
+    /**
+     * @brief process the queued events, timeouts and state requests in the caller's thread.
+     * @note it is the body of the role thread. a role manager which is not started, e.g. in the
+     * simulator, is driven by calling it directly from one thread.
+     *
+     * @return the number of processed items
+     */
+    ORA_UINT32 ProcessQueue();
+
+    /**
+     * @brief set the device id the role states announce themselves with
+     * @note the function should be called before the first state.
+     *
+     * @param id    device id
+     */
+    ORA_VOID SetDeviceID( DEVICE_ID_T id );
+
+    /**
+     * @brief set the mesh IP address of this device, it is announced while this device is the master
+     *
+     * @param ipAddr  IP address on the mesh
+     */
+    ORA_VOID SetDeviceAddress( const string &ipAddr );
+
+    /**
+     * @brief get the mesh IP address of this device
+     *
+     * @return IP address, empty before it is set
+     */
+    string GetDeviceAddress() const;
+
+    /**
+     * @brief set the callback told every state change
+     * @note the function should be called before Start().
+     *
+     * @param pCallback the callback, ORA_NULL for none
+     * @param pContext  passed back to the callback
+     */
+    inline ORA_VOID SetStateCallback( RoleStateCallback pCallback, ORA_VOID *pContext )
+    {
+        m_pStateCallback = pCallback;
+        m_pStateContext  = pContext;
+    }
 
     /**
      * @brief send the event the target devices via broadcast/unicast/multicast approach, or tigger internal timeout event.
      * @note (TBD: or security transfer - TCP)
-     * @param pEvent the event data
+     * @param event the event data, it is serialized before returning, so a temporary is fine.
+     * it is coalesced with the other events to the same destination, they are sent together
+     * before the role thread goes idle, or after ROLE_COALESCE_WINDOW at the latest.
      */
-    ORA_VOID SendEvent( const ROLE_EVENT *pEvent );
+    ORA_VOID SendEvent( const ROLE_EVENT &event );
 
     /**
-     * @brief get devices' wifi rssi
-     * !!! TBD: if need cache RSSI, and always return one value.
+     * @brief send the event to the specified device via unicast approach.
      *
-     * @return RSSI value
+     * @param target  the target device id
+     * @param event   the event data
+     */
+    ORA_VOID SendEventTo( DEVICE_ID_T target, const ROLE_EVENT &event );
+
+    /**
+     * @brief warm start from the checkpoint of the last run: the first NO_ROLE state probes
+     * the remembered master directly, and re-enters the role once it's confirmed.
+     * @note the function should be called before the first NO_ROLE state.
+     *
+     * @param role    the role of the last run
+     * @param term    the master term of the last run
+     * @param info    the master's information of the last run
+     */
+    ORA_VOID SetWarmStart( RoleStateType role, ORA_UINT32 term, const MASTER_INFO& info );
+
+    /**
+     * @brief take the role of the last run for warm start, it is taken only once.
+     *
+     * @return role state type, RST_NONE if there is no warm start
+     */
+    inline RoleStateType TakeWarmRole()
+    {
+        RoleStateType role = m_WarmRole;
+        m_WarmRole = RST_NONE;
+        return role;
+    }
+
+    /**
+     * @brief get the smoothed AP RSSI of this device, it never blocks: the radio is polled by
+     * the RSSI timer, and the value is read lock-free.
+     *
+     * @return dBm, RSSI_UNKNOWN if there is no fresh sample
      */
     ORA_INT32 GetDeviceRSSI() const;
 
     /**
-     * @brief get current state enumaration value.
+     * @brief get current state enumaration value, called in the role thread.
      *
      * @return RoleStateType value.
      */
     inline RoleStateType CurrentState() const
     {
-        return m_pCurrState ? m_pCurrState->GetStateType() : RST_NONE;
+        return m_CurrStateType;
+    }
+
+    /**
+     * @brief get the current state, the master term and the master's information for the other threads
+     *
+     * @param state   receives the current state
+     * @param term    receives the latest master term
+     * @param info    receives the master's information
+     */
+    inline ORA_VOID GetRoleSnapshot( RoleStateType &state, ORA_UINT32 &term, MASTER_INFO &info ) const
+    {
+        CORASectionLock lock( m_RoleLock );
+        state = m_CurrStateType;
+        term  = m_Term;
+        info  = m_MasterInfo;
+    }
+
+    /**
+     * @brief get the activation epoch of current state, it counts the state changes.
+     *
+     * @return activation epoch
+     */
+    inline ORA_UINT32 GetStateEpoch() const
+    {
+        return m_StateEpoch;
+    }
+
+    /**
+     * @brief get the latest master term this device knows
+     *
+     * @return master term, 0 before any master is heard
+     */
+    inline ORA_UINT32 GetTerm() const
+    {
+        return m_Term;
+    }
+
+    /**
+     * @brief set the latest master term, it is stamped on every event sent from now on.
+     * it is written by the role thread only, the lock is for GetRoleSnapshot()
+     *
+     * @param term  master term
+     */
+    inline ORA_VOID SetTerm( ORA_UINT32 term )
+    {
+        if( m_Term == term )
+            return;
+
+        CORASectionLock lock( m_RoleLock );
+        m_Term = term;
     }
 
     /**
@@ -504,15 +851,16 @@ public:
      */
     inline ORA_VOID SaveMasterInfo( const MASTER_INFO& info )
     {
+        CORASectionLock lock( m_RoleLock );
         m_MasterInfo = info;
     }
 
     /**
-     * @brief Get master's information
+     * @brief Get master's information, called in the role thread.
      *
      * @return MASTER_INFO handler
      */
-    inline MASTER_INFO& GetMasterInfo() const
+    inline const MASTER_INFO& GetMasterInfo() const
     {
         return m_MasterInfo;
     }
@@ -528,6 +876,7 @@ public:
 
     /**
      * @brief stop the role manager
+     * @note the network data receiver should be unbound from it before, the queue is closed here.
      */
     ORA_VOID Stop();
 
@@ -544,25 +893,85 @@ public:
 private:
     ORA_VOID OnMsgProcedure( const _MSG_HEAD *pMsg );
 
+// Assistants
+private:
+    /**
+     * @brief set current state to specified state, called in the role thread only.
+     *
+     * @param state   RoleStateType value.
+     * @param pParam  Allow the caller passes by a parameter to new state.
+     * @param bForced force to deactive previous status
+     * @note: if forced flag used, it perhaps break out the previous state's handling procedure.
+     */
+    ORA_VOID SetState( RoleStateType state, ORA_VOID *pParam = ORA_NULL, ORA_BOOL bForced = ORA_FALSE );
+
+    /**
+     * @brief process a queued item in the role thread
+     *
+     * @param item  the queued item
+     */
+    ORA_VOID DispatchItem( const ROLE_QUEUE_ITEM_T &item );
+
+    /**
+     * @brief dispatch a role event to the current state by the transition table
+     *
+     * @param pEvent role event
+     */
+    ORA_VOID DispatchEvent( const ROLE_EVENT *pEvent );
+
+    /**
+     * @brief queue an event of a received packet for the role thread
+     *
+     * @param header    the decoded header of the event
+     * @param pData     the event data behind the header
+     */
+    ORA_VOID PushEvent( const ROLE_WIRE_HEADER_T &header, const ORA_UINT8 *pData );
+
 // Thread routines
 private:
-    // TODO: using thread-mechnism to cache the event, and exit the callback call rapidly.
-    // it can make RecvDataPacket() responding higher effectively.
-    // static ORA_INT_PTR ListenEventThread( ORA_VOID* pContext );
+    /**
+     * @brief the role thread: it owns the current state, and processes the received events,
+     * the timeouts and the state requests in the order they are queued.
+     */
+    static ORA_INT_PTR ListenEventThread( ORA_VOID* pContext );
 
-// Properties
+// Callbacks
 private:
-    typedef std::map< RoleStateType, CRoleState* > CRoleStateMap;
+    /**
+     * @brief poll the radio for the RSSI, the response is folded in by OnMsgProcedure()
+     *
+     * @param hTimer    timer handler
+     * @param pContext  CRoleManager
+     */
+    static ORA_VOID RssiTimerHandler( ORA_HTIMER hTimer, ORA_VOID *pContext );
 
+// Properties
+private:
     INwDataDelivery *m_pDelivery;               ///< deliver the data to other network device
     CRoleState      *m_pCurrState;              ///< current role state handler
-    CRoleStateMap    m_RoleStateMap;            ///< A map container to hold all available role state instance
-    ORA_INT32        m_DeviceRSSI;
-
-    mutable MASTER_INFO m_MasterInfo;
-
-// TODO: performance improve...
-//    ORA_HTHREAD      m_hListenEventThread;
-//    mutable ORA_CRITICAL_SECTION m_EventLock;
+    RoleStateType    m_CurrStateType;           ///< current role state type, indexes the transition table
+
+    CNoRoleState     m_NoRoleState;             ///< the role states are held by value,
+    CPreRoleState    m_PreRoleState;            ///< and indexed by m_pStates
+    CDefinerState    m_DefinerState;
+    CSlaveState      m_SlaveState;
+    CMasterState     m_MasterState;
+    CRoleState      *m_pStates[RST_STATE_TYPE_COUNT];
+    CRoleCoalescer   m_Coalescer;               ///< packs the sent events per destination
+    CRssiSampler     m_RssiSampler;             ///< the smoothed AP RSSI, fed by the IPC responses
+    ORA_HTIMER       m_hRssiTimer;              ///< polls the radio every RSSI_SAMPLE_INTERVAL
+    RoleStateType    m_WarmRole;                ///< role of the last run, taken by the first NO_ROLE state
+    ORA_UINT32       m_StateEpoch;              ///< activation epoch of the current state
+    ORA_UINT32       m_Term;                    ///< the latest master term, raised by every new master
+    RoleStateCallback m_pStateCallback;         ///< told every state change
+    ORA_VOID         *m_pStateContext;
+
+    MASTER_INFO      m_MasterInfo;              ///< changed by SaveMasterInfo() only
+    string           m_DeviceAddr;              ///< the mesh IP address of this device
+    mutable ORA_CRITICAL_SECTION m_RoleLock;    ///< Lock m_CurrStateType, m_MasterInfo and m_DeviceAddr, the role thread reads the first two without
+
+    ORA_HTHREAD       m_hListenEventThread;     ///< the role thread
+    atomic< ORA_BOOL > m_bQuit;                 ///< set by Stop(), nothing is queued from then on
+    CRoleEventQueue   m_EventQueue;             ///< events, timeouts and state requests for the role thread
 };
 #endif
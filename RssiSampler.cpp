@@ -0,0 +1,73 @@
+#include "Base.h"
+#include "RssiSampler.h"
+
+#define RSSI_TIME_BITS  48
+#define RSSI_TIME_MASK  ( ( 1ULL << RSSI_TIME_BITS ) - 1 )
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: CRssiSampler
+CRssiSampler::CRssiSampler()
+{
+    Reset();
+}
+
+/**
+ * @brief forget the samples
+ */
+ORA_VOID CRssiSampler::Reset()
+{
+    m_Smoothed = 0;
+    m_bSampled = ORA_FALSE;
+    m_Published.store( 0, memory_order_release );
+}
+
+/**
+ * @brief fold a sample of the radio into the smoothed value, called from one thread only
+ *
+ * @param rssi  dBm
+ * @param now   ms, RoleGetTickMs()
+ */
+ORA_VOID CRssiSampler::Update( ORA_INT32 rssi, ORA_UINT64 now )
+{
+    // 1. the radio reports in [-127, 0], anything else is a failed read
+    if( rssi <= RSSI_UNKNOWN || rssi > 0 )
+        return;
+
+    // 2. the first sample is taken as it is, the later ones are averaged in
+    ORA_INT32 sample = rssi * ( 1 << RSSI_FRACTION_BITS );
+    if( m_bSampled )
+        m_Smoothed += ( sample - m_Smoothed ) / ( 1 << RSSI_EWMA_SHIFT );
+    else
+        m_Smoothed = sample;
+    m_bSampled = ORA_TRUE;
+
+    // 3. publish the value with its time, a timestamp of 0 would read as no sample
+    ORA_UINT64 stamp = ( now & RSSI_TIME_MASK ) ? ( now & RSSI_TIME_MASK ) : 1;
+    ORA_UINT64 word  = static_cast< ORA_UINT64 >( static_cast< ORA_UINT16 >( m_Smoothed ) ) << RSSI_TIME_BITS;
+    m_Published.store( word | stamp, memory_order_release );
+}
+
+/**
+ * @brief the smoothed value, lock-free from any thread
+ *
+ * @param now       ms, RoleGetTickMs()
+ * @param maxAge    ms, an older value is not trusted
+ *
+ * @return dBm, RSSI_UNKNOWN if there is no sample within maxAge
+ */
+ORA_INT32 CRssiSampler::Get( ORA_UINT64 now, ORA_UINT32 maxAge ) const
+{
+    ORA_UINT64 word = m_Published.load( memory_order_acquire );
+    if( word == 0 )
+        return RSSI_UNKNOWN;
+
+    ORA_UINT64 stamp = word & RSSI_TIME_MASK;
+    if( ( ( now - stamp ) & RSSI_TIME_MASK ) > maxAge )
+        return RSSI_UNKNOWN;
+
+    // round to the nearest dBm
+    ORA_INT32 smoothed = static_cast< ORA_INT16 >( word >> RSSI_TIME_BITS );
+    return ( smoothed - ( 1 << ( RSSI_FRACTION_BITS - 1 ) ) ) / ( 1 << RSSI_FRACTION_BITS );
+}
+// END: CRssiSampler
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,60 @@
+#ifndef __RSSI_SAMPLER_H__
+#define __RSSI_SAMPLER_H__
+
+#include <atomic>
+
+using namespace std;
+
+#define RSSI_UNKNOWN            ( -128 )        ///< dBm, there is no fresh sample
+#define RSSI_SAMPLE_INTERVAL    ( 2 * 1000 )    ///< ms, the radio is polled this often
+#define RSSI_MAX_AGE            ( 3 * RSSI_SAMPLE_INTERVAL )    ///< ms, an older value is not trusted
+#define RSSI_EWMA_SHIFT         2               ///< a new sample weighs 1 / 2^shift
+#define RSSI_FRACTION_BITS      8               ///< the smoothed value is kept in 1/256 dBm
+
+/**
+ * @name CRssiSampler the smoothed AP RSSI of this device, read by the role states without blocking.
+ *
+ * @note the samples come from one thread (the IPC responses), they are folded into an EWMA and
+ * published with their timestamp as one 64-bit word: the smoothed value in the top 16 bits and
+ * the ms timestamp in the low 48 bits. any thread reads the pair with a single atomic load.
+ * @{ */
+class CRssiSampler
+{
+// Constructor & Destructor
+public:
+    CRssiSampler();
+
+// Operations
+public:
+    /**
+     * @brief forget the samples
+     */
+    ORA_VOID Reset();
+
+    /**
+     * @brief fold a sample of the radio into the smoothed value, called from one thread only
+     *
+     * @param rssi  dBm
+     * @param now   ms, RoleGetTickMs()
+     */
+    ORA_VOID Update( ORA_INT32 rssi, ORA_UINT64 now );
+
+    /**
+     * @brief the smoothed value, lock-free from any thread
+     *
+     * @param now       ms, RoleGetTickMs()
+     * @param maxAge    ms, an older value is not trusted
+     *
+     * @return dBm, RSSI_UNKNOWN if there is no sample within maxAge
+     */
+    ORA_INT32 Get( ORA_UINT64 now, ORA_UINT32 maxAge ) const;
+
+// Properties
+private:
+    ORA_INT32            m_Smoothed;    ///< 1/256 dBm, the writer's state
+    ORA_BOOL             m_bSampled;    ///< the writer has a sample
+    atomic< ORA_UINT64 > m_Published;   ///< smoothed value << 48 | timestamp, 0 before the first sample
+};
+/**  @} */
+
+#endif /* __RSSI_SAMPLER_H__ */
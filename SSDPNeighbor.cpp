@@ -0,0 +1,249 @@
+#include "Base.h"
+#include "SSDPUtils.h"
+#include "SSDPNeighbor.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// BEG: CSSDPNeighborTable
+/**
+ * @brief constructor
+ *
+ * @param capacity initial slab capacity
+ */
+CSSDPNeighborTable::CSSDPNeighborTable( ORA_UINT32 capacity /* = SSDP_NEIGHBOR_CAPACITY */ )
+{
+    ORA_UINT32 size = 1;
+    while( size < capacity )
+        size <<= 1;
+
+    m_Slab.resize( size );
+    m_Index.assign( size * 2, SSDP_NBR_INVALID );   // keep the load factor under 0.5
+    m_Heap.reserve( size );
+    m_Size = 0;
+
+    // chain all entries to the free list
+    for( ORA_UINT32 i = 0; i < size; i++ )
+    {
+        m_Slab[i].InUse    = ORA_FALSE;
+        m_Slab[i].NextFree = ( i + 1 < size ) ? i + 1 : SSDP_NBR_INVALID;
+    }
+    m_FreeHead = 0;
+}
+
+CSSDPNeighborTable::~CSSDPNeighborTable()
+{
+    // Do nothing.
+}
+
+ORA_UINT32 CSSDPNeighborTable::Find( const ORA_CHAR *pLocation, ORA_SIZE len ) const
+{
+    ORA_UINT32 hash = CSSDPUtils::Hash( pLocation, len );
+    ORA_UINT32 mask = m_Index.size() - 1;
+
+    for( ORA_UINT32 slot = hash & mask; m_Index[slot] != SSDP_NBR_INVALID; slot = ( slot + 1 ) & mask )
+    {
+        const SSDP_NBR_T &nbr = m_Slab[ m_Index[slot] ];
+        if( nbr.Hash == hash && nbr.Location.size() == len && memcmp( nbr.Location.data(), pLocation, len ) == 0 )
+            return m_Index[slot];
+    }
+    return SSDP_NBR_INVALID;
+}
+
+ORA_UINT32 CSSDPNeighborTable::Insert( const ORA_CHAR *pLocation, ORA_SIZE len, ORA_INT64 deadline )
+{
+    ORA_ASSERT( Find( pLocation, len ) == SSDP_NBR_INVALID );
+
+    if( m_FreeHead == SSDP_NBR_INVALID )
+        Grow();
+
+    // 1. take an entry from the free list
+    ORA_UINT32 handle = m_FreeHead;
+    SSDP_NBR_T &nbr = m_Slab[handle];
+    m_FreeHead = nbr.NextFree;
+
+    // 2. setup the entry, the strings keep their capacity from the previous user
+    nbr.Location.assign( pLocation, len );
+    nbr.Usn.clear();
+    nbr.SmId.clear();
+    nbr.DeviceType.clear();
+    nbr.UpdateTime = 0;
+    nbr.Deadline   = deadline;
+    nbr.IfAddr     = 0;
+    nbr.Addr       = 0;
+    nbr.Stale      = ORA_FALSE;
+    nbr.Hash       = CSSDPUtils::Hash( pLocation, len );
+    nbr.NextFree   = SSDP_NBR_INVALID;
+    nbr.InUse      = ORA_TRUE;
+
+    // 3. index it, and order it by deadline
+    IndexInsert( handle );
+    nbr.HeapPos = m_Heap.size();
+    m_Heap.push_back( handle );
+    HeapUp( nbr.HeapPos );
+
+    m_Size++;
+    return handle;
+}
+
+ORA_VOID CSSDPNeighborTable::SetDeadline( ORA_UINT32 handle, ORA_INT64 deadline )
+{
+    ORA_ASSERT( handle < m_Slab.size() && m_Slab[handle].InUse );
+
+    SSDP_NBR_T &nbr = m_Slab[handle];
+    ORA_INT64 previous = nbr.Deadline;
+    nbr.Deadline = deadline;
+    if( deadline < previous )
+        HeapUp( nbr.HeapPos );
+    else
+        HeapDown( nbr.HeapPos );
+}
+
+ORA_VOID CSSDPNeighborTable::Remove( ORA_UINT32 handle )
+{
+    ORA_ASSERT( handle < m_Slab.size() && m_Slab[handle].InUse );
+
+    // 1. remove from the index with backward shift, so no tombstone is left
+    ORA_UINT32 mask = m_Index.size() - 1;
+    ORA_UINT32 hole = IndexSlot( handle );
+    ORA_UINT32 slot = hole;
+    while( ORA_TRUE )
+    {
+        slot = ( slot + 1 ) & mask;
+        if( m_Index[slot] == SSDP_NBR_INVALID )
+            break;
+
+        // move the entry back if its home slot is not within (hole, slot]
+        ORA_UINT32 home = m_Slab[ m_Index[slot] ].Hash & mask;
+        if( ( ( slot - home ) & mask ) >= ( ( slot - hole ) & mask ) )
+        {
+            m_Index[hole] = m_Index[slot];
+            hole = slot;
+        }
+    }
+    m_Index[hole] = SSDP_NBR_INVALID;
+
+    // 2. remove from the expiry heap: move the last one to its position
+    ORA_UINT32 pos  = m_Slab[handle].HeapPos;
+    ORA_UINT32 last = m_Heap.size() - 1;
+    if( pos != last )
+    {
+        HeapSwap( pos, last );
+        m_Heap.pop_back();
+        HeapDown( pos );
+        HeapUp( pos );
+    }
+    else
+    {
+        m_Heap.pop_back();
+    }
+
+    // 3. give the entry back to the free list
+    m_Slab[handle].InUse    = ORA_FALSE;
+    m_Slab[handle].NextFree = m_FreeHead;
+    m_FreeHead = handle;
+    m_Size--;
+}
+
+ORA_VOID CSSDPNeighborTable::Clear()
+{
+    for( ORA_UINT32 handle = First(); handle != SSDP_NBR_INVALID; handle = Next( handle ) )
+        Remove( handle );
+}
+
+ORA_UINT32 CSSDPNeighborTable::Next( ORA_UINT32 handle ) const
+{
+    for( ORA_UINT32 i = handle + 1; i < m_Slab.size(); i++ )
+    {
+        if( m_Slab[i].InUse )
+            return i;
+    }
+    return SSDP_NBR_INVALID;
+}
+
+/**
+ * @brief double the slab and rebuild the index, handles are kept
+ */
+ORA_VOID CSSDPNeighborTable::Grow()
+{
+    ORA_UINT32 oldSize = m_Slab.size();
+    ORA_UINT32 newSize = oldSize * 2;
+    printf("grow SSDP neighbor table %u -> %u\n", oldSize, newSize);
+
+    m_Slab.resize( newSize );
+    for( ORA_UINT32 i = oldSize; i < newSize; i++ )
+    {
+        m_Slab[i].InUse    = ORA_FALSE;
+        m_Slab[i].NextFree = ( i + 1 < newSize ) ? i + 1 : m_FreeHead;
+    }
+    m_FreeHead = oldSize;
+
+    m_Heap.reserve( newSize );
+    m_Index.assign( newSize * 2, SSDP_NBR_INVALID );
+    for( ORA_UINT32 i = 0; i < oldSize; i++ )
+    {
+        if( m_Slab[i].InUse )
+            IndexInsert( i );
+    }
+}
+
+ORA_VOID CSSDPNeighborTable::IndexInsert( ORA_UINT32 handle )
+{
+    ORA_UINT32 mask = m_Index.size() - 1;
+    ORA_UINT32 slot = m_Slab[handle].Hash & mask;
+    while( m_Index[slot] != SSDP_NBR_INVALID )
+        slot = ( slot + 1 ) & mask;
+    m_Index[slot] = handle;
+}
+
+ORA_UINT32 CSSDPNeighborTable::IndexSlot( ORA_UINT32 handle ) const
+{
+    ORA_UINT32 mask = m_Index.size() - 1;
+    ORA_UINT32 slot = m_Slab[handle].Hash & mask;
+    while( m_Index[slot] != handle )
+    {
+        ORA_ASSERT( m_Index[slot] != SSDP_NBR_INVALID );
+        slot = ( slot + 1 ) & mask;
+    }
+    return slot;
+}
+
+ORA_VOID CSSDPNeighborTable::HeapUp( ORA_UINT32 pos )
+{
+    while( pos > 0 )
+    {
+        ORA_UINT32 parent = ( pos - 1 ) / 2;
+        if( m_Slab[ m_Heap[parent] ].Deadline <= m_Slab[ m_Heap[pos] ].Deadline )
+            break;
+        HeapSwap( pos, parent );
+        pos = parent;
+    }
+}
+
+ORA_VOID CSSDPNeighborTable::HeapDown( ORA_UINT32 pos )
+{
+    ORA_UINT32 size = m_Heap.size();
+    while( ORA_TRUE )
+    {
+        ORA_UINT32 least = pos;
+        ORA_UINT32 left  = pos * 2 + 1;
+        ORA_UINT32 right = pos * 2 + 2;
+        if( left < size && m_Slab[ m_Heap[left] ].Deadline < m_Slab[ m_Heap[least] ].Deadline )
+            least = left;
+        if( right < size && m_Slab[ m_Heap[right] ].Deadline < m_Slab[ m_Heap[least] ].Deadline )
+            least = right;
+        if( least == pos )
+            break;
+        HeapSwap( pos, least );
+        pos = least;
+    }
+}
+
+ORA_VOID CSSDPNeighborTable::HeapSwap( ORA_UINT32 a, ORA_UINT32 b )
+{
+    ORA_UINT32 tmp = m_Heap[a];
+    m_Heap[a] = m_Heap[b];
+    m_Heap[b] = tmp;
+    m_Slab[ m_Heap[a] ].HeapPos = a;
+    m_Slab[ m_Heap[b] ].HeapPos = b;
+}
+// END: CSSDPNeighborTable
+///////////////////////////////////////////////////////////////////////////////
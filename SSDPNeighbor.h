@@ -0,0 +1,183 @@
+#ifndef __SSDPNEIGHBOR_H__
+#define __SSDPNEIGHBOR_H__
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define SSDP_NEIGHBOR_CAPACITY     64          // initial slab capacity, grows by doubling
+#define SSDP_NBR_INVALID           0xFFFFFFFF  // invalid neighbor handle
+
+/* Struct : SSDP_NBR */
+typedef struct SSDP_NBR
+{
+    string      Usn;      // Unique Service Name (Device Name or MAC)
+    string      Location; // URL or IP(:Port), the key of the neighbor table
+
+    /* Additional SSDP Header Fields */
+    string      SmId;
+    string      DeviceType;
+    ORA_INT64   UpdateTime;
+    ORA_INT64   Deadline; // the neighbor times out at this time (ms)
+    ORA_UINT32  IfAddr;   // address of the interface which the neighbor is seen on
+    ORA_UINT32  Addr;     // address of the neighbor, 0 until it is heard, its M-SEARCH refreshes it too
+    ORA_BOOL    Stale;    // restored from the checkpoint, not re-confirmed yet
+
+    /* Neighbor Table Bookkeeping */
+    ORA_UINT32  Hash;     // hash of Location
+    ORA_UINT32  NextFree; // next free slab entry, valid when InUse is false
+    ORA_UINT32  HeapPos;  // position in the expiry heap
+    ORA_BOOL    InUse;
+}SSDP_NBR_T;
+
+/* Struct : SSDP_NBR_RECORD, a neighbor kept in the checkpoint across restarts */
+typedef struct SSDP_NBR_RECORD
+{
+    string      Usn;
+    string      Location;
+    string      SmId;
+    string      DeviceType;
+    ORA_UINT32  IfAddr;
+}SSDP_NBR_RECORD_T;
+
+/**
+ * @name CSSDPNeighborTable SSDP neighbors kept in a contiguous slab,
+ * indexed by an open-addressing hash table keyed by the hash of Location,
+ * and ordered by Deadline in an intrusive binary min-heap for expiry.
+ *
+ * @note neighbors are referred by handles, which stay valid until the neighbor is removed.
+ * the slab only grows when it is full, so after warm-up lookup, insert and remove
+ * don't allocate, and the strings of a recycled entry keep their capacity.
+ * @{ */
+class CSSDPNeighborTable
+{
+// Constructor & Destructor
+public:
+    /**
+     * @brief constructor
+     *
+     * @param capacity initial slab capacity
+     */
+    CSSDPNeighborTable( ORA_UINT32 capacity = SSDP_NEIGHBOR_CAPACITY );
+    ~CSSDPNeighborTable();
+
+// Operations
+public:
+    /**
+     * @brief find neighbor by location
+     *
+     * @param pLocation location, not NUL terminated
+     * @param len       location length
+     *
+     * @return neighbor handle, SSDP_NBR_INVALID if not found
+     */
+    ORA_UINT32 Find( const ORA_CHAR *pLocation, ORA_SIZE len ) const;
+
+    /**
+     * @brief insert a new neighbor, the location must not be in the table
+     *
+     * @param pLocation location, not NUL terminated
+     * @param len       location length
+     * @param deadline  the time (ms) when the neighbor times out
+     *
+     * @return handle of the new neighbor, whose Location is set and other fields are empty
+     */
+    ORA_UINT32 Insert( const ORA_CHAR *pLocation, ORA_SIZE len, ORA_INT64 deadline );
+
+    /**
+     * @brief move the deadline of a neighbor, O(log n)
+     *
+     * @param handle    neighbor handle
+     * @param deadline  the time (ms) when the neighbor times out
+     */
+    ORA_VOID SetDeadline( ORA_UINT32 handle, ORA_INT64 deadline );
+
+    /**
+     * @brief the neighbor which times out first
+     *
+     * @return neighbor handle, SSDP_NBR_INVALID if the table is empty
+     */
+    inline ORA_UINT32 Earliest() const
+    {
+        return m_Heap.empty() ? SSDP_NBR_INVALID : m_Heap[0];
+    }
+
+    /**
+     * @brief the earliest deadline of all neighbors
+     *
+     * @return deadline (ms), -1 if the table is empty
+     */
+    inline ORA_INT64 NextDeadline() const
+    {
+        return m_Heap.empty() ? -1 : m_Slab[ m_Heap[0] ].Deadline;
+    }
+
+    /**
+     * @brief remove a neighbor, its handle becomes invalid
+     *
+     * @param handle neighbor handle
+     */
+    ORA_VOID Remove( ORA_UINT32 handle );
+
+    /**
+     * @brief remove all neighbors, the memory is kept for reuse
+     */
+    ORA_VOID Clear();
+
+    /**
+     * @brief first neighbor handle for iterating, removing the current neighbor while iterating is allowed.
+     *
+     * @return neighbor handle, SSDP_NBR_INVALID if the table is empty
+     */
+    ORA_UINT32 First() const
+    {
+        return Next( SSDP_NBR_INVALID );
+    }
+
+    /**
+     * @brief next neighbor handle for iterating
+     *
+     * @param handle current neighbor handle
+     *
+     * @return neighbor handle, SSDP_NBR_INVALID if there is no more neighbor
+     */
+    ORA_UINT32 Next( ORA_UINT32 handle ) const;
+
+    inline SSDP_NBR_T& At( ORA_UINT32 handle )
+    {
+        ORA_ASSERT( handle < m_Slab.size() && m_Slab[handle].InUse );
+        return m_Slab[handle];
+    }
+
+    inline const SSDP_NBR_T& At( ORA_UINT32 handle ) const
+    {
+        ORA_ASSERT( handle < m_Slab.size() && m_Slab[handle].InUse );
+        return m_Slab[handle];
+    }
+
+    inline ORA_UINT32 Size() const
+    {
+        return m_Size;
+    }
+
+// Assistants
+private:
+    ORA_VOID Grow();
+    ORA_VOID IndexInsert( ORA_UINT32 handle );
+    ORA_UINT32 IndexSlot( ORA_UINT32 handle ) const;
+    ORA_VOID HeapUp( ORA_UINT32 pos );
+    ORA_VOID HeapDown( ORA_UINT32 pos );
+    ORA_VOID HeapSwap( ORA_UINT32 a, ORA_UINT32 b );
+
+// Properties
+private:
+    vector< SSDP_NBR_T > m_Slab;     ///< neighbor entries, a handle is the entry's position
+    vector< ORA_UINT32 > m_Index;    ///< open-addressing index of handles, linear probing, size is power of 2
+    vector< ORA_UINT32 > m_Heap;     ///< min-heap of handles ordered by Deadline
+    ORA_UINT32           m_FreeHead; ///< first free slab entry
+    ORA_UINT32           m_Size;     ///< neighbor amount
+};
+/**  @} */
+
+#endif//#ifndef __SSDPNEIGHBOR_H__
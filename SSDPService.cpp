@@ -6,47 +6,157 @@
  ************************************************************************/
 
 #include <stdio.h>      // snprintf, vsnprintf
-#include <stdlib.h>     // malloc, free
+#include <stdlib.h>     // malloc, free, atoi, rand_r
 #include <stdarg.h>     // va_start, va_end, va_list
 #include <string.h>     // memset, memcpy, strlen, strcpy, strcmp, strncasecmp, strerror
-#include <ctype.h>      // isprint, isspace
 #include <errno.h>      // errno
-#include <unistd.h>     // close
+#include <unistd.h>     // close, getpid
 #include <sys/time.h>   // gettimeofday
+#include <time.h>       // time
 #include <sys/ioctl.h>  // ioctl, FIONBIO
-#include <net/if.h>     // struct ifconf, struct ifreq
+#include <net/if.h>     // struct ifconf, struct ifreq, if_indextoname
 #include <fcntl.h>      // fcntl, F_GETFD, F_SETFD, FD_CLOEXEC
-#include <sys/socket.h> // struct sockaddr, AF_INET, SOL_SOCKET, socklen_t, setsockopt, socket, bind, sendto, recvfrom
+#include <sys/socket.h> // struct sockaddr, AF_INET, SOL_SOCKET, socklen_t, setsockopt, socket, bind, sendto, recvmsg, recvmmsg, CMSG_FIRSTHDR
+#include <sys/uio.h>    // struct iovec
+#include <sys/epoll.h>  // epoll_create1, epoll_ctl, epoll_wait
+#include <sys/timerfd.h>// timerfd_create, timerfd_settime
+#include <sys/eventfd.h>// eventfd
 #include <netinet/in.h> // struct sockaddr_in, struct ip_mreq, INADDR_ANY, IPPROTO_IP, also include <sys/socket.h>
 #include <arpa/inet.h>  // inet_aton, inet_ntop, inet_addr, also include <netinet/in.h>
-#include "SSDPService.h"
+#include <linux/netlink.h>   // struct sockaddr_nl, struct nlmsghdr, NETLINK_ROUTE
+#include <linux/rtnetlink.h> // struct ifinfomsg, struct ifaddrmsg, RTMGRP_LINK, RTMGRP_IPV4_IFADDR
 #include "SSDPUtils.h"
+#include "SSDPNeighbor.h"
+#include "SSDPService.h"
+
+/**
+ * @brief compare a field view with a string without copying the field
+ *
+ * @return ORA_TRUE if the field value equals to the string
+ */
+static inline ORA_BOOL FieldEquals( const ORA_CHAR *pData, CSSDPService::SSDP_FIELD_VIEW_T field, const string &value )
+{
+    return field.Length == value.size() && memcmp( pData + field.Offset, value.data(), field.Length ) == 0;
+}
+
+/**
+ * @brief copy a field view into a C string buffer, the value is truncated to fit
+ */
+static inline ORA_VOID FieldCopy( const ORA_CHAR *pData, CSSDPService::SSDP_FIELD_VIEW_T field, ORA_CHAR *pBuf, ORA_SIZE bufLen )
+{
+    ORA_SIZE len = field.Length < bufLen ? field.Length : bufLen - 1;
+    memcpy( pBuf, pData + field.Offset, len );
+    pBuf[len] = '\0';
+}
+
+/**
+ * @brief assign a field view to a string when it changed, the value is truncated to maxLen - 1
+ *
+ * @return ORA_TRUE if the string has been changed
+ */
+static inline ORA_BOOL FieldAssign( const ORA_CHAR *pData, CSSDPService::SSDP_FIELD_VIEW_T field, ORA_SIZE maxLen, string &value )
+{
+    ORA_SIZE len = field.Length < maxLen ? field.Length : maxLen - 1;
+    if( len == value.size() && memcmp( pData + field.Offset, value.data(), len ) == 0 )
+        return ORA_FALSE;
+
+    value.assign( pData + field.Offset, len );  // reuse the string's capacity
+    return ORA_TRUE;
+}
+
+/**
+ * @brief compare two interface sets field by field
+ *
+ * @return ORA_TRUE if they are the same
+ */
+static inline ORA_BOOL InterfacesEqual( const vector< CSSDPService::SSDP_IF_T > &a, const vector< CSSDPService::SSDP_IF_T > &b )
+{
+    if( a.size() != b.size() )
+        return ORA_FALSE;
+
+    for( ORA_SIZE i = 0; i < a.size(); i++ )
+    {
+        if( a[i].Name != b[i].Name || a[i].Ip != b[i].Ip || a[i].Addr != b[i].Addr || a[i].Netmask != b[i].Netmask )
+            return ORA_FALSE;
+    }
+    return ORA_TRUE;
+}
+
+/**
+ * @brief value of a hex digit
+ *
+ * @return 0 - 15, -1 if c is not a hex digit
+ */
+static inline ORA_INT32 HexValue( ORA_CHAR c )
+{
+    if( c >= '0' && c <= '9' )
+        return c - '0';
+    if( c >= 'a' && c <= 'f' )
+        return c - 'a' + 10;
+    if( c >= 'A' && c <= 'F' )
+        return c - 'A' + 10;
+    return -1;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 // BEG: CSSDPService
 /**
  * @brief Constructor for SSDP service
  *
- * @param pNetworkService the Network handler
+ * @param context the interfaces, header fields and callbacks, the service keeps its own copy
  */
-CSSDPService::CSSDPService( SSDP_CONTEXT_T *pSSDPContext )
-    : m_pSSDPContext( pSSDPContext )
+CSSDPService::CSSDPService( const SSDP_CONTEXT_T &context )
+    : m_SSDPContext( context )
 {
     m_pSSDPUtils = CSSDPUtils::GetInstance();
     ORA_ASSERT( m_pSSDPUtils );
 
     m_Port = SSDP_PORT;
+    m_EpollFd = -1;
+    m_TimerFd = -1;
+    m_EventFd = -1;
+    m_NetlinkFd = -1;
+    m_bQuit = ORA_FALSE;
+    m_bInterfacePending = ORA_FALSE;
+    m_hHeartBeatThread = ORA_NULL;
+    m_bRecvBatch = ORA_TRUE;
+    memset( &m_RecvStats, 0, sizeof(m_RecvStats) );
+    m_ResponseCount = 0;
+    m_bKnownAnswer = ORA_TRUE;
+    m_StableInterval = SSDP_MSEARCH_INTERVAL;
+    m_NeighborTimeout = SSDP_NEIGHBOR_TIMEOUT_PROBES * SSDP_MSEARCH_INTERVAL;
+    m_ProbeInterval = SSDP_PROBE_INTERVAL_MIN;
+    m_NextProbeTime = 0;
+    m_bRoleResolved = ORA_TRUE;
+    m_bChurn = ORA_FALSE;
+    m_RandSeed = static_cast< ORA_UINT32 >( time(ORA_NULL) ) ^ static_cast< ORA_UINT32 >( getpid() );
+    memset( &m_ResponseStats, 0, sizeof(m_ResponseStats) );
 
     ORAInitializeCriticalSection( &m_SocketLock );
-    SocketCreate();
+
+    // open a socket pair on every interface of the context
+    BuildFilter();
+    for( ORA_SIZE i = 0; i < m_SSDPContext.Interfaces.size(); i++ )
+    {
+        m_ConfiguredNames.push_back( m_SSDPContext.Interfaces[i].Name );
+    }
+    m_PendingInterfaces = m_SSDPContext.Interfaces;
+    m_bInterfacePending = ORA_TRUE;
+    ApplyInterfaceUpdate();
 }
 
 CSSDPService::~CSSDPService()
 {
+    LinkCloseAll();
     ORADeleteCriticalSection( &m_SocketLock );
 }
 
-ORA_BOOL CSSDPService::Join()
+/**
+ * @brief join the SSDP network: set up the reactor and start the heartbeat thread
+ *
+ * @return ORA_TRUE if joined successfully, otherwise ORA_FALSE
+ */
+ORA_BOOL CSSDPService::SSDPJoin()
 {
     ORA_ASSERT( this );
     m_LastTime = GetCurrentTime();
@@ -55,8 +165,16 @@ ORA_BOOL CSSDPService::Join()
         printf("got invalid timestamp %lld\n", m_LastTime);
         return ORA_FALSE;
     }
-    //CORASectionLock lock( m_ThreadLock );
+
+    // start probing fast, it backs off as the neighbor set settles
+    m_ProbeInterval = SSDP_PROBE_INTERVAL_MIN;
+    ScheduleNextProbe( m_LastTime );
+
+    if( ReactorCreate() != 0 )
+        return ORA_FALSE;
+
     ORA_ASSERT( m_hHeartBeatThread == ORA_NULL );
+    m_bQuit = ORA_FALSE;
     m_hHeartBeatThread = ORACreateThread( HeartBeatThread,
                                     reinterpret_cast< ORA_VOID* >( this ),
                                     ORA_TRUE,
@@ -64,745 +182,2018 @@ ORA_BOOL CSSDPService::Join()
                                     ORATP_NORMAL,
                                     DEFAULT_THREAD_STACK_SIZE );
     if( !m_hHeartBeatThread )
+    {
+        ReactorClose();
         return ORA_FALSE;
+    }
 
     return ORA_TRUE;
 }
 
-ORA_VOID CSSDPService::OffLine()
+/**
+ * @brief leave the SSDP network: wake up the reactor to quit, and wait the heartbeat thread
+ */
+ORA_VOID CSSDPService::SSDPOffLine()
 {
-    //CORASectionLock lock( m_ThreadLock );
-
-    ORA_MSG msg;
-    msg.MessageID = OMID_QUIT;
     ORA_ASSERT( m_hHeartBeatThread );
-    ORASendMessage( m_hHeartBeatThread, &msg );
+    m_bQuit = ORA_TRUE;
+    ReactorWakeup();
     ORAWaitThreadDead( m_hHeartBeatThread );
     m_hHeartBeatThread = ORA_NULL;
+    ReactorClose();
 }
 
-ORA_VOID CSSDPService::HeartBeatThread( ORA_VOID *param )
+/**
+ * @brief heartbeat thread: a reactor which sleeps in epoll until the SSDP socket is readable,
+ * the timerfd fires for the M-SEARCH / neighbor timeout schedule, or the eventfd is signaled
+ * for shutdown / reconfiguration.
+ */
+ORA_INT_PTR CSSDPService::HeartBeatThread( ORA_VOID *param )
 {
-    ORA_MSG msg;
+    CSSDPService *pThis = reinterpret_cast< CSSDPService* >( param );
+    ORA_ASSERT( pThis );
 
-    while( ORA_TRUE )
-    {
-        ORAGetMessage( &msg );
-        if( msg.MessageID == OMID_QUIT )
-        {
-            ORA_INFO_TRACE("HeartBeatThread thread exiting");
-            break;
-        }
-        ORAClearMessage( &msg );
-
-        printf("start to reading new packet...\n");
-        CORASectionLock lock( m_SocketLock );
-        fd_set fs;
-        FD_ZERO( &fs );
-        FD_SET( m_Socket, &fs );
-        struct timeval tv = {
-            .tv_usec = 500 * 1000   // 500 ms
-        };
-
-        ORA_INT32 ret = select( m_Socket + 1, &fs, ORA_NULL, ORA_NULL, &tv );
-        if( ret < 0 )
-        {
-            printf("select error, ret = %d\n", ret);
-            break;
-        }
+    pThis->ReactorArmTimer();
 
-        if( ret > 0 )
+    struct epoll_event events[SSDP_EPOLL_EVENTS];
+    while( !pThis->m_bQuit )
+    {
+        ORA_INT32 count = epoll_wait( pThis->m_EpollFd, events, SSDP_EPOLL_EVENTS, -1 );
+        if( count < 0 )
         {
-            ReadSocket();
-        }
+            if( errno == EINTR )
+                continue;
 
-        lock.Unlock();
-        // get current time
-        ORA_INT64 currentTime = GetCurrentTime();
-        if( currentTime < 0 )
-        {
-            printf("got invalid timestamp %lld\n", currentTime);
+            printf("epoll_wait failed, errno = %s (%d)\n", strerror(errno), errno);
             break;
         }
 
-        // doing task per 5 seconds
-        if( CurrentTime - m_LastTime >= 5000 )
+        for( ORA_INT32 i = 0; i < count; i++ )
         {
-            SendMsearch();                 // 1. send M-SEARCH
-            NeighborCheckTimeout();        // 2. check neighbor timeout
-
-            m_LastTime = CurrentTime;      // update last_time
+            ORA_INT32 fd = events[i].data.fd;
+            if( fd == pThis->m_EventFd )
+            {
+                // shutdown or reconfiguration
+                ORA_UINT64 value;
+                if( read(pThis->m_EventFd, &value, sizeof(value)) < 0 && errno != EAGAIN )
+                {
+                    printf("read eventfd failed, errno = %s (%d)\n", strerror(errno), errno);
+                }
+                pThis->ApplyInterfaceUpdate();
+            }
+            else if( fd == pThis->m_TimerFd )
+            {
+                ORA_UINT64 expirations;
+                if( read(pThis->m_TimerFd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN )
+                {
+                    printf("read timerfd failed, errno = %s (%d)\n", strerror(errno), errno);
+                }
+                pThis->RunScheduledTasks();
+            }
+            else if( fd == pThis->m_NetlinkFd )
+            {
+                // link or address of an interface changed
+                pThis->ReadNetlink();
+            }
+            else
+            {
+                // the socket lock is only held while reading, and only one interface is read per event,
+                // so a storm on one link can't hold back the others
+                CORASectionLock lock( pThis->m_SocketLock );
+                SSDP_LINK_T *pLink = pThis->FindLinkBySocket( fd );
+                if( pLink != ORA_NULL )
+                    pThis->ReadSocket( *pLink );
+                lock.Unlock();
+            }
         }
+
+        pThis->ReactorArmTimer();
     }
+
+    ORA_INFO_TRACE("HeartBeatThread thread exiting");
+    return 0;
 }
 
-// 01. lssdp_network_interface_update
-ORA_INT32 CSSDPService::SSDPNetworkInterfaceUpdate( SSDP_IF_T Interface )
+/**
+ * @brief run the periodic tasks which are due: M-SEARCH responses, M-SEARCH and neighbor timeout
+ */
+ORA_VOID CSSDPService::RunScheduledTasks()
 {
-    ORA_ASSERT( m_pSSDPContext );
+    ORA_INT64 currentTime = GetCurrentTime();
+    if( currentTime < 0 )
+    {
+        printf("got invalid timestamp %lld\n", currentTime);
+        return;
+    }
 
-    const ORA_UINT32 sizeOfInterface = sizeof( SSDP_IF_T );
+    // send the responses whose random delay has passed
+    FlushResponses( currentTime );
 
-    ORA_INT32 result = 0;
+    // send M-SEARCH on the adaptive cadence, the schedule is also moved by the API threads
+    CORASectionLock probeLock( m_SocketLock );
+    ORA_BOOL isProbeDue = currentTime >= m_NextProbeTime;
+    probeLock.Unlock();
 
-    // compare with original interface
-    if ( memcmp(&Interface, &( m_pSSDPContext->Interface ), sizeOfInterface) == 0 )
+    if( isProbeDue )
     {
-        // interface is not changed
-        return result;
+        SSDPSendMsearch();
+        ScheduleNextProbe( currentTime );
     }
 
-    /* Network Interface is changed */
+    // only the neighbors which really timed out are touched, the table is shared with the checkpoint
     CORASectionLock lock( m_SocketLock );
-    memset( &( m_pSSDPContext->Interface ), 0, sizeOfInterface );
-    memcpy( &( m_pSSDPContext->Interface ), &Interface, sizeOfInterface );
-    result = SocketCreate();
+    ORA_INT64 deadline = m_NeighborTimeout > 0 ? m_NeighborTable.NextDeadline() : -1;
+    if( deadline >= 0 && deadline <= currentTime )
+    {
+        NeighborCheckTimeout();
+    }
     lock.Unlock();
-
-    return result;
 }
 
-// 02. lssdp_socket_create
-ORA_INT32 CSSDPService::SocketCreate()
+/**
+ * @brief an M-SEARCH is sent at currentTime: pick the next interval and time, fast right after the neighbor set changed,
+ * kept under SSDP_PROBE_UNRESOLVED_MAX while the role is unresolved, otherwise doubled per quiet
+ * M-SEARCH up to the stable interval. each interval is spread by SSDP_PROBE_JITTER so that
+ * the neighbors don't probe in step.
+ *
+ * @param currentTime current time (ms)
+ */
+ORA_VOID CSSDPService::ScheduleNextProbe( ORA_INT64 currentTime )
 {
-    ORA_ASSERT( m_pSSDPContext );
+    CORASectionLock lock( m_SocketLock );
+    m_LastTime = currentTime;
 
-    if( m_Port <= 0 )
-    {
-        printf("SSDP port (%d) has not been setup.\n", m_Port);
-        return -1;
-    }
+    ORA_UINT32 maxInterval = m_bRoleResolved ? m_StableInterval : SSDP_PROBE_UNRESOLVED_MAX;
+    if( maxInterval > m_StableInterval )
+        maxInterval = m_StableInterval;
 
-    // close original SSDP socket
-    SocketClose();
+    if( m_bChurn )
+        m_ProbeInterval = SSDP_PROBE_INTERVAL_MIN;
+    else if( m_ProbeInterval < maxInterval / 2 )
+        m_ProbeInterval *= 2;
+    else
+        m_ProbeInterval = maxInterval;
+    m_bChurn = ORA_FALSE;
 
-    // create UDP socket
-    m_Socket = socket( AF_INET, SOCK_DGRAM, 0 );
-    if( m_Socket < 0 )
-    {
-        printf("create socket failed, errno = %s (%d)\n", strerror(errno), errno);
-        return -1;
-    }
+    // jitter in [-SSDP_PROBE_JITTER%, +SSDP_PROBE_JITTER%]
+    ORA_INT64 spread = m_ProbeInterval * SSDP_PROBE_JITTER / 100;
+    ORA_INT64 jitter = spread > 0 ? (ORA_INT64)( rand_r(&m_RandSeed) % ( 2 * spread + 1 ) ) - spread : 0;
+    m_NextProbeTime = currentTime + m_ProbeInterval + jitter;
+}
 
-    ORA_INT32 result = -1;
+/**
+ * @brief a neighbor is found or lost: go back to the fast cadence
+ *
+ * @param currentTime current time (ms)
+ */
+ORA_VOID CSSDPService::OnNeighborChurn( ORA_INT64 currentTime )
+{
+    m_bChurn = ORA_TRUE;
+    m_ProbeInterval = SSDP_PROBE_INTERVAL_MIN;
+    if( m_NextProbeTime > currentTime + SSDP_PROBE_INTERVAL_MIN )
+        m_NextProbeTime = currentTime + SSDP_PROBE_INTERVAL_MIN;
+}
 
-    // set non-blocking
-    ORA_INT32 opt = 1;
-    if( ioctl(m_Socket, FIONBIO, &opt) != 0 )
-    {
-        printf("ioctl FIONBIO failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
-    }
+ORA_VOID CSSDPService::SSDPSetStableInterval( ORA_UINT32 interval )
+{
+    CORASectionLock lock( m_SocketLock );
+    m_StableInterval  = interval > SSDP_PROBE_INTERVAL_MIN ? interval : SSDP_MSEARCH_INTERVAL;
+    m_NeighborTimeout = (ORA_UINT64)SSDP_NEIGHBOR_TIMEOUT_PROBES * m_StableInterval;
+    lock.Unlock();
 
-    // set reuse address
-    if( setsockopt(m_Socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) != 0 )
-    {
-        printf("setsockopt SO_REUSEADDR failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
-    }
+    // re-arm the timer
+    ReactorWakeup();
+}
 
-    // set FD_CLOEXEC
-    ORA_INT32 sockOpt = fcntl( m_Socket, F_GETFD );
-    if(sockOpt == -1)
+ORA_VOID CSSDPService::SSDPGetNeighbors( vector< SSDP_NBR_RECORD_T > &records ) const
+{
+    CORASectionLock lock( m_SocketLock );
+    records.clear();
+    records.reserve( m_NeighborTable.Size() );
+    for( ORA_UINT32 handle = m_NeighborTable.First(); handle != SSDP_NBR_INVALID; handle = m_NeighborTable.Next( handle ) )
     {
-        printf("fcntl F_GETFD failed, errno = %s (%d)\n", strerror(errno), errno);
+        const SSDP_NBR_T &nbr = m_NeighborTable.At( handle );
+        if( nbr.Stale )
+            continue;
+
+        SSDP_NBR_RECORD_T record;
+        record.Usn        = nbr.Usn;
+        record.Location   = nbr.Location;
+        record.SmId       = nbr.SmId;
+        record.DeviceType = nbr.DeviceType;
+        record.IfAddr     = nbr.IfAddr;
+        records.push_back( record );
     }
-    else
+}
+
+ORA_UINT32 CSSDPService::SSDPRestoreNeighbors( const vector< SSDP_NBR_RECORD_T > &records )
+{
+    CORASectionLock lock( m_SocketLock );
+    ORA_INT64  currentTime = GetCurrentTime();
+    ORA_UINT32 count = 0;
+    for( ORA_SIZE i = 0; i < records.size(); i++ )
     {
-        // F_SETFD
-        if( fcntl(m_Socket, F_SETFD, sockOpt | FD_CLOEXEC) == -1 )
-        {
-            printf("fcntl F_SETFD FD_CLOEXEC failed, errno = %s (%d)\n", strerror(errno), errno);
-        }
+        const SSDP_NBR_RECORD_T &record = records[i];
+
+        // 1. skip the neighbors of a network not in use any more, and the ones known already
+        if( record.Location.empty() || record.Location.size() >= SSDP_LOCATION_LEN )
+            continue;
+
+        const SSDP_LINK_T *pLink = FindInterfaceInLAN( record.IfAddr );
+        if( pLink == ORA_NULL )
+            continue;
+
+        if( m_NeighborTable.Find( record.Location.data(), record.Location.size() ) != SSDP_NBR_INVALID )
+            continue;
+
+        // 2. stale until it answers, it is not reported found yet
+        ORA_UINT32 handle = m_NeighborTable.Insert( record.Location.data(), record.Location.size(), currentTime + m_NeighborTimeout );
+        SSDP_NBR_T &nbr = m_NeighborTable.At( handle );
+        nbr.Usn        = record.Usn;
+        nbr.SmId       = record.SmId;
+        nbr.DeviceType = record.DeviceType;
+        nbr.UpdateTime = currentTime;
+        nbr.IfAddr     = pLink->Interface.Addr;
+        nbr.Stale      = ORA_TRUE;
+        count++;
     }
 
-    // bind socket
-    struct sockaddr_in addr = {
-        .sin_family      = AF_INET,
-        .sin_port        = htons( m_Port ),
-        .sin_addr.s_addr = inet_addr( m_pSSDPContext->Interface.Ip.c_str() )
-    };
-    if( bind(m_Socket, (struct sockaddr *)&addr, sizeof(addr)) != 0 )
+    if( count == 0 )
     {
-        printf("bind failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
+        return 0;
     }
 
-    // set IP_ADD_MEMBERSHIP
-    struct ip_mreq imr = {
-        .imr_multiaddr.s_addr = inet_addr( Global.ADDR_MULTICAST ),
-        .imr_interface.s_addr = inet_addr( m_pSSDPContext->Interface.Ip.c_str() )
-    };
-    if( setsockopt(m_Socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &imr, sizeof(struct ip_mreq)) != 0 )
+    // 3. probe right away, so the neighbors confirm within one round trip
+    printf("%u SSDP neighbors restored from the checkpoint.\n", count);
+    OnNeighborChurn( currentTime );
+    m_NextProbeTime = currentTime;
+    lock.Unlock();
+
+    // re-arm the timer
+    ReactorWakeup();
+    return count;
+}
+
+ORA_VOID CSSDPService::SSDPSetRoleResolved( ORA_BOOL bResolved )
+{
+    CORASectionLock lock( m_SocketLock );
+    if( m_bRoleResolved == bResolved )
     {
-        printf("setsockopt IP_ADD_MEMBERSHIP failed: %s (%d)\n", strerror(errno), errno);
-        goto end;
+        return;
     }
+    m_bRoleResolved = bResolved;
 
-    printf("create SSDP socket %d\n", m_Socket);
-    result = 0;
-end:
-    if( result == -1 )
+    // an unresolved role probes fast again
+    if( !bResolved && m_ProbeInterval > SSDP_PROBE_UNRESOLVED_MAX )
     {
-        SocketClose();
+        m_ProbeInterval = SSDP_PROBE_UNRESOLVED_MAX;
+        if( m_NextProbeTime > m_LastTime + SSDP_PROBE_UNRESOLVED_MAX )
+            m_NextProbeTime = m_LastTime + SSDP_PROBE_UNRESOLVED_MAX;
     }
-    return result;
+    lock.Unlock();
+
+    // re-arm the timer
+    ReactorWakeup();
 }
 
-// 03. lssdp_socket_close
-ORA_INT32 CSSDPService::SocketClose()
+/**
+ * @brief create epoll, timerfd and eventfd, and watch them with the SSDP socket
+ *
+ * @return 0 if created successfully, otherwise -1
+ */
+ORA_INT32 CSSDPService::ReactorCreate()
 {
-    ORA_ASSERT( m_pSSDPContext );
-
-    // check socket
-    if( m_Socket <= 0 )
+    m_EpollFd = epoll_create1( EPOLL_CLOEXEC );
+    m_TimerFd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+    m_EventFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    if( m_EpollFd < 0 || m_TimerFd < 0 || m_EventFd < 0 )
     {
-        printf("SSDP socket is %d, ignore socket_close request.\n", m_Socket);
-        goto end;
+        printf("create reactor failed, errno = %s (%d)\n", strerror(errno), errno);
+        ReactorClose();
+        return -1;
     }
 
-    // close socket
-    if( close(m_Socket) != 0 )
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+
+    event.data.fd = m_TimerFd;
+    epoll_ctl( m_EpollFd, EPOLL_CTL_ADD, m_TimerFd, &event );
+
+    event.data.fd = m_EventFd;
+    epoll_ctl( m_EpollFd, EPOLL_CTL_ADD, m_EventFd, &event );
+
+    // interface tracking is optional, SSDPNetworkInterfaceUpdate still works without it
+    if( NetlinkCreate() == 0 )
     {
-        printf("close socket %d failed, errno = %s (%d)\n", m_Socket, strerror(errno), errno);
-        return -1;
-    };
+        event.data.fd = m_NetlinkFd;
+        epoll_ctl( m_EpollFd, EPOLL_CTL_ADD, m_NetlinkFd, &event );
+    }
 
-    // close socket success
-    printf("close SSDP socket %d\n", m_Socket);
-end:
-    m_Socket = -1;
-    NeighborRemoveAll();  // force clean up neighbor_list
+    CORASectionLock lock( m_SocketLock );
+    for( ORA_SIZE i = 0; i < m_Links.size(); i++ )
+    {
+        ReactorWatchSocket( m_Links[i].Socket );
+    }
     return 0;
 }
 
-// 04. lssdp_socket_read
-ORA_INT32 CSSDPService::ReadSocket()
+ORA_VOID CSSDPService::ReactorClose()
 {
-    ORA_ASSERT( m_pSSDPContext );
+    if( m_EpollFd >= 0 )
+        close( m_EpollFd );
+    if( m_TimerFd >= 0 )
+        close( m_TimerFd );
+    if( m_EventFd >= 0 )
+        close( m_EventFd );
+    NetlinkClose();
+
+    m_EpollFd = -1;
+    m_TimerFd = -1;
+    m_EventFd = -1;
+}
 
-    // check socket and port
-    if( m_Socket <= 0 )
-    {
-        printf("SSDP socket (%d) has not been setup.\n", m_Socket);
-        return -1;
-    }
+/**
+ * @brief watch a new SSDP receive socket, the closed ones have been dropped from epoll by the kernel
+ */
+ORA_VOID CSSDPService::ReactorWatchSocket( ORA_INT32 fd )
+{
+    if( m_EpollFd < 0 || fd < 0 )
+        return;
 
-    if( m_Port == 0 )
+    struct epoll_event event = {};
+    event.events  = EPOLLIN;
+    event.data.fd = fd;
+    if( epoll_ctl(m_EpollFd, EPOLL_CTL_ADD, fd, &event) != 0 && errno != EEXIST )
     {
-        printf("SSDP port (%d) has not been setup.\n", m_Port);
-        return -1;
+        printf("epoll_ctl add fd %d failed, errno = %s (%d)\n", fd, strerror(errno), errno);
     }
+}
 
-    ORA_CHAR buffer[SSDP_BUFFER_LEN] = {};
-    struct sockaddr_in address = {};
-    socklen_t address_len = sizeof(struct sockaddr_in);
+/**
+ * @brief arm the timerfd to the next M-SEARCH, neighbor deadline or pending response, whichever comes first
+ */
+ORA_VOID CSSDPService::ReactorArmTimer()
+{
+    // the schedule, the neighbor table and the response queue are shared with the API threads
+    CORASectionLock lock( m_SocketLock );
+    ORA_INT64 wakeTime = m_NextProbeTime;
+    ORA_INT64 deadline = m_NeighborTimeout > 0 ? m_NeighborTable.NextDeadline() : -1;
+    if( deadline >= 0 && deadline < wakeTime )
+        wakeTime = deadline;
+
+    ORA_INT64 responseTime = NextResponseTime();
+    if( responseTime >= 0 && responseTime < wakeTime )
+        wakeTime = responseTime;
+    lock.Unlock();
 
-    ORA_INT recv_len = recvfrom(m_Socket, buffer, sizeof(buffer), 0, (struct sockaddr *)&address, &address_len);
-    if( recv_len == -1 )
+    ORA_INT64 sleepTime = wakeTime - GetCurrentTime();
+    if( sleepTime <= 0 )
+        sleepTime = 1;  // a zero it_value disarms the timer
+
+    struct itimerspec spec = {};
+    spec.it_value.tv_sec  = sleepTime / 1000;
+    spec.it_value.tv_nsec = ( sleepTime % 1000 ) * 1000000;
+    if( timerfd_settime(m_TimerFd, 0, &spec, ORA_NULL) != 0 )
     {
-        printf("recvfrom fd %d failed, errno = %s (%d)\n", m_Socket, strerror(errno), errno);
-        return -1;
+        printf("timerfd_settime failed, errno = %s (%d)\n", strerror(errno), errno);
     }
+}
 
-    // parse SSDP packet to struct
-    SSDP_PACKET_T packet = {};
-    if( PacketParser(buffer, recv_len, &packet) != 0 )
+/**
+ * @brief wake up the reactor for shutdown or reconfiguration
+ */
+ORA_VOID CSSDPService::ReactorWakeup()
+{
+    ORA_UINT64 value = 1;
+    if( m_EventFd >= 0 && write(m_EventFd, &value, sizeof(value)) < 0 )
     {
-        return 0;
+        printf("write eventfd failed, errno = %s (%d)\n", strerror(errno), errno);
     }
+}
 
-    // check search target
-    if(strcmp(packet.st, lssdp->header.search_target) != 0)
+// 01. lssdp_network_interface_update
+ORA_INT32 CSSDPService::SSDPNetworkInterfaceUpdate( const vector< SSDP_IF_T > &interfaces )
+{
+    // compare with original interfaces
+    CORASectionLock lock( m_SocketLock );
+    const vector< SSDP_IF_T > &current = m_bInterfacePending ? m_PendingInterfaces : m_SSDPContext.Interfaces;
+    ORA_BOOL isChanged = !InterfacesEqual( interfaces, current );
+
+    // the interfaces are tracked by name from now on
+    m_ConfiguredNames.clear();
+    for( ORA_SIZE i = 0; i < interfaces.size(); i++ )
     {
-        // search target is not match
-        printf("RECV <- %-8s   not match with %-14s %s\n", packet.method, lssdp->header.search_target, packet.location);
-        goto end;
+        m_ConfiguredNames.push_back( interfaces[i].Name );
     }
 
-    // M-SEARCH: send RESPONSE back
-    if(strcmp(packet.method, Global.MSEARCH) == 0) {
-        lssdp_send_response(address);
+    if( !isChanged )
+    {
+        // interfaces are not changed
         return 0;
     }
 
-    // RESPONSE, NOTIFY: add to neighbor_list
-    NeighborListAdd();
-
-    // RESPONSE: return
-    if (strcmp(packet.method, Global.NOTIFY) == 0)
-        return 0;
+    /* Network Interfaces are changed: hand them over to the reactor */
+    m_PendingInterfaces = interfaces;
+    m_bInterfacePending = ORA_TRUE;
+    lock.Unlock();
 
-    if (lssdp->debug) {
-        lssdp_info("RECV <- %-8s   %-28s  %s\n", packet.method, packet.location, packet.sm_id);
-    }
-    // invoke packet received callback
-    if (lssdp->packet_received_callback != NULL) {
-        lssdp->packet_received_callback(lssdp, buffer, recv_len);
+    if( m_hHeartBeatThread == ORA_NULL )
+    {
+        // the reactor is not running, apply it directly
+        return ApplyInterfaceUpdate();
     }
 
+    ReactorWakeup();
     return 0;
 }
 
-// 05. lssdp_send_msearch
-ORA_INT32 CSSDPService::SSDPSendMsearch()
+/**
+ * @brief apply the pending interfaces, called in the reactor thread. only the interfaces which are
+ * new or changed get a new socket pair; the others keep their sockets and neighbors.
+ *
+ * @return 0 if applied successfully or nothing is pending, otherwise -1
+ */
+ORA_INT32 CSSDPService::ApplyInterfaceUpdate()
 {
-    ORA_ASSERT( m_pSSDPContext );
+    CORASectionLock lock( m_SocketLock );
+    return ApplyInterfaceUpdateLocked();
+}
 
-    if ( m_Port == 0 )
+/**
+ * @brief apply the pending interfaces, called with m_SocketLock held
+ *
+ * @return 0 if applied successfully or nothing is pending, otherwise -1
+ */
+ORA_INT32 CSSDPService::ApplyInterfaceUpdateLocked()
+{
+    if( !m_bInterfacePending )
     {
-        printf("SSDP port (%d) has not been setup.\n", m_Port);
-        return -1;
+        return 0;
     }
+    m_bInterfacePending = ORA_FALSE;
 
-    // 1. set M-SEARCH packet
-    string msearch = m_pSSDPUtils->BuildSSDPSearchString();
-    char msearch[LSSDP_BUFFER_LEN] = {};
-    snprintf(msearch, sizeof(msearch),
-        "%s"
-        "HOST:%s:%d\r\n"
-        "MAN:\"ssdp:discover\"\r\n"
-        "MX:1\r\n"
-        "ST:%s\r\n"
-        "USER-AGENT:OS/version product/version\r\n"
-        "\r\n",
-        Global.HEADER_MSEARCH,              // HEADER
-        Global.ADDR_MULTICAST, lssdp->port, // HOST
-        lssdp->header.search_target         // ST (Search Target)
-    );
+    ORA_INT32 result = 0;
+    ORA_INT64 currentTime = GetCurrentTime();
+    vector< SSDP_LINK_T > links;
+    vector< ORA_BOOL >    kept( m_Links.size(), ORA_FALSE );
+    links.reserve( m_PendingInterfaces.size() );
+    for( ORA_SIZE i = 0; i < m_PendingInterfaces.size(); i++ )
+    {
+        const SSDP_IF_T &ifc = m_PendingInterfaces[i];
+
+        // 1. the interface is unchanged: keep its link
+        ORA_SIZE j = 0;
+        for( ; j < m_Links.size(); j++ )
+        {
+            const SSDP_IF_T &old = m_Links[j].Interface;
+            if( !kept[j] && old.Name == ifc.Name && old.Ip == ifc.Ip && old.Addr == ifc.Addr && old.Netmask == ifc.Netmask )
+                break;
+        }
+
+        if( j < m_Links.size() )
+        {
+            kept[j] = ORA_TRUE;
+            links.push_back( m_Links[j] );
+            continue;
+        }
+
+        // 2. new or changed interface: open a socket pair, a failed interface doesn't stop the others
+        links.resize( links.size() + 1 );
+        SSDP_LINK_T &link = links.back();
+        link.Interface  = ifc;
+        link.Socket     = -1;
+        link.SendSocket = -1;
+        link.bKernelFilter = ORA_FALSE;
+        link.KernelDrops   = 0;
+
+        if( SocketCreate(link) != 0 || SenderCreate(link) != 0 )
+        {
+            LinkClose( link );
+            links.pop_back();
+            result = -1;
+            continue;
+        }
+        ReactorWatchSocket( link.Socket );
+
+        // probe the new link right away
+        OnNeighborChurn( currentTime );
+        m_NextProbeTime = currentTime;
+    }
+
+    // 3. close the links which are gone or changed, and forget the neighbors seen on them
+    for( ORA_SIZE j = 0; j < m_Links.size(); j++ )
+    {
+        if( kept[j] )
+            continue;
+
+        NeighborRemoveLink( m_Links[j].Interface.Addr );
+        LinkClose( m_Links[j] );
+    }
+    m_Links.swap( links );
+
+    // the interfaces in use, a failed one is tried again by the next update or refresh
+    m_SSDPContext.Interfaces.clear();
+    for( ORA_SIZE i = 0; i < m_Links.size(); i++ )
+    {
+        m_SSDPContext.Interfaces.push_back( m_Links[i].Interface );
+    }
+
+    // LOCATION host follows the interfaces
+    if( BuildMessages() != 0 )
+    {
+        result = -1;
+    }
+
+    return result;
+}
+
+/**
+ * @brief close the socket pair of an interface
+ */
+ORA_VOID CSSDPService::LinkClose( SSDP_LINK_T &link )
+{
+    SocketClose( link );
+    SenderClose( link );
+}
+
+/**
+ * @brief close the socket pairs of all interfaces
+ */
+ORA_VOID CSSDPService::LinkCloseAll()
+{
+    for( ORA_SIZE i = 0; i < m_Links.size(); i++ )
+    {
+        LinkClose( m_Links[i] );
+    }
+    m_Links.clear();
+}
+
+/**
+ * @brief open the rtnetlink socket for link and IPv4 address events
+ *
+ * @return 0 if opened successfully, otherwise -1
+ */
+ORA_INT32 CSSDPService::NetlinkCreate()
+{
+    m_NetlinkFd = socket( AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE );
+    if( m_NetlinkFd < 0 )
+    {
+        printf("create netlink socket failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+
+    struct sockaddr_nl addr = {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR;
+    if( bind(m_NetlinkFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 )
+    {
+        printf("bind netlink socket failed, errno = %s (%d)\n", strerror(errno), errno);
+        NetlinkClose();
+        return -1;
+    }
+
+    return 0;
+}
+
+ORA_VOID CSSDPService::NetlinkClose()
+{
+    if( m_NetlinkFd >= 0 )
+        close( m_NetlinkFd );
+    m_NetlinkFd = -1;
+}
+
+/**
+ * @brief drain the rtnetlink socket, and refresh the interfaces if a configured one is touched
+ */
+ORA_VOID CSSDPService::ReadNetlink()
+{
+    ORA_CHAR buffer[SSDP_NETLINK_BUFFER_LEN];
+    ORA_BOOL isChanged = ORA_FALSE;
+
+    while( ORA_TRUE )
+    {
+        ORA_INT len = recv( m_NetlinkFd, buffer, sizeof(buffer), MSG_DONTWAIT );
+        if( len < 0 )
+        {
+            if( errno == ENOBUFS )
+            {
+                // events were lost: refresh every interface
+                isChanged = ORA_TRUE;
+                continue;
+            }
+
+            if( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR )
+                printf("recv netlink failed, errno = %s (%d)\n", strerror(errno), errno);
+            break;
+        }
+
+        if( len == 0 )
+            break;
+
+        for( struct nlmsghdr *pMsg = (struct nlmsghdr *)buffer; NLMSG_OK(pMsg, len); pMsg = NLMSG_NEXT(pMsg, len) )
+        {
+            ORA_INT32 index;
+            if( pMsg->nlmsg_type == RTM_NEWLINK || pMsg->nlmsg_type == RTM_DELLINK )
+            {
+                index = ((struct ifinfomsg *)NLMSG_DATA(pMsg))->ifi_index;
+            }
+            else if( pMsg->nlmsg_type == RTM_NEWADDR || pMsg->nlmsg_type == RTM_DELADDR )
+            {
+                struct ifaddrmsg *pAddr = (struct ifaddrmsg *)NLMSG_DATA(pMsg);
+                if( pAddr->ifa_family != AF_INET )
+                    continue;
+                index = pAddr->ifa_index;
+            }
+            else
+            {
+                continue;
+            }
+
+            // a removed interface has no name any more, then refresh them all
+            ORA_CHAR name[IF_NAMESIZE];
+            if( if_indextoname(index, name) == ORA_NULL )
+            {
+                isChanged = ORA_TRUE;
+                continue;
+            }
+
+            for( ORA_SIZE i = 0; i < m_ConfiguredNames.size(); i++ )
+            {
+                if( m_ConfiguredNames[i] == name )
+                    isChanged = ORA_TRUE;
+            }
+        }
+    }
+
+    if( isChanged )
+    {
+        RefreshInterfaces();
+    }
+}
+
+/**
+ * @brief query the configured interfaces, and apply the ones which are up and have an IPv4 address
+ */
+ORA_VOID CSSDPService::RefreshInterfaces()
+{
+    CORASectionLock lock( m_SocketLock );
+
+    vector< SSDP_IF_T > interfaces;
+    for( ORA_SIZE i = 0; i < m_ConfiguredNames.size(); i++ )
+    {
+        SSDP_IF_T ifc;
+        if( QueryInterface(m_ConfiguredNames[i], ifc) )
+            interfaces.push_back( ifc );
+    }
+
+    if( InterfacesEqual(interfaces, m_SSDPContext.Interfaces) )
+    {
+        return;
+    }
+
+    printf("SSDP interfaces changed, %zu of %zu are up\n", interfaces.size(), m_ConfiguredNames.size());
+    m_PendingInterfaces = interfaces;
+    m_bInterfacePending = ORA_TRUE;
+    ApplyInterfaceUpdateLocked();
+}
+
+/**
+ * @brief get the state of an interface
+ *
+ * @param name  interface name
+ * @param ifc   receives the interface
+ *
+ * @return ORA_TRUE if the interface is up, running and has an IPv4 address
+ */
+ORA_BOOL CSSDPService::QueryInterface( const string &name, SSDP_IF_T &ifc )
+{
+    if( name.empty() || name.size() >= IF_NAMESIZE )
+    {
+        return ORA_FALSE;
+    }
+
+    ORA_INT32 fd = socket( AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0 );
+    if( fd < 0 )
+    {
+        printf("create socket failed, errno = %s (%d)\n", strerror(errno), errno);
+        return ORA_FALSE;
+    }
+
+    ORA_BOOL result = ORA_FALSE;
+    struct ifreq req = {};
+    strncpy( req.ifr_name, name.c_str(), IF_NAMESIZE - 1 );
+    if( ioctl(fd, SIOCGIFFLAGS, &req) == 0 && (req.ifr_flags & IFF_UP) && (req.ifr_flags & IFF_RUNNING) )
+    {
+        if( ioctl(fd, SIOCGIFADDR, &req) == 0 )
+        {
+            ifc.Name = name;
+            ifc.Addr = ((struct sockaddr_in *)&req.ifr_addr)->sin_addr.s_addr;
+
+            ORA_CHAR ip[SSDP_IP_LEN] = {};
+            inet_ntop( AF_INET, &ifc.Addr, ip, sizeof(ip) );
+            ifc.Ip = ip;
+
+            if( ioctl(fd, SIOCGIFNETMASK, &req) == 0 )
+            {
+                ifc.Netmask = ((struct sockaddr_in *)&req.ifr_netmask)->sin_addr.s_addr;
+                result = ORA_TRUE;
+            }
+        }
+    }
+
+    close( fd );
+    return result;
+}
+
+/**
+ * @brief find the interface whose receive socket is fd
+ *
+ * @return the link, ORA_NULL if not found
+ */
+CSSDPService::SSDP_LINK_T* CSSDPService::FindLinkBySocket( ORA_INT32 fd )
+{
+    for( ORA_SIZE i = 0; i < m_Links.size(); i++ )
+    {
+        if( m_Links[i].Socket == fd )
+            return &m_Links[i];
+    }
+    return ORA_NULL;
+}
+
+/**
+ * @brief find the interface which is under the same Local Network Area with the address
+ *
+ * @param address IPv4 address in network byte order
+ *
+ * @return the link, ORA_NULL if not found
+ */
+CSSDPService::SSDP_LINK_T* CSSDPService::FindInterfaceInLAN( ORA_UINT32 address )
+{
+    for( ORA_SIZE i = 0; i < m_Links.size(); i++ )
+    {
+        const SSDP_IF_T &ifc = m_Links[i].Interface;
+
+        // mask address to check whether the interface is under the same Local Network Area or not
+        if( (ifc.Addr & ifc.Netmask) == (address & ifc.Netmask) )
+            return &m_Links[i];
+    }
+    return ORA_NULL;
+}
+
+// 02. lssdp_socket_create
+ORA_INT32 CSSDPService::SocketCreate( SSDP_LINK_T &link )
+{
+    if( m_Port <= 0 )
+    {
+        printf("SSDP port (%d) has not been setup.\n", m_Port);
+        return -1;
+    }
+
+    // close original SSDP socket
+    SocketClose( link );
+
+    // create UDP socket
+    link.Socket = socket( AF_INET, SOCK_DGRAM, 0 );
+    if( link.Socket < 0 )
+    {
+        printf("create socket failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+
+    ORA_INT32 result = -1;
+
+    // set non-blocking
+    ORA_INT32 opt = 1;
+    if( ioctl(link.Socket, FIONBIO, &opt) != 0 )
+    {
+        printf("ioctl FIONBIO failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // set reuse address
+    if( setsockopt(link.Socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) != 0 )
+    {
+        printf("setsockopt SO_REUSEADDR failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // set FD_CLOEXEC
+    ORA_INT32 sockOpt = fcntl( link.Socket, F_GETFD );
+    if(sockOpt == -1)
+    {
+        printf("fcntl F_GETFD failed, errno = %s (%d)\n", strerror(errno), errno);
+    }
+    else
+    {
+        // F_SETFD
+        if( fcntl(link.Socket, F_SETFD, sockOpt | FD_CLOEXEC) == -1 )
+        {
+            printf("fcntl F_SETFD FD_CLOEXEC failed, errno = %s (%d)\n", strerror(errno), errno);
+        }
+    }
+
+    // only receive the groups joined by this socket, so each interface has its own traffic
+    opt = 0;
+    if( setsockopt(link.Socket, IPPROTO_IP, IP_MULTICAST_ALL, &opt, sizeof(opt)) != 0 )
+    {
+        printf("setsockopt IP_MULTICAST_ALL failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // bind socket, the multicast datagrams are addressed to the group, not to the interface address
+    struct sockaddr_in addr = {
+        .sin_family      = AF_INET,
+        .sin_port        = htons( m_Port ),
+        .sin_addr.s_addr = htonl( INADDR_ANY )
+    };
+    if( bind(link.Socket, (struct sockaddr *)&addr, sizeof(addr)) != 0 )
+    {
+        printf("bind failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // set IP_ADD_MEMBERSHIP
+    struct ip_mreq imr = {
+        .imr_multiaddr.s_addr = inet_addr( Global.ADDR_MULTICAST ),
+        .imr_interface.s_addr = link.Interface.Addr
+    };
+    if( setsockopt(link.Socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &imr, sizeof(struct ip_mreq)) != 0 )
+    {
+        printf("setsockopt IP_ADD_MEMBERSHIP failed: %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    // report the socket's drop counter, which includes the datagrams dropped by the filter
+    opt = 1;
+    if( setsockopt(link.Socket, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt)) != 0 )
+    {
+        printf("setsockopt SO_RXQ_OVFL failed, errno = %s (%d)\n", strerror(errno), errno);
+    }
+    link.KernelDrops = 0;
+
+    // drop foreign SSDP traffic in the kernel
+    AttachFilter( link );
+
+    printf("create SSDP socket %d on %s (%s)\n", link.Socket, link.Interface.Name.c_str(), link.Interface.Ip.c_str());
+    result = 0;
+end:
+    if( result == -1 )
+    {
+        SocketClose( link );
+    }
+    return result;
+}
+
+// 03. lssdp_socket_close
+ORA_INT32 CSSDPService::SocketClose( SSDP_LINK_T &link )
+{
+    // check socket
+    if( link.Socket <= 0 )
+    {
+        printf("SSDP socket is %d, ignore socket_close request.\n", link.Socket);
+        goto end;
+    }
+
+    // close socket
+    if( close(link.Socket) != 0 )
+    {
+        printf("close socket %d failed, errno = %s (%d)\n", link.Socket, strerror(errno), errno);
+        return -1;
+    };
+
+    // close socket success
+    printf("close SSDP socket %d\n", link.Socket);
+end:
+    link.Socket = -1;
+    return 0;
+}
+
+/**
+ * @brief build the token filter of the search target, its needle is the ST/NT value followed by CRLF
+ */
+ORA_VOID CSSDPService::BuildFilter()
+{
+    m_FilterNeedle = m_SSDPContext.Header.SearchTarget + "\r\n";
+    if( !CSSDPUtils::BuildTokenFilter(m_FilterNeedle.data(), m_FilterNeedle.size(), m_FilterProgram) )
+    {
+        printf("search target %s is too long for the socket filter, filter it in userspace\n",
+               m_SSDPContext.Header.SearchTarget.c_str());
+    }
+}
+
+/**
+ * @brief attach the token filter to the receive socket of an interface.
+ * if it can't be attached, the same filter runs in userspace on the datagrams read.
+ */
+ORA_VOID CSSDPService::AttachFilter( SSDP_LINK_T &link )
+{
+    link.bKernelFilter = ORA_FALSE;
+    if( link.Socket < 0 || m_FilterProgram.empty() )
+    {
+        return;
+    }
+
+    struct sock_fprog program = {};
+    program.len    = static_cast< ORA_UINT16 >( m_FilterProgram.size() );
+    program.filter = &m_FilterProgram[0];
+    if( setsockopt(link.Socket, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) != 0 )
+    {
+        printf("setsockopt SO_ATTACH_FILTER failed, errno = %s (%d)\n", strerror(errno), errno);
+        return;
+    }
+
+    link.bKernelFilter = ORA_TRUE;
+}
+
+// 04. lssdp_socket_read
+ORA_INT32 CSSDPService::ReadSocket( SSDP_LINK_T &link )
+{
+    // check socket and port
+    if( link.Socket <= 0 )
+    {
+        printf("SSDP socket (%d) has not been setup.\n", link.Socket);
+        return -1;
+    }
+
+    if( m_Port == 0 )
+    {
+        printf("SSDP port (%d) has not been setup.\n", m_Port);
+        return -1;
+    }
+
+    if( m_bRecvBatch )
+    {
+        return ReadSocketBatch( link );
+    }
+
+    ORA_CHAR buffer[SSDP_BUFFER_LEN];
+    ORA_CHAR control[CMSG_SPACE(sizeof(ORA_UINT32))];   // SO_RXQ_OVFL
+    struct sockaddr_in address = {};
+    struct iovec iov = { buffer, sizeof(buffer) };
+    struct msghdr msg = {};
+    msg.msg_name       = &address;
+    msg.msg_namelen    = sizeof(struct sockaddr_in);
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof(control);
+
+    ORA_INT recv_len = recvmsg(link.Socket, &msg, 0);
+    if( recv_len == -1 )
+    {
+        printf("recvmsg fd %d failed, errno = %s (%d)\n", link.Socket, strerror(errno), errno);
+        return -1;
+    }
+
+    m_RecvStats.Syscalls++;
+    m_RecvStats.Datagrams++;
+    m_RecvStats.LastBatch = 1;
+    CountKernelDrops( link, msg );
+
+    // drop foreign search targets, where the socket filter is missing
+    if( !link.bKernelFilter && !CSSDPUtils::MatchTokenFilter(buffer, recv_len, m_FilterNeedle.data(), m_FilterNeedle.size()) )
+    {
+        m_RecvStats.FilterDropped++;
+        return 0;
+    }
+
+    // parse SSDP packet to views over the buffer, nothing is copied here
+    SSDP_PACKET_VIEW_T packet;
+    if( PacketParser(buffer, recv_len, &packet) != 0 )
+    {
+        return 0;
+    }
+
+    return HandlePacket( link, buffer, recv_len, packet, address );
+}
+
+/**
+ * @brief drain the socket with recvmmsg, up to SSDP_RECV_BATCH datagrams per syscall,
+ * into the preallocated receive buffers. each batch is parsed in one go, then applied.
+ * at most SSDP_RECV_BATCHES_PER_WAKE batches are read, the rest is left to the next epoll round
+ * after the other interfaces have been served.
+ *
+ * @return 0 if the socket is drained or the budget is used up, otherwise -1
+ */
+ORA_INT32 CSSDPService::ReadSocketBatch( SSDP_LINK_T &link )
+{
+    SSDP_PACKET_VIEW_T packets[SSDP_RECV_BATCH];
+    ORA_BOOL           parsed[SSDP_RECV_BATCH];
+
+    for( ORA_UINT32 batch = 0; batch < SSDP_RECV_BATCHES_PER_WAKE; batch++ )
+    {
+        // 1. reset the message headers, recvmmsg overwrites the lengths
+        for( ORA_UINT32 i = 0; i < SSDP_RECV_BATCH; i++ )
+        {
+            m_RecvIov[i].iov_base              = m_RecvBuffers[i];
+            m_RecvIov[i].iov_len               = SSDP_BUFFER_LEN;
+            m_RecvMsgs[i].msg_hdr.msg_name     = &m_RecvAddrs[i];
+            m_RecvMsgs[i].msg_hdr.msg_namelen  = sizeof(struct sockaddr_in);
+            m_RecvMsgs[i].msg_hdr.msg_iov      = &m_RecvIov[i];
+            m_RecvMsgs[i].msg_hdr.msg_iovlen   = 1;
+            m_RecvMsgs[i].msg_hdr.msg_control  = m_RecvCtrl[i];
+            m_RecvMsgs[i].msg_hdr.msg_controllen = sizeof(m_RecvCtrl[i]);
+            m_RecvMsgs[i].msg_hdr.msg_flags    = 0;
+            m_RecvMsgs[i].msg_len              = 0;
+        }
+
+        // 2. receive a batch without blocking
+        ORA_INT32 count = recvmmsg( link.Socket, m_RecvMsgs, SSDP_RECV_BATCH, MSG_DONTWAIT, ORA_NULL );
+        if( count < 0 )
+        {
+            if( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR )
+                return 0;
+
+            printf("recvmmsg fd %d failed, errno = %s (%d)\n", link.Socket, strerror(errno), errno);
+            return -1;
+        }
+
+        if( count == 0 )
+            return 0;
+
+        m_RecvStats.Syscalls++;
+        m_RecvStats.Datagrams     += count;
+        m_RecvStats.SyscallsSaved += count - 1;
+        m_RecvStats.LastBatch      = count;
+        if( (ORA_UINT32)count > m_RecvStats.MaxBatch )
+            m_RecvStats.MaxBatch = count;
+
+        // 3. the socket's drop counter comes with the last datagram
+        CountKernelDrops( link, m_RecvMsgs[count - 1].msg_hdr );
+
+        // 4. filter and parse the whole batch
+        for( ORA_INT32 i = 0; i < count; i++ )
+        {
+            // drop foreign search targets, where the socket filter is missing
+            if( !link.bKernelFilter && !CSSDPUtils::MatchTokenFilter(m_RecvBuffers[i], m_RecvMsgs[i].msg_len,
+                                                                     m_FilterNeedle.data(), m_FilterNeedle.size()) )
+            {
+                m_RecvStats.FilterDropped++;
+                parsed[i] = ORA_FALSE;
+                continue;
+            }
+            parsed[i] = PacketParser( m_RecvBuffers[i], m_RecvMsgs[i].msg_len, &packets[i] ) == 0;
+        }
+
+        // 5. apply the batch
+        for( ORA_INT32 i = 0; i < count; i++ )
+        {
+            if( parsed[i] )
+                HandlePacket( link, m_RecvBuffers[i], m_RecvMsgs[i].msg_len, packets[i], m_RecvAddrs[i] );
+        }
+
+        // the socket is drained
+        if( count < SSDP_RECV_BATCH )
+            return 0;
+    }
+
+    // the socket is still readable, epoll reports it again
+    return 0;
+}
+
+/**
+ * @brief add the datagrams the socket dropped since the last read to KernelDropped,
+ * the counter comes as SO_RXQ_OVFL control data and only grows.
+ *
+ * @param link  interface which the datagram is received on
+ * @param msg   the received message with its control data
+ */
+ORA_VOID CSSDPService::CountKernelDrops( SSDP_LINK_T &link, struct msghdr &msg )
+{
+    for( struct cmsghdr *pCmsg = CMSG_FIRSTHDR(&msg); pCmsg != ORA_NULL; pCmsg = CMSG_NXTHDR(&msg, pCmsg) )
+    {
+        if( pCmsg->cmsg_level == SOL_SOCKET && pCmsg->cmsg_type == SO_RXQ_OVFL )
+        {
+            ORA_UINT32 drops;
+            memcpy( &drops, CMSG_DATA(pCmsg), sizeof(drops) );
+            m_RecvStats.KernelDropped += drops - link.KernelDrops;
+            link.KernelDrops = drops;
+        }
+    }
+}
+
+/**
+ * @brief handle a parsed SSDP packet: answer M-SEARCH, update neighbor for RESPONSE and NOTIFY.
+ *
+ * @param link     interface which the packet is received on
+ * @param pData    packet data
+ * @param dataLen  packet length
+ * @param packet   packet views over pData
+ * @param address  sender's address
+ */
+ORA_INT32 CSSDPService::HandlePacket( const SSDP_LINK_T &link, const ORA_CHAR *pData, ORA_INT dataLen, const SSDP_PACKET_VIEW_T &packet, const struct sockaddr_in &address )
+{
+    // check search target
+    if( !FieldEquals(pData, packet.St, m_SSDPContext.Header.SearchTarget) )
+    {
+        // search target is not match
+        m_RecvStats.TargetDropped++;
+        return 0;
+    }
+
+    // M-SEARCH: the requester is alive, it's refreshed as the neighbors it knows don't answer it.
+    // queue RESPONSE, it's sent by the reactor's timer within the requester's MX window
+    if( packet.Method == SM_MSEARCH )
+    {
+        if( NeighborRefresh( address.sin_addr.s_addr, packet.UpdateTime ) > 0 )
+            m_ResponseStats.Refreshed++;
+        ScheduleResponse( pData, packet, address );
+        return 0;
+    }
+
+    // RESPONSE, NOTIFY: add to neighbor list
+    NeighborListAdd( link, pData, packet, address );
+
+    // NOTIFY: return
+    if( packet.Method == SM_NOTIFY )
+        return 0;
+
+    // invoke packet received callback
+    if( m_SSDPContext.PacketReceivedCallback != ORA_NULL )
+    {
+        ORA_CHAR smId[SSDP_FIELD_LEN];
+        FieldCopy( pData, packet.SmId, smId, sizeof(smId) );
+        DEVICE_ID_T sender = static_cast< DEVICE_ID_T >( strtoul(smId, ORA_NULL, 10) );
+        m_SSDPContext.PacketReceivedCallback( sender, pData, dataLen );
+    }
+
+    return 0;
+}
+
+// 05. lssdp_send_msearch
+ORA_INT32 CSSDPService::SSDPSendMsearch()
+{
+    if( m_Port == 0 )
+    {
+        printf("SSDP port (%d) has not been setup.\n", m_Port);
+        return -1;
+    }
+
+    CORASectionLock lock( m_SocketLock );
+
+    // close the prebuilt M-SEARCH, after the known-answer digest of the fresh neighbors if it's enabled
+    ORA_SIZE length = m_MsearchMsg.ExtOffset;
+    if( m_bKnownAnswer )
+    {
+        length += BuildKnownAnswer( m_MsearchMsg.Data + length, sizeof(m_MsearchMsg.Data) - length - 2, GetCurrentTime() );
+    }
+    memcpy( m_MsearchMsg.Data + length, "\r\n", 2 );
+    length += 2;
 
-    // 2. send M-SEARCH to each interface
-    size_t i;
-    for (i = 0; i < lssdp->interface_num; i++) {
-        struct lssdp_interface * interface = &lssdp->interface[i];
+    // send it on every interface, a failed one doesn't stop the others
+    ORA_INT32 result = 0;
+    for( ORA_SIZE i = 0; i < m_Links.size(); i++ )
+    {
+        // avoid sending multicast to localhost
+        if( m_Links[i].Interface.Addr == inet_addr(Global.ADDR_LOCALHOST) )
+            continue;
+
+        if( SendMulticast(m_Links[i], m_MsearchMsg.Data, length) != 0 )
+            result = -1;
+    }
+
+    return result;
+}
+
+// 06. lssdp_send_notify
+ORA_INT32 CSSDPService::SSDPSendNotify()
+{
+    if( m_Port == 0 )
+    {
+        printf("SSDP port (%d) has not been setup.\n", m_Port);
+        return -1;
+    }
+
+    // check network inerface
+    CORASectionLock lock( m_SocketLock );
+    if( m_Links.empty() )
+    {
+        printf("Network Interface is empty, no destination to send %s\n", Global.NOTIFY);
+        return -1;
+    }
 
+    // send the prebuilt NOTIFY of each interface, its LOCATION host has been set for the interface
+    ORA_INT32 result = 0;
+    for( ORA_SIZE i = 0; i < m_Links.size(); i++ )
+    {
         // avoid sending multicast to localhost
-        if (interface->addr == inet_addr(Global.ADDR_LOCALHOST)) {
+        if( m_Links[i].Interface.Addr == inet_addr(Global.ADDR_LOCALHOST) )
             continue;
+
+        if( SendMulticast(m_Links[i], m_Links[i].NotifyMsg.Data, m_Links[i].NotifyMsg.Length) != 0 )
+            result = -1;
+    }
+
+    return result;
+}
+
+/**
+ * @brief update the announced header fields, and rebuild the messages
+ *
+ * @param header SSDP header fields
+ *
+ * @return 0 if rebuilt successfully, otherwise -1
+ */
+ORA_INT32 CSSDPService::SSDPUpdateHeader( const SSDP_HEADER_T &header )
+{
+    CORASectionLock lock( m_SocketLock );
+    m_SSDPContext.Header = header;
+
+    // the search target may change: rebuild the token filter
+    BuildFilter();
+    for( ORA_SIZE i = 0; i < m_Links.size(); i++ )
+    {
+        AttachFilter( m_Links[i] );
+    }
+
+    return BuildMessages();
+}
+
+/**
+ * @brief serialize M-SEARCH, and NOTIFY and RESPONSE of every interface, for the current header.
+ * it is called once per interface or header change; on sending only DATE is patched in place.
+ *
+ * @return 0 if built successfully, otherwise -1
+ */
+ORA_INT32 CSSDPService::BuildMessages()
+{
+    const SSDP_HEADER_T &header = m_SSDPContext.Header;
+    ORA_INT32 len;
+
+    // 1. M-SEARCH
+    len = snprintf(m_MsearchMsg.Data, sizeof(m_MsearchMsg.Data),
+        "%s"
+        "HOST:%s:%d\r\n"
+        "MAN:\"ssdp:discover\"\r\n"
+        "MX:1\r\n"
+        "ST:%s\r\n"
+        "USER-AGENT:OS/version product/version\r\n"
+        "\r\n",
+        Global.HEADER_MSEARCH,                              // HEADER
+        Global.ADDR_MULTICAST, m_Port,                      // HOST
+        header.SearchTarget.c_str()                         // ST (Search Target)
+    );
+    if( len < 0 || len >= (ORA_INT32)sizeof(m_MsearchMsg.Data) )
+    {
+        printf("build %s failed, len = %d\n", Global.MSEARCH, len);
+        return -1;
+    }
+    m_MsearchMsg.Length     = len;
+    m_MsearchMsg.DateOffset = -1;
+    m_MsearchMsg.ExtOffset  = len - 2;  // X-KNOWN goes before the closing empty line
+
+    // 2. NOTIFY and RESPONSE of each interface
+    ORA_INT32 result = 0;
+    for( ORA_SIZE i = 0; i < m_Links.size(); i++ )
+    {
+        if( BuildLinkMessages(m_Links[i]) != 0 )
+            result = -1;
+    }
+    m_DateTime = 0;     // force to patch DATE on the next send
+
+    return result;
+}
+
+/**
+ * @brief serialize NOTIFY and RESPONSE of an interface, LOCATION host is the interface IP
+ * unless a domain is set.
+ *
+ * @return 0 if built successfully, otherwise -1
+ */
+ORA_INT32 CSSDPService::BuildLinkMessages( SSDP_LINK_T &link )
+{
+    const SSDP_HEADER_T &header = m_SSDPContext.Header;
+    const ORA_CHAR *pHost = header.LocationDomain.empty() ? link.Interface.Ip.c_str() : header.LocationDomain.c_str();
+    SSDP_MSG_T &notify   = link.NotifyMsg;
+    SSDP_MSG_T &response = link.ResponseMsg;
+    ORA_INT32 len;
+
+    // 1. NOTIFY
+    len = snprintf(notify.Data, sizeof(notify.Data),
+        "%s"
+        "HOST:%s:%d\r\n"
+        "CACHE-CONTROL:max-age=120\r\n"
+        "LOCATION:%s%s%s\r\n"
+        "SERVER:OS/version product/version\r\n"
+        "NT:%s\r\n"
+        "NTS:ssdp:alive\r\n"
+        "USN:%s\r\n"
+        "SM_ID:%s\r\n"
+        "DEV_TYPE:%s\r\n"
+        "\r\n",
+        Global.HEADER_NOTIFY,                               // HEADER
+        Global.ADDR_MULTICAST, m_Port,                      // HOST
+        header.LocationPrefix.c_str(), pHost, header.LocationSuffix.c_str(), // LOCATION
+        header.SearchTarget.c_str(),                        // NT (Notify Type)
+        header.Usn.c_str(),                                 // USN
+        header.SmId.c_str(),                                // SM_ID    (addtional field)
+        header.DeviceType.c_str()                           // DEV_TYPE (addtional field)
+    );
+    if( len < 0 || len >= (ORA_INT32)sizeof(notify.Data) )
+    {
+        printf("build %s on %s failed, len = %d\n", Global.NOTIFY, link.Interface.Name.c_str(), len);
+        return -1;
+    }
+    notify.Length     = len;
+    notify.DateOffset = -1;
+    notify.ExtOffset  = -1;
+
+    // 2. RESPONSE, the DATE value is reserved with fixed width and patched on sending
+    len = snprintf(response.Data, sizeof(response.Data),
+        "%s"
+        "CACHE-CONTROL:max-age=120\r\n"
+        "DATE:",
+        Global.HEADER_RESPONSE                              // HEADER
+    );
+    response.DateOffset = len;
+    len += snprintf(response.Data + len, sizeof(response.Data) - len,
+        "%*s\r\n"
+        "EXT:\r\n"
+        "LOCATION:%s%s%s\r\n"
+        "SERVER:OS/version product/version\r\n"
+        "ST:%s\r\n"
+        "USN:%s\r\n"
+        "SM_ID:%s\r\n"
+        "DEV_TYPE:%s\r\n"
+        "\r\n",
+        SSDP_DATE_LEN, "",                                  // DATE
+        header.LocationPrefix.c_str(), pHost, header.LocationSuffix.c_str(), // LOCATION
+        header.SearchTarget.c_str(),                        // ST (Search Target)
+        header.Usn.c_str(),                                 // USN
+        header.SmId.c_str(),                                // SM_ID    (addtional field)
+        header.DeviceType.c_str()                           // DEV_TYPE (addtional field)
+    );
+    if( len < 0 || len >= (ORA_INT32)sizeof(response.Data) )
+    {
+        printf("build %s on %s failed, len = %d\n", Global.RESPONSE, link.Interface.Name.c_str(), len);
+        return -1;
+    }
+    response.Length    = len;
+    response.ExtOffset = -1;
+
+    return 0;
+}
+
+/**
+ * @brief patch the DATE value of a prebuilt message, it's formatted once per second for all interfaces.
+ *
+ * @param msg prebuilt message
+ */
+ORA_VOID CSSDPService::PatchDate( SSDP_MSG_T &msg )
+{
+    if( msg.DateOffset < 0 )
+    {
+        return;
+    }
+
+    time_t now = time( ORA_NULL );
+    if( now != m_DateTime )
+    {
+        CSSDPUtils::FormatHttpDate( now, m_DateValue );
+        m_DateTime = now;
+    }
+    memcpy( msg.Data + msg.DateOffset, m_DateValue, SSDP_DATE_LEN );
+}
+
+// 07. lssdp_neighbor_check_timeout, called with m_SocketLock held
+ORA_INT32 CSSDPService::NeighborCheckTimeout()
+{
+    // check neighbor_timeout
+    if (m_NeighborTimeout <= 0)
+    {
+        printf("neighbor_timeout (%ld) is invalid, ignore check_timeout request.\n", m_NeighborTimeout);
+        return 0;
+    }
+
+    ORA_INT64 currentTime = GetCurrentTime();
+    if (currentTime < 0)
+    {
+        printf("got invalid timestamp %lld\n", currentTime);
+        return -1;
+    }
+
+    // pop the expired neighbors from the expiry heap, the others are not touched
+    ORA_UINT32 handle;
+    while( (handle = m_NeighborTable.Earliest()) != SSDP_NBR_INVALID )
+    {
+        const SSDP_NBR_T &nbr = m_NeighborTable.At( handle );
+        if( nbr.Deadline > currentTime )
+        {
+            break;
+        }
+
+        ORA_INT64 passTime = currentTime - nbr.UpdateTime;
+        printf("remove timeout SSDP neighbor: %s (%s) (%lldms)\n", nbr.SmId.c_str(), nbr.Location.c_str(), passTime);
+        // invoke neighbor lost callback, a restored neighbor which never answered was not reported found
+        if( m_SSDPContext.NeighborLostCallback != ORA_NULL && !nbr.Stale )
+        {
+            m_SSDPContext.NeighborLostCallback( NW_DEVICE() );
+        }
+
+        m_NeighborTable.Remove( handle );
+        OnNeighborChurn( currentTime );
+    }
+
+    return 0;
+}
+
+
+/** Internal Function **/
+
+/**
+ * @brief create the multicast sender socket of the interface: bound to the interface address,
+ * with IP_MULTICAST_IF, IP_MULTICAST_TTL and IP_MULTICAST_LOOP set once.
+ * it is kept until the interface changes.
+ *
+ * @return 0 if created successfully, otherwise -1
+ */
+ORA_INT32 CSSDPService::SenderCreate( SSDP_LINK_T &link )
+{
+    // close original sender socket
+    SenderClose( link );
+
+    if( link.Interface.Name.empty() )
+    {
+        printf("interface name should not be empty\n");
+        return -1;
+    }
+
+    ORA_INT32 result = -1;
+
+    // 1. create UDP socket
+    link.SendSocket = socket( AF_INET, SOCK_DGRAM, 0 );
+    if( link.SendSocket < 0 )
+    {
+        printf("create socket failed, errno = %s (%d)\n", strerror(errno), errno);
+        return -1;
+    }
+
+    // 2. set non-blocking and FD_CLOEXEC, a busy link never blocks the SSDP thread
+    ORA_INT32 opt = 1;
+    if( ioctl(link.SendSocket, FIONBIO, &opt) != 0 )
+    {
+        printf("ioctl FIONBIO failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    if( fcntl(link.SendSocket, F_SETFD, FD_CLOEXEC) == -1 )
+    {
+        printf("fcntl F_SETFD FD_CLOEXEC failed, errno = %s (%d)\n", strerror(errno), errno);
+    }
+
+    // 3. bind socket
+    {
+        struct sockaddr_in addr = {};
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = link.Interface.Addr;
+        if( bind(link.SendSocket, (struct sockaddr *)&addr, sizeof(addr)) < 0 )
+        {
+            printf("bind failed, errno = %s (%d)\n", strerror(errno), errno);
+            goto end;
+        }
+    }
+
+    // 4. disable IP_MULTICAST_LOOP
+    {
+        ORA_UINT8 loop = 0;
+        if( setsockopt(link.SendSocket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0 )
+        {
+            printf("setsockopt IP_MULTICAST_LOOP failed, errno = %s (%d)\n", strerror(errno), errno);
+            goto end;
+        }
+    }
+
+    // 5. set IP_MULTICAST_IF
+    {
+        struct in_addr ifAddr = {};
+        ifAddr.s_addr = link.Interface.Addr;
+        if( setsockopt(link.SendSocket, IPPROTO_IP, IP_MULTICAST_IF, &ifAddr, sizeof(ifAddr)) < 0 )
+        {
+            printf("setsockopt IP_MULTICAST_IF failed, errno = %s (%d)\n", strerror(errno), errno);
+            goto end;
+        }
+    }
+
+    // 6. set IP_MULTICAST_TTL
+    {
+        ORA_UINT8 ttl = SSDP_MULTICAST_TTL;
+        if( setsockopt(link.SendSocket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0 )
+        {
+            printf("setsockopt IP_MULTICAST_TTL failed, errno = %s (%d)\n", strerror(errno), errno);
+            goto end;
         }
+    }
+
+    // 7. set destination address
+    memset( &m_MulticastAddr, 0, sizeof(m_MulticastAddr) );
+    m_MulticastAddr.sin_family = AF_INET;
+    m_MulticastAddr.sin_port   = htons( m_Port );
+    if( inet_aton(Global.ADDR_MULTICAST, &m_MulticastAddr.sin_addr) == 0 )
+    {
+        printf("inet_aton failed, errno = %s (%d)\n", strerror(errno), errno);
+        goto end;
+    }
+
+    printf("create SSDP sender socket %d on %s (%s)\n", link.SendSocket,
+           link.Interface.Name.c_str(), link.Interface.Ip.c_str());
+    result = 0;
+end:
+    if( result == -1 )
+    {
+        SenderClose( link );
+    }
+    return result;
+}
+
+/**
+ * @brief close the multicast sender socket of the interface
+ */
+ORA_VOID CSSDPService::SenderClose( SSDP_LINK_T &link )
+{
+    if( link.SendSocket < 0 )
+    {
+        return;
+    }
+
+    if( close(link.SendSocket) != 0 )
+    {
+        printf("close sender socket %d failed, errno = %s (%d)\n", link.SendSocket, strerror(errno), errno);
+    }
+    link.SendSocket = -1;
+}
+
+/**
+ * @brief send data to the SSDP multicast group via the sender socket of the interface
+ *
+ * @param link     interface to send on
+ * @param pData    data to send
+ * @param dataLen  data length
+ *
+ * @return 0 if sent successfully, otherwise -1
+ */
+ORA_INT32 CSSDPService::SendMulticast( const SSDP_LINK_T &link, const ORA_CHAR *pData, ORA_SIZE dataLen )
+{
+    if( pData == ORA_NULL || dataLen == 0 )
+    {
+        printf("data should not be empty\n");
+        return -1;
+    }
+
+    if( link.SendSocket < 0 )
+    {
+        printf("SSDP sender socket has not been setup.\n");
+        return -1;
+    }
 
-        // send M-SEARCH
-        int ret = send_multicast_data(msearch, *interface, lssdp->port);
-        if (ret == 0 && lssdp->debug) {
-            lssdp_info("SEND => %-8s   %s => MULTICAST\n", Global.MSEARCH, interface->ip);
-        }
+    if( sendto(link.SendSocket, pData, dataLen, 0, (struct sockaddr *)&m_MulticastAddr, sizeof(m_MulticastAddr)) == -1 )
+    {
+        printf("sendto %s (%s) failed, errno = %s (%d)\n", link.Interface.Name.c_str(),
+               link.Interface.Ip.c_str(), strerror(errno), errno);
+        return -1;
     }
 
     return 0;
 }
 
-// 06. lssdp_send_notify
-ORA_INT32 CSSDPService::SSDPSendNotify()
+/**
+ * @brief send the prebuilt RESPONSE back to the M-SEARCH requester
+ *
+ * @param address requester's address
+ *
+ * @return 0 if sent successfully, otherwise -1
+ */
+ORA_INT32 CSSDPService::SendResponse( struct sockaddr_in address )
 {
-    if (lssdp == NULL) {
-        lssdp_error("lssdp should not be NULL\n");
-        return -1;
-    }
-
-    if (lssdp->port == 0) {
-        lssdp_error("SSDP port (%d) has not been setup.\n", lssdp->port);
+    // get M-SEARCH IP
+    ORA_CHAR msearchIp[SSDP_IP_LEN] = {};
+    if( inet_ntop(AF_INET, &address.sin_addr, msearchIp, sizeof(msearchIp)) == ORA_NULL )
+    {
+        printf("inet_ntop failed, errno = %s (%d)\n", strerror(errno), errno);
         return -1;
     }
 
-    // check network inerface number
-    if (lssdp->interface_num == 0) {
-        lssdp_warn("Network Interface is empty, no destination to send %s\n", Global.NOTIFY);
+    // 1. find the interface which is in LAN, the response goes back through it
+    SSDP_LINK_T *pLink = FindInterfaceInLAN( address.sin_addr.s_addr );
+    if( pLink == ORA_NULL )
+    {
+        printf("RECV <- %-8s   Interface is not found        %s\n", Global.MSEARCH, msearchIp);
         return -1;
     }
 
-    size_t i;
-    for (i = 0; i < lssdp->interface_num; i++) {
-        struct lssdp_interface * interface = &lssdp->interface[i];
+    // 2. patch DATE of the prebuilt response
+    SSDP_MSG_T &response = pLink->ResponseMsg;
+    PatchDate( response );
 
-        // avoid sending multicast to localhost
-        if (interface->addr == inet_addr(Global.ADDR_LOCALHOST)) {
-            continue;
-        }
+    // 3. set port to address
+    address.sin_port = htons( m_Port );
 
-        // set notify packet
-        char notify[LSSDP_BUFFER_LEN] = {};
-        char * domain = lssdp->header.location.domain;
-        snprintf(notify, sizeof(notify),
-            "%s"
-            "HOST:%s:%d\r\n"
-            "CACHE-CONTROL:max-age=120\r\n"
-            "LOCATION:%s%s%s\r\n"
-            "SERVER:OS/version product/version\r\n"
-            "NT:%s\r\n"
-            "NTS:ssdp:alive\r\n"
-            "USN:%s\r\n"
-            "SM_ID:%s\r\n"
-            "DEV_TYPE:%s\r\n"
-            "\r\n",
-            Global.HEADER_NOTIFY,                       // HEADER
-            Global.ADDR_MULTICAST, lssdp->port,         // HOST
-            lssdp->header.location.prefix,              // LOCATION
-            strlen(domain) > 0 ? domain : interface->ip,
-            lssdp->header.location.suffix,
-            lssdp->header.search_target,                // NT (Notify Type)
-            lssdp->header.unique_service_name,          // USN
-            lssdp->header.sm_id,                        // SM_ID    (addtional field)
-            lssdp->header.device_type                   // DEV_TYPE (addtional field)
-        );
-
-        // send NOTIFY
-        int ret = send_multicast_data(notify, *interface, lssdp->port);
-        if (ret == 0 && lssdp->debug) {
-            lssdp_info("SEND => %-8s   %s => MULTICAST\n", Global.NOTIFY, interface->ip);
-        }
+    // 4. send data
+    if( sendto(pLink->Socket, response.Data, response.Length, 0, (struct sockaddr *)&address, sizeof(struct sockaddr_in)) == -1 )
+    {
+        printf("send RESPONSE to %s failed, errno = %s (%d)\n", msearchIp, strerror(errno), errno);
+        return -1;
     }
 
-    // network inerface is empty
-    if (i == 0) lssdp_warn("Network Interface is empty, no destination to send %s\n", Global.NOTIFY);
-
     return 0;
 }
 
-// 07. lssdp_neighbor_check_timeout
-ORA_INT32 CSSDPService::NeighborCheckTimeout()
+/**
+ * @brief queue a RESPONSE to the M-SEARCH requester with a random delay within its MX window,
+ * so the neighbors don't answer a new device in the same millisecond.
+ * an M-SEARCH from a requester who is already waiting for the response is merged into it.
+ *
+ * @param pData    M-SEARCH packet data
+ * @param packet   M-SEARCH packet views over pData
+ * @param address  requester's address
+ *
+ * @return 0 if queued or merged, -1 if the queue is full
+ */
+ORA_INT32 CSSDPService::ScheduleResponse( const ORA_CHAR *pData, const SSDP_PACKET_VIEW_T &packet, const struct sockaddr_in &address )
 {
-    // check neighbor_timeout
-    if (m_NeighborTimeout <= 0)
+    // 0. the requester already knows this device
+    if( packet.Known.Length > 0 && IsKnownAnswer(pData, packet.Known) )
     {
-        printf("neighbor_timeout (%ld) is invalid, ignore check_timeout request.\n", m_NeighborTimeout);
+        m_ResponseStats.Suppressed++;
         return 0;
     }
 
-    ORA_INT64 currentTime = GetCurrentTime();
-    if (currentTime < 0)
+    // 1. merge with the queued response of the same requester, it's still due within the first window
+    for( ORA_UINT32 i = 0; i < m_ResponseCount; i++ )
     {
-        printf("got invalid timestamp %lld\n", currentTime);
+        if( m_Responses[i].Address.sin_addr.s_addr == address.sin_addr.s_addr )
+        {
+            m_ResponseStats.Merged++;
+            return 0;
+        }
+    }
+
+    if( m_ResponseCount == SSDP_RESPONSE_QUEUE_LEN )
+    {
+        m_ResponseStats.Dropped++;
         return -1;
     }
 
-    ORA_BOOL isChanged = ORA_FALSE;
-    SSDP_NBR_T *prev = ORA_NULL;
-    SSDP_NBR_T *nbr  = m_pNeighborList;
-    while ( nbr != ORA_NULL )
+    // 2. get MX, an invalid MX falls back to SSDP_MX_DEFAULT, and it's capped to SSDP_MX_MAX
+    ORA_INT32 mx = SSDP_MX_DEFAULT;
+    if( packet.Mx.Length > 0 )
+    {
+        ORA_CHAR value[8];
+        FieldCopy( pData, packet.Mx, value, sizeof(value) );
+        ORA_INT32 seconds = atoi( value );
+        if( seconds >= 1 )
+            mx = seconds < SSDP_MX_MAX ? seconds : SSDP_MX_MAX;
+    }
+
+    // 3. queue it with a random delay in [0, MX)
+    SSDP_PENDING_RESPONSE_T &pending = m_Responses[m_ResponseCount++];
+    pending.Address = address;
+    pending.DueTime = packet.UpdateTime + rand_r( &m_RandSeed ) % ( mx * 1000 );
+
+    m_ResponseStats.Scheduled++;
+    m_ResponseStats.QueueDepth = m_ResponseCount;
+    if( m_ResponseCount > m_ResponseStats.MaxQueueDepth )
+        m_ResponseStats.MaxQueueDepth = m_ResponseCount;
+
+    return 0;
+}
+
+/**
+ * @brief send the queued responses which are due, called by the reactor's timer
+ *
+ * @param currentTime current time (ms)
+ */
+ORA_VOID CSSDPService::FlushResponses( ORA_INT64 currentTime )
+{
+    CORASectionLock lock( m_SocketLock );
+
+    ORA_UINT32 i = 0;
+    while( i < m_ResponseCount )
     {
-        ORA_INT64 passTime = currentTime - nbr->UpdateTime;
-        if ( passTime < m_NeighborTimeout )
+        if( m_Responses[i].DueTime > currentTime )
         {
-            prev = nbr;
-            nbr  = nbr->Next;
+            i++;
             continue;
         }
 
-        isChanged = ORA_TRUE;
-        printf("remove timeout SSDP neighbor: %s (%s) (%ldms)\n", nbr->SmId, nbr->Location, passTime);
-        // invoke neighbor list lost callback
-        if ( m_pSSDPContext->NeighborLostCallback!= ORA_NULL )
-        {
-            m_pSSDPContext->NeighborLostCallback();
-        }
+        if( SendResponse(m_Responses[i].Address) == 0 )
+            m_ResponseStats.Sent++;
 
-        if (prev == ORA_NULL)
-        {
-            // it's first neighbor in list
-            m_pNeighborList = nbr->next;
-            free(nbr);
-            nbr = m_pNeighborList;
-        }
-        else
-        {
-            prev->Next = nbr->Next;
-            free(nbr);
-            nbr = prev->Next;
-        }
+        // remove it: move the last one here
+        m_Responses[i] = m_Responses[--m_ResponseCount];
     }
 
-    return 0;
+    m_ResponseStats.QueueDepth = m_ResponseCount;
 }
 
-
-/** Internal Function **/
-
-ORA_INT32 CSSDPService::send_multicast_data(const char * data, const struct lssdp_interface interface, unsigned short ssdp_port)
+/**
+ * @brief the earliest due time of the queued responses
+ *
+ * @return due time (ms), -1 if the queue is empty
+ */
+ORA_INT64 CSSDPService::NextResponseTime() const
 {
-    if (data == NULL) {
-        lssdp_error("data should not be NULL\n");
-        return -1;
+    ORA_INT64 dueTime = -1;
+    for( ORA_UINT32 i = 0; i < m_ResponseCount; i++ )
+    {
+        if( dueTime < 0 || m_Responses[i].DueTime < dueTime )
+            dueTime = m_Responses[i].DueTime;
     }
+    return dueTime;
+}
 
-    size_t data_len = strlen(data);
-    if (data_len == 0) {
-        lssdp_error("data length should not be empty\n");
-        return -1;
+/**
+ * @brief build the known-answer field of M-SEARCH: "X-KNOWN:<seed>-<bits>" in hex, a Bloom filter
+ * of the USNs of the neighbors refreshed within the last half neighbor timeout. a responder covered
+ * by the filter doesn't answer. the seed is new per M-SEARCH, so a false positive doesn't hide
+ * the same device twice.
+ *
+ * @param pBuf         buffer to write the field line (CRLF included) to
+ * @param bufLen       buffer length
+ * @param currentTime  current time (ms)
+ *
+ * @return length written, 0 if there is no digest
+ */
+ORA_SIZE CSSDPService::BuildKnownAnswer( ORA_CHAR *pBuf, ORA_SIZE bufLen, ORA_INT64 currentTime )
+{
+    // 1. count the fresh neighbors, the expiring and the restored ones should answer
+    ORA_INT64  freshDeadline = currentTime + m_NeighborTimeout / 2;
+    ORA_UINT32 count = 0;
+    for( ORA_UINT32 handle = m_NeighborTable.First(); handle != SSDP_NBR_INVALID; handle = m_NeighborTable.Next( handle ) )
+    {
+        const SSDP_NBR_T &nbr = m_NeighborTable.At( handle );
+        if( nbr.Deadline >= freshDeadline && !nbr.Usn.empty() && !nbr.Stale )
+            count++;
     }
 
-    if (strlen(interface.name) == 0) {
-        lssdp_error("interface.name should not be empty\n");
-        return -1;
+    if( count == 0 )
+    {
+        return 0;
     }
 
-    int result = -1;
+    // 2. size the filter, too many neighbors for one datagram: everyone answers
+    ORA_UINT32 bitCount = SSDP_KNOWN_MIN_BITS;
+    while( bitCount < count * SSDP_KNOWN_BITS_PER_USN )
+        bitCount <<= 1;
 
-    // 1. create UDP socket
-    int fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (fd < 0) {
-        lssdp_error("create socket failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
+    ORA_SIZE fieldLen = strlen("X-KNOWN:") + 8 + 1 + bitCount / 4 + 2;
+    if( bitCount > SSDP_KNOWN_MAX_BITS || fieldLen > bufLen )
+    {
+        return 0;
     }
 
-    // 2. bind socket
-    struct sockaddr_in addr = {
-        .sin_family      = AF_INET,
-        .sin_addr.s_addr = interface.addr
-    };
-    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        lssdp_error("bind failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
-    }
+    // 3. add the fresh USNs, 4 bits per hex digit
+    ORA_UINT8  nibbles[SSDP_KNOWN_MAX_BITS / 4];
+    ORA_UINT32 positions[SSDP_BLOOM_HASHES];
+    ORA_UINT32 seed = static_cast< ORA_UINT32 >( rand_r(&m_RandSeed) );
+    memset( nibbles, 0, bitCount / 4 );
+    for( ORA_UINT32 handle = m_NeighborTable.First(); handle != SSDP_NBR_INVALID; handle = m_NeighborTable.Next( handle ) )
+    {
+        const SSDP_NBR_T &nbr = m_NeighborTable.At( handle );
+        if( nbr.Deadline < freshDeadline || nbr.Usn.empty() || nbr.Stale )
+            continue;
 
-    // 3. disable IP_MULTICAST_LOOP
-    char opt = 0;
-    if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &opt, sizeof(opt)) < 0) {
-        lssdp_error("setsockopt IP_MULTICAST_LOOP failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
+        CSSDPUtils::BloomPositions( seed, nbr.Usn.data(), nbr.Usn.size(), bitCount, positions );
+        for( ORA_UINT32 i = 0; i < SSDP_BLOOM_HASHES; i++ )
+        {
+            nibbles[positions[i] >> 2] |= 1 << ( positions[i] & 3 );
+        }
     }
 
-    // 4. set destination address
-    struct sockaddr_in dest_addr = {
-        .sin_family = AF_INET,
-        .sin_port = htons(ssdp_port)
-    };
-    if (inet_aton(Global.ADDR_MULTICAST, &dest_addr.sin_addr) == 0) {
-        lssdp_error("inet_aton failed, errno = %s (%d)\n", strerror(errno), errno);
-        goto end;
+    // 4. write the field
+    static const ORA_CHAR s_Hex[] = "0123456789abcdef";
+    ORA_SIZE len = snprintf( pBuf, bufLen, "X-KNOWN:%08x-", seed );
+    for( ORA_UINT32 i = 0; i < bitCount / 4; i++ )
+    {
+        pBuf[len++] = s_Hex[nibbles[i]];
     }
+    pBuf[len++] = '\r';
+    pBuf[len++] = '\n';
 
-    // 5. send data
-    if (sendto(fd, data, data_len, 0, (struct sockaddr *)&dest_addr, sizeof(dest_addr)) == -1) {
-        lssdp_error("sendto %s (%s) failed, errno = %s (%d)\n", interface.name, interface.ip, strerror(errno), errno);
-        goto end;
-    }
+    return len;
+}
 
-    result = 0;
-end:
-    if (fd >= 0 && close(fd) != 0) {
-        lssdp_error("close fd %d failed, errno = %s (%d)\n", strerror(errno), errno);
+/**
+ * @brief check whether the USN of this device is covered by the known-answer digest of an M-SEARCH,
+ * only the bits of our own positions are decoded. a malformed digest covers nothing.
+ *
+ * @param pData  M-SEARCH packet data
+ * @param known  view of the X-KNOWN value
+ *
+ * @return ORA_TRUE if the requester already knows this device
+ */
+ORA_BOOL CSSDPService::IsKnownAnswer( const ORA_CHAR *pData, const SSDP_FIELD_VIEW_T &known ) const
+{
+    // 1. <seed>-<bits>
+    const ORA_CHAR *pValue = pData + known.Offset;
+    if( known.Length < 10 || pValue[8] != '-' )
+    {
+        return ORA_FALSE;
     }
-    return result;
-}
 
-ORA_INT32 CSSDPService::lssdp_send_response(lssdp_ctx * lssdp, struct sockaddr_in address) {
-    // get M-SEARCH IP
-    char msearch_ip[LSSDP_IP_LEN] = {};
-    if (inet_ntop(AF_INET, &address.sin_addr, msearch_ip, sizeof(msearch_ip)) == NULL) {
-        lssdp_error("inet_ntop failed, errno = %s (%d)\n", strerror(errno), errno);
-        return -1;
+    ORA_UINT32 seed = 0;
+    for( ORA_UINT32 i = 0; i < 8; i++ )
+    {
+        ORA_INT32 value = HexValue( pValue[i] );
+        if( value < 0 )
+            return ORA_FALSE;
+        seed = ( seed << 4 ) | value;
     }
 
-    // 1. find the interface which is in LAN
-    struct lssdp_interface * interface = find_interface_in_LAN(lssdp, address.sin_addr.s_addr);
-    if (interface == NULL) {
-        if (lssdp->debug) {
-            lssdp_info("RECV <- %-8s   Interface is not found        %s\n", Global.MSEARCH, msearch_ip);
-        }
+    const ORA_CHAR *pBits = pValue + 9;
+    ORA_UINT32 bitCount = ( known.Length - 9 ) * 4;
+    if( bitCount < SSDP_KNOWN_MIN_BITS || bitCount > SSDP_KNOWN_MAX_BITS || ( bitCount & ( bitCount - 1 ) ) != 0 )
+    {
+        return ORA_FALSE;
+    }
 
-        if (lssdp->interface_num == 0) {
-            lssdp_warn("Network Interface is empty, no destination to send %s\n", Global.RESPONSE);
-        }
-        return -1;
+    // 2. test our own positions
+    const string &usn = m_SSDPContext.Header.Usn;
+    ORA_UINT32 positions[SSDP_BLOOM_HASHES];
+    CSSDPUtils::BloomPositions( seed, usn.data(), usn.size(), bitCount, positions );
+    for( ORA_UINT32 i = 0; i < SSDP_BLOOM_HASHES; i++ )
+    {
+        ORA_INT32 value = HexValue( pBits[positions[i] >> 2] );
+        if( value < 0 || ( ( value >> ( positions[i] & 3 ) ) & 1 ) == 0 )
+            return ORA_FALSE;
     }
 
-    // 2. set response packet
-    char response[LSSDP_BUFFER_LEN] = {};
-    char * domain = lssdp->header.location.domain;
-    int response_len = snprintf(response, sizeof(response),
-        "%s"
-        "CACHE-CONTROL:max-age=120\r\n"
-        "DATE:\r\n"
-        "EXT:\r\n"
-        "LOCATION:%s%s%s\r\n"
-        "SERVER:OS/version product/version\r\n"
-        "ST:%s\r\n"
-        "USN:%s\r\n"
-        "SM_ID:%s\r\n"
-        "DEV_TYPE:%s\r\n"
-        "\r\n",
-        Global.HEADER_RESPONSE,                     // HEADER
-        lssdp->header.location.prefix,              // LOCATION
-        strlen(domain) > 0 ? domain : interface->ip,
-        lssdp->header.location.suffix,
-        lssdp->header.search_target,                // ST (Search Target)
-        lssdp->header.unique_service_name,          // USN
-        lssdp->header.sm_id,                        // SM_ID    (addtional field)
-        lssdp->header.device_type                   // DEV_TYPE (addtional field)
-    );
+    return ORA_TRUE;
+}
 
-    // 3. set port to address
-    address.sin_port = htons(lssdp->port);
+/**
+ * @brief trim the spaces and non-printable characters at both ends of [start, end]
+ *
+ * @return -1 if nothing is left
+ */
+static inline ORA_INT32 trim_spaces( const ORA_CHAR *string, ORA_SIZE *start, ORA_SIZE *end )
+{
+    ORA_INT32 i = *start;
+    ORA_INT32 j = *end;
 
-    if (lssdp->debug) {
-        lssdp_info("RECV <- %-8s   %s <- %s\n", Global.MSEARCH, interface->ip, msearch_ip);
-    }
+    // equals to (!isprint(c) || isspace(c)) in the C locale, without the ctype lookups
+    while( i <= (ORA_INT32)*end   && ((ORA_UINT8)string[i] <= ' ' || (ORA_UINT8)string[i] >= 0x7F) ) i++;
+    while( j >= (ORA_INT32)*start && ((ORA_UINT8)string[j] <= ' ' || (ORA_UINT8)string[j] >= 0x7F) ) j--;
 
-    // 4. send data
-    if (sendto(lssdp->sock, response, response_len, 0, (struct sockaddr *)&address, sizeof(struct sockaddr_in)) == -1) {
-        lssdp_error("send RESPONSE to %s failed, errno = %s (%d)\n", msearch_ip, strerror(errno), errno);
+    if( i > j )
+    {
         return -1;
     }
 
-    if (lssdp->debug) {
-        lssdp_info("SEND => %-8s   %s => %s\n", Global.RESPONSE, interface->ip, msearch_ip);
-    }
-
+    *start = i;
+    *end   = j;
     return 0;
 }
 
-ORA_INT32 CSSDPService::PacketParser(const ORA_CHAR *pData, ORA_INT dataLen, SSDP_PACKET_T *pPacket)
+ORA_INT32 CSSDPService::PacketParser( const ORA_CHAR *pData, ORA_INT dataLen, SSDP_PACKET_VIEW_T *pPacket )
 {
-    if (pData == ORA_NULL)
+    static const ORA_SIZE s_MsearchLen  = strlen( Global.HEADER_MSEARCH );
+    static const ORA_SIZE s_NotifyLen   = strlen( Global.HEADER_NOTIFY );
+    static const ORA_SIZE s_ResponseLen = strlen( Global.HEADER_RESPONSE );
+
+    if( pData == ORA_NULL )
     {
         printf("data should not be NULL\n");
         return -1;
     }
 
-    if (dataLen != strlen(pData))
+    if( dataLen <= 0 || dataLen > SSDP_BUFFER_LEN )
     {
-        printf("data_len (%zu) is not match to the data length (%zu)\n", dataLen, strlen(pData));
+        printf("data_len (%d) is invalid\n", dataLen);
         return -1;
     }
 
-    if (pPacket == ORA_NULL)
+    if( pPacket == ORA_NULL )
     {
         printf("packet should not be NULL\n");
         return -1;
     }
 
+    memset( pPacket, 0, sizeof(SSDP_PACKET_VIEW_T) );
+
     // 1. compare SSDP Method Header: M-SEARCH, NOTIFY, RESPONSE
-    size_t i;
-    if ((i = strlen(Global.HEADER_MSEARCH)) < data_len && memcmp(data, Global.HEADER_MSEARCH, i) == 0) {
-        strcpy(packet->method, Global.MSEARCH);
-    } else if ((i = strlen(Global.HEADER_NOTIFY)) < data_len && memcmp(data, Global.HEADER_NOTIFY, i) == 0) {
-        strcpy(packet->method, Global.NOTIFY);
-    } else if ((i = strlen(Global.HEADER_RESPONSE)) < data_len && memcmp(data, Global.HEADER_RESPONSE, i) == 0) {
-        strcpy(packet->method, Global.RESPONSE);
-    } else {
+    ORA_SIZE len = dataLen;
+    ORA_SIZE i;
+    if( (i = s_MsearchLen) < len && memcmp(pData, Global.HEADER_MSEARCH, i) == 0 )
+    {
+        pPacket->Method = SM_MSEARCH;
+    }
+    else if( (i = s_NotifyLen) < len && memcmp(pData, Global.HEADER_NOTIFY, i) == 0 )
+    {
+        pPacket->Method = SM_NOTIFY;
+    }
+    else if( (i = s_ResponseLen) < len && memcmp(pData, Global.HEADER_RESPONSE, i) == 0 )
+    {
+        pPacket->Method = SM_RESPONSE;
+    }
+    else
+    {
         printf("received unknown SSDP packet\n");
-        printf("%s\n", pData);
         return -1;
     }
 
-    // 2. parse each field line
-    size_t start = i;
-    for (i = start; i < data_len; i++) {
-        if (data[i] == '\n' && i - 1 > start && data[i - 1] == '\r') {
-            parse_field_line(data, start, i - 2, packet);
-            start = i + 1;
-        }
+    // 2. locate every line and colon in one pass, then parse each field line
+    SSDP_LINE_T lines[SSDP_MAX_LINES];
+    ORA_SIZE lineNum = CSSDPUtils::ScanLines( pData, len, lines, SSDP_MAX_LINES );
+    for( ORA_SIZE n = 0; n < lineNum; n++ )
+    {
+        // skip the method line
+        if( lines[n].Start < i )
+            continue;
+        ParseFieldLine( pData, lines[n], pPacket );
     }
 
     // 3. set update_time
-    long long current_time = get_current_time();
-    if (current_time < 0) {
-        lssdp_error("got invalid timestamp %lld\n", current_time);
+    ORA_INT64 currentTime = GetCurrentTime();
+    if( currentTime < 0 )
+    {
+        printf("got invalid timestamp %lld\n", currentTime);
         return -1;
     }
-    packet->update_time = current_time;
+    pPacket->UpdateTime = currentTime;
     return 0;
 }
 
-static int parse_field_line(const char * data, size_t start, size_t end, lssdp_packet * packet) {
-    // 1. find the colon
-    if (data[start] == ':') {
-        lssdp_warn("the first character of line should not be colon\n");
-        lssdp_debug("%s\n", data);
+ORA_INT32 CSSDPService::ParseFieldLine( const ORA_CHAR *pData, const SSDP_LINE_T &line, SSDP_PACKET_VIEW_T *pPacket )
+{
+    // 1. check the colon
+    if( line.Colon < 0 || (ORA_SIZE)line.Colon > line.End )
+    {
+        printf("there is no colon in line\n");
         return -1;
     }
 
-    int colon = get_colon_index(data, start + 1, end);
-    if (colon == -1) {
-        lssdp_warn("there is no colon in line\n");
-        lssdp_debug("%s\n", data);
+    if( line.Colon == line.Start )
+    {
+        printf("the first character of line should not be colon\n");
         return -1;
     }
 
-    if (colon == end) {
+    if( (ORA_SIZE)line.Colon == line.End )
+    {
         // value is empty
         return -1;
     }
 
+    ORA_SIZE colon = line.Colon;
+    ORA_SIZE end   = line.End;
+    ORA_SIZE start = line.Start;
 
     // 2. get field, field_len
-    size_t i = start;
-    size_t j = colon - 1;
-    if (trim_spaces(data, &i, &j) == -1) {
+    ORA_SIZE i = start;
+    ORA_SIZE j = colon - 1;
+    if( trim_spaces(pData, &i, &j) == -1 )
+    {
         return -1;
     }
-    const char * field = &data[i];
-    size_t field_len = j - i + 1;
-
+    const ORA_CHAR *field = &pData[i];
+    ORA_SIZE field_len = j - i + 1;
 
     // 3. get value, value_len
     i = colon + 1;
     j = end;
-    if (trim_spaces(data, &i, &j) == -1) {
+    if( trim_spaces(pData, &i, &j) == -1 )
+    {
         return -1;
-    };
-    const char * value = &data[i];
-    size_t value_len = j - i + 1;
-
-
-    // 4. set each field's value to packet
-    if (field_len == strlen("st") && strncasecmp(field, "st", field_len) == 0) {
-        memcpy(packet->st, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
-        return 0;
-    }
-
-    if (field_len == strlen("nt") && strncasecmp(field, "nt", field_len) == 0) {
-        memcpy(packet->st, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
-        return 0;
     }
+    SSDP_FIELD_VIEW_T value = { static_cast< ORA_UINT16 >( i ), static_cast< ORA_UINT16 >( j - i + 1 ) };
 
-    if (field_len == strlen("usn") && strncasecmp(field, "usn", field_len) == 0) {
-        memcpy(packet->usn, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
-        return 0;
-    }
-
-    if (field_len == strlen("location") && strncasecmp(field, "location", field_len) == 0) {
-        memcpy(packet->location, value, value_len < LSSDP_LOCATION_LEN ? value_len : LSSDP_LOCATION_LEN - 1);
-        return 0;
-    }
+    // 4. set each field's view to packet
+    switch( CSSDPUtils::LookupField( field, field_len ) )
+    {
+    case SF_ST:
+    case SF_NT:
+        pPacket->St = value;
+        break;
 
-    if (field_len == strlen("sm_id") && strncasecmp(field, "sm_id", field_len) == 0) {
-        memcpy(packet->sm_id, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
-        return 0;
-    }
+    case SF_USN:
+        pPacket->Usn = value;
+        break;
 
-    if (field_len == strlen("dev_type") && strncasecmp(field, "dev_type", field_len) == 0) {
-        memcpy(packet->device_type, value, value_len < LSSDP_FIELD_LEN ? value_len : LSSDP_FIELD_LEN - 1);
-        return 0;
-    }
+    case SF_LOCATION:
+        pPacket->Location = value;
+        break;
 
-    // the field is not in the struct packet
-    return 0;
-}
+    case SF_SM_ID:
+        pPacket->SmId = value;
+        break;
 
-static int get_colon_index(const char * string, size_t start, size_t end) {
-    size_t i;
-    for (i = start; i <= end; i++) {
-        if (string[i] == ':') {
-            return i;
-        }
-    }
-    return -1;
-}
+    case SF_DEV_TYPE:
+        pPacket->DeviceType = value;
+        break;
 
-static int trim_spaces(const char * string, size_t * start, size_t * end) {
-    int i = *start;
-    int j = *end;
+    case SF_MX:
+        pPacket->Mx = value;
+        break;
 
-    while (i <= *end   && (!isprint(string[i]) || isspace(string[i]))) i++;
-    while (j >= *start && (!isprint(string[j]) || isspace(string[j]))) j--;
+    case SF_KNOWN:
+        pPacket->Known = value;
+        break;
 
-    if (i > j) {
-        return -1;
+    default:
+        // the field is not in the struct packet
+        break;
     }
 
-    *start = i;
-    *end   = j;
     return 0;
 }
 
@@ -815,79 +2206,107 @@ ORA_UINT64 CSSDPService::GetCurrentTime() {
     return (ORA_UINT64) time.tv_sec * 1000 + (ORA_UINT64) time.tv_usec / 1000;
 }
 
-ORA_INT32 NeighborListAdd(const SSDP_PACKET_T packet)
+ORA_INT32 CSSDPService::NeighborListAdd( const SSDP_LINK_T &link, const ORA_CHAR *pData, const SSDP_PACKET_VIEW_T &packet, const struct sockaddr_in &address )
 {
-    SSDP_NBR_T *pLastNbr = m_pNeighborList;
-
     ORA_BOOL isChanged = ORA_FALSE;
-    SSDP_NBR_T *pNbr;
-    for ( pNbr = m_pNeighborList; pNbr != ORA_NULL; pLastNbr = pNbr, pNbr = pNbr->Next )
-    {
-        if ( strcmp(pNbr->Location, packet.Location) != 0 )
-        {
-            // location is not match
-            continue;
-        }
 
-        /* location is not found in SSDP list: update neighbor */
-
-        // usn
-        if (strcmp(nbr->usn, packet.usn) != 0) {
-            lssdp_debug("neighbor usn is changed. (%s -> %s)\n", nbr->usn, packet.usn);
-            memcpy(nbr->usn, packet.usn, LSSDP_FIELD_LEN);
-            is_changed = true;
-        }
+    ORA_SIZE locationLen = packet.Location.Length < SSDP_LOCATION_LEN ? packet.Location.Length : SSDP_LOCATION_LEN - 1;
+    ORA_INT64  deadline = packet.UpdateTime + m_NeighborTimeout;
+    ORA_UINT32 handle   = m_NeighborTable.Find( pData + packet.Location.Offset, locationLen );
+    if( handle == SSDP_NBR_INVALID )
+    {
+        /* location is not found in SSDP table: add to table */
+        handle = m_NeighborTable.Insert( pData + packet.Location.Offset, locationLen, deadline );
+        isChanged = ORA_TRUE;
+        OnNeighborChurn( packet.UpdateTime );
+    }
+    else
+    {
+        m_NeighborTable.SetDeadline( handle, deadline );
+    }
 
-        // sm_id
-        if (strcmp(nbr->sm_id, packet.sm_id) != 0) {
-            lssdp_debug("neighbor sm_id is changed. (%s -> %s)\n", nbr->sm_id, packet.sm_id);
-            memcpy(nbr->sm_id, packet.sm_id, LSSDP_FIELD_LEN);
-            is_changed = true;
-        }
+    /* update neighbor, copy only the changed fields */
+    SSDP_NBR_T &nbr = m_NeighborTable.At( handle );
+    if( nbr.Stale )
+    {
+        // a restored neighbor is confirmed: report it found now
+        nbr.Stale = ORA_FALSE;
+        isChanged = ORA_TRUE;
+    }
+    isChanged |= FieldAssign( pData, packet.Usn,        SSDP_FIELD_LEN, nbr.Usn );
+    isChanged |= FieldAssign( pData, packet.SmId,       SSDP_FIELD_LEN, nbr.SmId );
+    isChanged |= FieldAssign( pData, packet.DeviceType, SSDP_FIELD_LEN, nbr.DeviceType );
 
-        // device type
-        if (strcmp(nbr->device_type, packet.device_type) != 0) {
-            lssdp_debug("neighbor device_type is changed. (%s -> %s)\n", nbr->device_type, packet.device_type);
-            memcpy(nbr->device_type, packet.device_type, LSSDP_FIELD_LEN);
-            is_changed = true;
-        }
+    // update_time, and the interface it's seen on: the one in its LAN, a routed one is kept on the link
+    const SSDP_LINK_T *pLink = FindInterfaceInLAN( address.sin_addr.s_addr );
+    nbr.UpdateTime = packet.UpdateTime;
+    nbr.IfAddr     = pLink != ORA_NULL ? pLink->Interface.Addr : link.Interface.Addr;
+    nbr.Addr       = address.sin_addr.s_addr;
 
-        // update_time
-        nbr->update_time = packet.update_time;
-        goto end;
+    // invoke neighbor found callback
+    if( m_SSDPContext.NeighborFoundCallback != ORA_NULL && isChanged )
+    {
+        m_SSDPContext.NeighborFoundCallback( NW_DEVICE() );
     }
 
+    return 0;
+}
 
-    /* location is not found in SSDP list: add to list */
+/**
+ * @brief refresh the neighbors at the address of an M-SEARCH requester. the requester leaves
+ * the neighbors it knows out of the responses, so its own M-SEARCH has to keep it alive here,
+ * as theirs keep them alive on the requester. the restored neighbors wait for their answer.
+ *
+ * @param addr         requester's address in network byte order
+ * @param currentTime  current time (ms)
+ *
+ * @return the number of neighbors refreshed
+ */
+ORA_UINT32 CSSDPService::NeighborRefresh( ORA_UINT32 addr, ORA_INT64 currentTime )
+{
+    ORA_UINT32 count = 0;
+    for( ORA_UINT32 handle = m_NeighborTable.First(); handle != SSDP_NBR_INVALID; handle = m_NeighborTable.Next( handle ) )
+    {
+        SSDP_NBR_T &nbr = m_NeighborTable.At( handle );
+        if( nbr.Addr != addr || nbr.Stale )
+            continue;
 
-    // 1. memory allocate lssdp_nbr
-    nbr = (lssdp_nbr *) malloc(sizeof(lssdp_nbr));
-    if (nbr == NULL) {
-        lssdp_error("malloc failed, errno = %s (%d)\n", strerror(errno), errno);
-        return -1;
+        nbr.UpdateTime = currentTime;
+        m_NeighborTable.SetDeadline( handle, currentTime + m_NeighborTimeout );
+        count++;
     }
 
-    // 2. setup neighbor
-    memcpy(nbr->usn,         packet.usn,         LSSDP_FIELD_LEN);
-    memcpy(nbr->sm_id,       packet.sm_id,       LSSDP_FIELD_LEN);
-    memcpy(nbr->device_type, packet.device_type, LSSDP_FIELD_LEN);
-    memcpy(nbr->location,    packet.location,    LSSDP_LOCATION_LEN);
-    nbr->update_time = packet.update_time;
-    nbr->next = NULL;
+    return count;
+}
+
+/**
+ * @brief remove the neighbors seen on an interface which is gone or changed
+ *
+ * @param ifAddr interface address in network byte order
+ */
+ORA_INT32 CSSDPService::NeighborRemoveLink( ORA_UINT32 ifAddr )
+{
+    ORA_UINT32 count = 0;
+    for( ORA_UINT32 handle = m_NeighborTable.First(); handle != SSDP_NBR_INVALID; handle = m_NeighborTable.Next( handle ) )
+    {
+        const SSDP_NBR_T &nbr = m_NeighborTable.At( handle );
+        if( nbr.IfAddr != ifAddr )
+            continue;
+
+        // invoke neighbor lost callback
+        if( m_SSDPContext.NeighborLostCallback != ORA_NULL && !nbr.Stale )
+        {
+            m_SSDPContext.NeighborLostCallback( NW_DEVICE() );
+        }
 
-    // 3. add neighbor to the end of list
-    if (last_nbr == NULL) {
-        // it's the first neighbor
-        lssdp->neighbor_list = nbr;
-    } else {
-        last_nbr->next = nbr;
+        m_NeighborTable.Remove( handle );
+        count++;
     }
 
-    is_changed = true;
-end:
-    // invoke neighbor list changed callback
-    if (lssdp->neighbor_list_changed_callback != NULL && is_changed == true) {
-        lssdp->neighbor_list_changed_callback(lssdp);
+    if( count > 0 )
+    {
+        printf("%u neighbors of the closed interface have been removed.\n", count);
+        OnNeighborChurn( GetCurrentTime() );
     }
 
     return 0;
@@ -895,44 +2314,25 @@ end:
 
 ORA_INT32 CSSDPService::NeighborRemoveAll()
 {
-    if (m_pNeighborList == ORA_NULL)
+    if( m_NeighborTable.Size() == 0 )
     {
         return 0;
     }
 
-    // free neighbor_list
-    NeighborListFree(m_pNeighborList);
-    m_pNeighborList = ORA_NULL;
-
-    printf("neighbor list has been force clean up.\n");
-
-    return 0;
-}
-
-ORA_VOID CSSDPService::NeighborListFree(SSDP_NBR_T *List)
-{
-    if ( List != ORA_NULL )
+    // invoke neighbor lost callback for each neighbor
+    if( m_SSDPContext.NeighborLostCallback != ORA_NULL )
     {
-        // invoke neighbor list lost callback
-        if (m_pSSDPContext->NeighborLostCallback != ORA_NULL)
+        for( ORA_UINT32 handle = m_NeighborTable.First(); handle != SSDP_NBR_INVALID; handle = m_NeighborTable.Next( handle ) )
         {
-            m_pSSDPContext->NeighborLostCallback(lssdp);
+            if( !m_NeighborTable.At( handle ).Stale )
+                m_SSDPContext.NeighborLostCallback( NW_DEVICE() );
         }
-        NeighborListFree( List->Next );
-        free(List);
     }
-}
 
-static struct lssdp_interface * find_interface_in_LAN(lssdp_ctx * lssdp, uint32_t address) {
-    struct lssdp_interface * ifc;
-    size_t i;
-    for (i = 0; i < lssdp->interface_num; i++) {
-        ifc = &lssdp->interface[i];
+    // free neighbor table, the memory is kept for the next neighbors
+    m_NeighborTable.Clear();
 
-        // mask address to check whether the interface is under the same Local Network Area or not
-        if ((ifc->addr & ifc->netmask) == (address & ifc->netmask)) {
-            return ifc;
-        }
-    }
-    return NULL;
+    printf("neighbor list has been force clean up.\n");
+
+    return 0;
 }
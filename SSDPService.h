@@ -8,17 +8,159 @@
 #ifndef __SSDPSERVICE_H__
 #define __SSDPSERVICE_H__
 
+#include <atomic>
+
 #define SSDP_INTERFACE_NAME_LEN    16// IFNAMSIZ
 #define SSDP_IP_LEN                16
 #define SSDP_PORT                  1900
 #define SSDP_FIELD_LEN             128
 #define SSDP_LOCATION_LEN          256
 #define SSDP_BUFFER_LEN            2048
+#define SSDP_MAX_LINES             64
+#define SSDP_MSEARCH_INTERVAL      5000 // ms, default stable M-SEARCH interval
+#define SSDP_PROBE_INTERVAL_MIN    250  // ms, M-SEARCH interval right after the neighbor set changed
+#define SSDP_PROBE_UNRESOLVED_MAX  1000 // ms, the longest M-SEARCH interval while the role is unresolved
+#define SSDP_PROBE_JITTER          10   // %, random spread of each M-SEARCH interval
+#define SSDP_NEIGHBOR_TIMEOUT_PROBES 3  // a neighbor times out after missing this many stable intervals
+#define SSDP_RECV_BATCH            16   // datagrams per recvmmsg
+#define SSDP_RECV_BATCHES_PER_WAKE 4    // batches read from one interface before serving the others
+#define SSDP_MULTICAST_TTL         2
+#define SSDP_EPOLL_EVENTS          8
+#define SSDP_NETLINK_BUFFER_LEN    8192
+#define SSDP_RESPONSE_QUEUE_LEN    64   // pending M-SEARCH responses
+#define SSDP_MX_DEFAULT            1    // s, used when M-SEARCH has no valid MX
+#define SSDP_MX_MAX                5    // s, the largest MX honored (UPnP DA 1.1)
+#define SSDP_KNOWN_BITS_PER_USN    10   // known-answer Bloom filter bits per neighbor, ~1.7% false positive
+#define SSDP_KNOWN_MIN_BITS        64
+#define SSDP_KNOWN_MAX_BITS        4096 // the digest is left out when more neighbors are known
 
 class CSSDPService
 {
+// Assistant Structure
 public:
-    CSSDPService( SSDP_CONTEXT_T *pSSDPContext );
+    /** Enum: ssdp method of a received packet **/
+    enum SSDPMethod
+    {
+        SM_UNKNOWN,
+        SM_MSEARCH,   // M-SEARCH
+        SM_NOTIFY,    // NOTIFY
+        SM_RESPONSE,  // RESPONSE
+
+        SM_METHOD_COUNT
+    };
+
+    /** Struct: a field value inside of the receive buffer, no copy **/
+    typedef struct SSDP_FIELD_VIEW
+    {
+        ORA_UINT16  Offset;   // offset from the beginning of the packet
+        ORA_UINT16  Length;   // value length, 0 means the field is absent
+    }SSDP_FIELD_VIEW_T;
+
+    /** Struct: ssdp packet parsed as views over the receive buffer **/
+    typedef struct SSDP_PACKET_VIEW
+    {
+        SSDPMethod        Method;
+        SSDP_FIELD_VIEW_T St;         // Search Target (or Notify Type)
+        SSDP_FIELD_VIEW_T Usn;        // Unique Service Name
+        SSDP_FIELD_VIEW_T Location;   // Location
+        SSDP_FIELD_VIEW_T Mx;         // M-SEARCH maximum wait (s)
+        SSDP_FIELD_VIEW_T Known;      // M-SEARCH known-answer digest
+
+        /* Additional SSDP Header Fields */
+        SSDP_FIELD_VIEW_T SmId;
+        SSDP_FIELD_VIEW_T DeviceType;
+        ORA_INT64         UpdateTime;
+    }SSDP_PACKET_VIEW_T;
+
+    /** Struct: counters of the receive path **/
+    typedef struct SSDP_RECV_STATS
+    {
+        ORA_UINT64  Syscalls;       // recvmsg / recvmmsg calls which returned data
+        ORA_UINT64  Datagrams;      // datagrams received
+        ORA_UINT64  SyscallsSaved;  // syscalls saved by batching, Datagrams - Syscalls
+        ORA_UINT32  LastBatch;      // datagrams of the last batch
+        ORA_UINT32  MaxBatch;       // the largest batch seen
+
+        /* Foreign SSDP traffic, by the path which dropped it */
+        ORA_UINT64  KernelDropped;  // dropped by the socket filter, or by a full socket buffer (SO_RXQ_OVFL)
+        ORA_UINT64  FilterDropped;  // dropped by the userspace token filter, where the socket filter is missing
+        ORA_UINT64  TargetDropped;  // passed the token filter, but ST/NT is not the search target
+    }SSDP_RECV_STATS_T;
+
+    /** Struct: counters of the M-SEARCH response scheduler **/
+    typedef struct SSDP_RESPONSE_STATS
+    {
+        ORA_UINT64  Scheduled;      // responses queued
+        ORA_UINT64  Merged;         // M-SEARCHes merged into a queued response of the same requester
+        ORA_UINT64  Dropped;        // M-SEARCHes dropped because the queue was full
+        ORA_UINT64  Suppressed;     // M-SEARCHes not answered because the requester knows this device
+        ORA_UINT64  Refreshed;      // M-SEARCHes which refreshed the requester as a neighbor
+        ORA_UINT64  Sent;           // responses sent
+        ORA_UINT32  QueueDepth;     // responses waiting now
+        ORA_UINT32  MaxQueueDepth;  // the deepest queue seen
+    }SSDP_RESPONSE_STATS_T;
+
+    typedef struct SSDP_IF
+    {
+        string        Name;    // name[16]
+        string        Ip;      // ip[16] = "xxx.xxx.xxx.xxx"
+        ORA_UINT32    Addr;    // address in network byte order
+        ORA_UINT32    Netmask; // mask in network byte order
+    }SSDP_IF_T;
+
+    /* Struct : SSDP_HEADER, the header fields announced by this device */
+    typedef struct SSDP_HEADER
+    {
+        string        SearchTarget;   // ST / NT
+        string        Usn;            // Unique Service Name
+        string        SmId;
+        string        DeviceType;
+        string        LocationPrefix; // LOCATION = Prefix + (Domain or interface IP) + Suffix
+        string        LocationDomain;
+        string        LocationSuffix;
+    }SSDP_HEADER_T;
+
+    typedef struct SSDP_CONTEXT
+    {
+        vector< SSDP_IF_T > Interfaces;
+        SSDP_HEADER_T Header;
+        /* Callback Function */
+        ORA_INT32 (* NeighborFoundCallback) ( const NW_DEVICE &dev );
+        ORA_INT32 (* NeighborLostCallback)  ( const NW_DEVICE &dev );
+        ORA_INT32 (* PacketReceivedCallback)( const DEVICE_ID_T &sender, const ORA_VOID *pPacket, ORA_SIZE size );
+    }SSDP_CONTEXT_T;
+
+private:
+    /** Struct: a serialized SSDP message, only the volatile fields are patched before sending **/
+    typedef struct SSDP_MSG
+    {
+        ORA_CHAR      Data[SSDP_BUFFER_LEN];
+        ORA_SIZE      Length;
+        ORA_INT32     DateOffset;     // offset of the DATE value, -1 if there is no DATE
+        ORA_INT32     ExtOffset;      // offset of the closing empty line where optional fields go, -1 if none
+    }SSDP_MSG_T;
+
+    /** Struct: a response waiting for its random delay within the requester's MX window **/
+    typedef struct SSDP_PENDING_RESPONSE
+    {
+        struct sockaddr_in Address;   // requester
+        ORA_INT64     DueTime;        // ms
+    }SSDP_PENDING_RESPONSE_T;
+
+    /** Struct: an interface which SSDP runs on, with its own socket pair and messages **/
+    typedef struct SSDP_LINK
+    {
+        SSDP_IF_T     Interface;
+        ORA_INT32     Socket;         // receive socket, joined to the multicast group on this interface only
+        ORA_INT32     SendSocket;     // multicast sender socket, kept until the interface changes
+        ORA_BOOL      bKernelFilter;  // the token filter is attached to Socket
+        ORA_UINT32    KernelDrops;    // the socket's drop counter seen last
+        SSDP_MSG_T    NotifyMsg;      // LOCATION host is the interface IP
+        SSDP_MSG_T    ResponseMsg;
+    }SSDP_LINK_T;
+
+public:
+    CSSDPService( const SSDP_CONTEXT_T &context );
     ~CSSDPService();
 
 // Instance
@@ -35,80 +177,209 @@ public:
     //}
 
 public:
-    ORA_VOID  SSDPJoin();
+    ORA_BOOL  SSDPJoin();
     ORA_VOID  SSDPOffLine();
 
-    ORA_INT32 SSDPNetworkInterfaceUpdate( SSDP_IF_T Interface );
+    ORA_INT32 SSDPNetworkInterfaceUpdate( const vector< SSDP_IF_T > &interfaces );
+    ORA_INT32 SSDPSendMsearch();
+    ORA_INT32 SSDPSendNotify();
+    ORA_INT32 SSDPUpdateHeader( const SSDP_HEADER_T &header );
     ORA_INT32 SSDPBroadCastData( const ORA_VOID *pPacket );
     ORA_INT32 SSDPMulticastData( const ORA_VOID *pPacket, struct sockaddr_in address );
 
-private:
-    ORA_INT32 SocketCreate();
-    ORA_INT32 SocketClose();
-    ORA_INT32 SocketRead();
-    ORA_INT32 PacketParser( const ORA_CHAR *pData, ORA_INT dataLen, SSDP_PACKET_T *pPacket );
+    /**
+     * @brief set the M-SEARCH interval used once the neighbor set is stable,
+     * the neighbor timeout follows it.
+     *
+     * @param interval stable interval (ms), 0 means SSDP_MSEARCH_INTERVAL
+     */
+    ORA_VOID  SSDPSetStableInterval( ORA_UINT32 interval );
 
-    ORA_INT32 NeighborCheckTimeout();
-    ORA_INT32 NeighborListAdd( const SSDP_PACKET_T packet );
-    ORA_VOID  NeighborListFree( SSDP_NBR_T *pList );
-    ORA_INT32 NeighborRemoveAll();
+    /**
+     * @brief tell the discovery cadence whether the role of this device is resolved,
+     * M-SEARCH is kept under SSDP_PROBE_UNRESOLVED_MAX until it is. it is resolved by default.
+     */
+    ORA_VOID  SSDPSetRoleResolved( ORA_BOOL bResolved );
 
-    ORA_INT32 SendMsearch();
-    ORA_INT32 SendResponse( struct sockaddr_in address );
+    /**
+     * @brief get the confirmed neighbors for the checkpoint
+     *
+     * @param records receives the neighbors
+     */
+    ORA_VOID  SSDPGetNeighbors( vector< SSDP_NBR_RECORD_T > &records ) const;
 
-private:
-    /** Struct: ssdp packet **/
-    typedef struct SSDP_PACKET
-    {
-        string      Method;   // M-SEARCH, CAST, RESPONSE
-        string      St;       // Search Target
-        string      Usn;      // Unique Service Name
-        string      Location; // Location
+    /**
+     * @brief restore the neighbors of the checkpoint as stale: they are probed at once, reported
+     * found when they answer, and dropped silently if they don't within the neighbor timeout.
+     *
+     * @param records neighbors of the checkpoint
+     *
+     * @return the number of neighbors restored
+     */
+    ORA_UINT32 SSDPRestoreNeighbors( const vector< SSDP_NBR_RECORD_T > &records );
 
-        /* Additional SSDP Header Fields */
-        string      SmId;
-        string      DeviceType;
-        ORA_INT64   UpdateTime;
-    }SSDP_PACKET_T;
+    /**
+     * @brief get the current M-SEARCH interval (ms), without jitter
+     */
+    inline ORA_UINT32 SSDPGetProbeInterval() const
+    {
+        CORASectionLock lock( m_SocketLock );
+        return m_ProbeInterval;
+    }
 
-    /* Struct : SSDP_NBR */
-    typedef struct SSDP_NBR
+    /**
+     * @brief enable or disable the known-answer digest (X-KNOWN) in M-SEARCH,
+     * received digests are always honored.
+     */
+    inline ORA_VOID SSDPSetKnownAnswer( ORA_BOOL bEnable )
     {
-        string      Usn;      // Unique Service Name (Device Name or MAC)
-        string      Location; // URL or IP(:Port)
+        CORASectionLock lock( m_SocketLock );
+        m_bKnownAnswer = bEnable;
+    }
 
-        /* Additional SSDP Header Fields */
-        string      SmId;
-        string      DeviceType;
-        ORA_INT64   UpdateTime;
-        SSDP_NBR   *Next;
-    }SSDP_NBR_T;
+    /**
+     * @brief enable or disable the batched receive mode (recvmmsg)
+     */
+    inline ORA_VOID SSDPSetRecvBatch( ORA_BOOL bEnable )
+    {
+        CORASectionLock lock( m_SocketLock );
+        m_bRecvBatch = bEnable;
+    }
 
-    typedef struct SSDP_IF
+    /**
+     * @brief get the counters of the receive path
+     */
+    inline SSDP_RECV_STATS_T SSDPGetRecvStats() const
     {
-        string        Name;    // name[16]
-        string        Ip;      // ip[16] = "xxx.xxx.xxx.xxx"
-        ORA_UINT32    Addr;    // address in network byte order
-        ORA_UINT32    Netmask; // mask in network byte order
-    }SSDP_IF_T;
+        CORASectionLock lock( m_SocketLock );
+        return m_RecvStats;
+    }
 
-    typedef struct SSDP_CONTEXT
+    /**
+     * @brief get the counters of the M-SEARCH response scheduler
+     */
+    inline SSDP_RESPONSE_STATS_T SSDPGetResponseStats() const
     {
-        SSDP_IF_T Interface;
-        /* Callback Function */
-        ORA_INT32 (* NeighborFoundCallback) ( const NW_DEVICE &dev );
-        ORA_INT32 (* NeighborLostCallback)  ( const NW_DEVICE &dev );
-        ORA_INT32 (* PacketReceivedCallback)( const DEVICE_ID_T &sender, const ORA_VOID *pPacket, ORA_SIZE size );
-    }SSDP_CONTEXT_T;
+        CORASectionLock lock( m_SocketLock );
+        return m_ResponseStats;
+    }
+
+    /**
+     * @brief parse an SSDP datagram into views over it, nothing is copied.
+     * it has no state, the parser bench of the simulator calls it too.
+     *
+     * @param pData    datagram, not NUL terminated
+     * @param dataLen  datagram length
+     * @param pPacket  receives the method and the field views
+     *
+     * @return 0 if parsed successfully, otherwise -1
+     */
+    static ORA_INT32 PacketParser( const ORA_CHAR *pData, ORA_INT dataLen, SSDP_PACKET_VIEW_T *pPacket );
+
+private:
+    ORA_INT32 SocketCreate( SSDP_LINK_T &link );
+    ORA_INT32 SocketClose( SSDP_LINK_T &link );
+    ORA_VOID  BuildFilter();
+    ORA_VOID  AttachFilter( SSDP_LINK_T &link );
+    ORA_INT32 ApplyInterfaceUpdate();
+    ORA_INT32 ApplyInterfaceUpdateLocked();
+    ORA_VOID  LinkCloseAll();
+    ORA_VOID  LinkClose( SSDP_LINK_T &link );
+    SSDP_LINK_T* FindLinkBySocket( ORA_INT32 fd );
+    SSDP_LINK_T* FindInterfaceInLAN( ORA_UINT32 address );
 
-    SSDP_NBR_T      *m_pNeighborList;
-    SSDP_CONTEXT_T  *m_pSSDPContext;
+    ORA_INT32 ReactorCreate();
+    ORA_VOID  ReactorClose();
+    ORA_VOID  ReactorWatchSocket( ORA_INT32 fd );
+    ORA_VOID  ReactorArmTimer();
+    ORA_VOID  ReactorWakeup();
+    ORA_INT32 NetlinkCreate();
+    ORA_VOID  NetlinkClose();
+    ORA_VOID  ReadNetlink();
+    ORA_VOID  RefreshInterfaces();
+    static ORA_BOOL QueryInterface( const string &name, SSDP_IF_T &ifc );
+    ORA_VOID  RunScheduledTasks();
+    ORA_VOID  ScheduleNextProbe( ORA_INT64 currentTime );
+    ORA_VOID  OnNeighborChurn( ORA_INT64 currentTime );
+    ORA_INT32 ReadSocket( SSDP_LINK_T &link );
+    ORA_INT32 ReadSocketBatch( SSDP_LINK_T &link );
+    ORA_VOID  CountKernelDrops( SSDP_LINK_T &link, struct msghdr &msg );
+    ORA_INT32 HandlePacket( const SSDP_LINK_T &link, const ORA_CHAR *pData, ORA_INT dataLen, const SSDP_PACKET_VIEW_T &packet, const struct sockaddr_in &address );
+    static ORA_INT32 ParseFieldLine( const ORA_CHAR *pData, const SSDP_LINE_T &line, SSDP_PACKET_VIEW_T *pPacket );
+    static ORA_UINT64 GetCurrentTime();
+
+    ORA_INT32 NeighborCheckTimeout();
+    ORA_INT32 NeighborListAdd( const SSDP_LINK_T &link, const ORA_CHAR *pData, const SSDP_PACKET_VIEW_T &packet, const struct sockaddr_in &address );
+    ORA_UINT32 NeighborRefresh( ORA_UINT32 addr, ORA_INT64 currentTime );
+    ORA_INT32 NeighborRemoveLink( ORA_UINT32 ifAddr );
+    ORA_INT32 NeighborRemoveAll();
+
+    ORA_INT32 SenderCreate( SSDP_LINK_T &link );
+    ORA_VOID  SenderClose( SSDP_LINK_T &link );
+    ORA_INT32 SendMulticast( const SSDP_LINK_T &link, const ORA_CHAR *pData, ORA_SIZE dataLen );
+    ORA_INT32 SendResponse( struct sockaddr_in address );
+    ORA_INT32 ScheduleResponse( const ORA_CHAR *pData, const SSDP_PACKET_VIEW_T &packet, const struct sockaddr_in &address );
+    ORA_VOID  FlushResponses( ORA_INT64 currentTime );
+    ORA_INT64 NextResponseTime() const;
+    ORA_SIZE  BuildKnownAnswer( ORA_CHAR *pBuf, ORA_SIZE bufLen, ORA_INT64 currentTime );
+    ORA_BOOL  IsKnownAnswer( const ORA_CHAR *pData, const SSDP_FIELD_VIEW_T &known ) const;
+    ORA_INT32 BuildMessages();
+    ORA_INT32 BuildLinkMessages( SSDP_LINK_T &link );
+    ORA_VOID  PatchDate( SSDP_MSG_T &msg );
+
+// Properties
+private:
+    CSSDPNeighborTable m_NeighborTable;
+    SSDP_CONTEXT_T   m_SSDPContext;     // its own copy, the reactor applies the interface updates to it
     CSSDPUtils      *m_pSSDPUtils;
-    ORA_INT32        m_Socket;// SSDP socket
+    vector< SSDP_LINK_T > m_Links;  // one per interface
+    struct sockaddr_in m_MulticastAddr; // SSDP multicast group address
     ORA_UINT16       m_Port;
     ORA_INT64        m_LastTime;
     ORA_UINT64       m_NeighborTimeout;
 
+    /* Adaptive Discovery Cadence */
+    ORA_INT64        m_NextProbeTime;   // when the next M-SEARCH is sent (ms)
+    ORA_UINT32       m_ProbeInterval;   // current M-SEARCH interval (ms), doubled per quiet probe
+    ORA_UINT32       m_StableInterval;  // the interval backed off to once the neighbor set is stable (ms)
+    ORA_BOOL         m_bRoleResolved;   // set by the role manager, unresolved from NO_ROLE until SLAVE or MASTER
+    ORA_BOOL         m_bChurn;          // the neighbor set changed since the last M-SEARCH
+
+    /* Batched Receive, the buffers are reused by every batch */
+    ORA_BOOL           m_bRecvBatch;
+    ORA_CHAR           m_RecvBuffers[SSDP_RECV_BATCH][SSDP_BUFFER_LEN];
+    struct mmsghdr     m_RecvMsgs[SSDP_RECV_BATCH];
+    struct iovec       m_RecvIov[SSDP_RECV_BATCH];
+    struct sockaddr_in m_RecvAddrs[SSDP_RECV_BATCH];
+    ORA_CHAR           m_RecvCtrl[SSDP_RECV_BATCH][CMSG_SPACE(sizeof(ORA_UINT32))];   // SO_RXQ_OVFL
+    SSDP_RECV_STATS_T  m_RecvStats;
+
+    /* Token Filter, drops the traffic of foreign search targets: ST/NT value + CRLF */
+    string             m_FilterNeedle;
+    vector< struct sock_filter > m_FilterProgram;   // empty if it exceeds the cBPF limits
+
+    /* Prebuilt Messages */
+    SSDP_MSG_T         m_MsearchMsg;        // the same on every interface
+    ORA_BOOL           m_bKnownAnswer;      // append the known-answer digest to M-SEARCH
+    time_t             m_DateTime;          // the second which m_DateValue is formatted for
+    ORA_CHAR           m_DateValue[SSDP_DATE_LEN + 1];
+
+    /* M-SEARCH Response Scheduler, unordered, the queue is short */
+    SSDP_PENDING_RESPONSE_T m_Responses[SSDP_RESPONSE_QUEUE_LEN];
+    ORA_UINT32         m_ResponseCount;
+    ORA_UINT32         m_RandSeed;
+    SSDP_RESPONSE_STATS_T m_ResponseStats;
+
+    /* Reactor of the heartbeat thread */
+    ORA_INT32          m_EpollFd;
+    ORA_INT32          m_TimerFd;           // M-SEARCH / neighbor timeout schedule
+    ORA_INT32          m_EventFd;           // shutdown / reconfiguration
+    ORA_INT32          m_NetlinkFd;         // rtnetlink link and IPv4 address events
+    vector< string >   m_ConfiguredNames;   // interfaces to run on, tracked by rtnetlink
+    atomic< ORA_BOOL > m_bQuit;             // set by SSDPOffLine(), read by the reactor
+    ORA_BOOL           m_bInterfacePending; // m_PendingInterfaces need be applied by the reactor
+    vector< SSDP_IF_T > m_PendingInterfaces;
+
 // Thread Routines
 private:
     static ORA_INT_PTR HeartBeatThread( ORA_VOID *param );
@@ -6,5 +6,369 @@
  ************************************************************************/
 
 #include<iostream>
+#include <time.h>       // gmtime_r, strftime
+#include <string.h>     // memcmp
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>  // _mm_cmpeq_epi8, _mm256_cmpeq_epi8, movemask
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>   // vceqq_u8, vpaddq_u8
+#endif
+#include "SSDPUtils.h"
 using namespace std;
 
+/** Known header fields, placed at their perfect hash slot **/
+#define SSDP_FIELD_HASH_SIZE    16
+
+static const struct
+{
+    const ORA_CHAR *Name;   // lower case
+    ORA_SIZE        Length;
+    SSDPFieldID     ID;
+} s_FieldTable[SSDP_FIELD_HASH_SIZE] = {
+    /*  0 */ { ORA_NULL,   0, SF_UNKNOWN  },
+    /*  1 */ { "dev_type", 8, SF_DEV_TYPE },
+    /*  2 */ { "location", 8, SF_LOCATION },
+    /*  3 */ { ORA_NULL,   0, SF_UNKNOWN  },
+    /*  4 */ { "nt",       2, SF_NT       },
+    /*  5 */ { ORA_NULL,   0, SF_UNKNOWN  },
+    /*  6 */ { "usn",      3, SF_USN      },
+    /*  7 */ { "mx",       2, SF_MX       },
+    /*  8 */ { ORA_NULL,   0, SF_UNKNOWN  },
+    /*  9 */ { "st",       2, SF_ST       },
+    /* 10 */ { ORA_NULL,   0, SF_UNKNOWN  },
+    /* 11 */ { ORA_NULL,   0, SF_UNKNOWN  },
+    /* 12 */ { "sm_id",    5, SF_SM_ID    },
+    /* 13 */ { "x-known",  7, SF_KNOWN    },
+    /* 14 */ { ORA_NULL,   0, SF_UNKNOWN  },
+    /* 15 */ { ORA_NULL,   0, SF_UNKNOWN  },
+};
+
+/**
+ * @brief finalizer of MurmurHash3, spreads every input bit over the output
+ */
+static inline ORA_UINT32 Mix( ORA_UINT32 h )
+{
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline ORA_UINT8 ToLower( ORA_UINT8 c )
+{
+    return ( c >= 'A' && c <= 'Z' ) ? c | 0x20 : c;
+}
+
+/**
+ * @brief perfect hash of the known field names: (length + first + last) mod 16,
+ * the first and the last characters are folded to lower case.
+ */
+static inline ORA_SIZE FieldHash( const ORA_CHAR *pName, ORA_SIZE len )
+{
+    return ( len + ToLower( pName[0] ) + ToLower( pName[len - 1] ) ) & ( SSDP_FIELD_HASH_SIZE - 1 );
+}
+
+/**
+ * @brief walk the '\n' and ':' positions of a block in byte order and emit the finished lines.
+ *
+ * @return ORA_FALSE if pLines is full
+ */
+static inline ORA_BOOL EmitLines( const ORA_CHAR *pData, ORA_SIZE base, ORA_UINT64 nlMask, ORA_UINT64 colonMask,
+                                  ORA_SIZE &start, ORA_INT32 &colon, SSDP_LINE_T *pLines, ORA_SIZE &count, ORA_SIZE maxLines )
+{
+    ORA_UINT64 events = nlMask | colonMask;
+    while( events )
+    {
+        ORA_UINT32 bit = __builtin_ctzll( events );
+        ORA_SIZE   pos = base + bit;
+        events &= events - 1;
+
+        if( ( colonMask >> bit ) & 1 )
+        {
+            if( colon < 0 )
+                colon = pos;
+            continue;
+        }
+
+        // '\n': a line ends only with CRLF, an empty line is passed over without being emitted
+        if( pos >= 1 && pos - 1 >= start && pData[pos - 1] == '\r' )
+        {
+            if( pos - 1 > start )
+            {
+                if( count == maxLines )
+                    return ORA_FALSE;
+
+                pLines[count].Start = static_cast< ORA_UINT16 >( start );
+                pLines[count].End   = static_cast< ORA_UINT16 >( pos - 2 );
+                pLines[count].Colon = static_cast< ORA_INT16 >( colon );
+                count++;
+            }
+
+            start = pos + 1;
+            colon = -1;
+        }
+    }
+    return ORA_TRUE;
+}
+
+/**
+ * @brief build the '\n' and ':' bit masks of 64 bytes
+ */
+static inline ORA_VOID ScanBlock64( const ORA_CHAR *p, ORA_UINT64 &nlMask, ORA_UINT64 &colonMask )
+{
+#if defined(__AVX2__)
+    const __m256i nl = _mm256_set1_epi8( '\n' );
+    const __m256i cl = _mm256_set1_epi8( ':' );
+    __m256i lo = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( p ) );
+    __m256i hi = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( p + 32 ) );
+    nlMask    = static_cast< ORA_UINT32 >( _mm256_movemask_epi8( _mm256_cmpeq_epi8( lo, nl ) ) )
+              | static_cast< ORA_UINT64 >( static_cast< ORA_UINT32 >( _mm256_movemask_epi8( _mm256_cmpeq_epi8( hi, nl ) ) ) ) << 32;
+    colonMask = static_cast< ORA_UINT32 >( _mm256_movemask_epi8( _mm256_cmpeq_epi8( lo, cl ) ) )
+              | static_cast< ORA_UINT64 >( static_cast< ORA_UINT32 >( _mm256_movemask_epi8( _mm256_cmpeq_epi8( hi, cl ) ) ) ) << 32;
+#elif defined(__SSE2__)
+    const __m128i nl = _mm_set1_epi8( '\n' );
+    const __m128i cl = _mm_set1_epi8( ':' );
+    nlMask    = 0;
+    colonMask = 0;
+    for( ORA_UINT32 i = 0; i < 4; i++ )
+    {
+        __m128i v = _mm_loadu_si128( reinterpret_cast< const __m128i* >( p + i * 16 ) );
+        nlMask    |= static_cast< ORA_UINT64 >( _mm_movemask_epi8( _mm_cmpeq_epi8( v, nl ) ) ) << ( i * 16 );
+        colonMask |= static_cast< ORA_UINT64 >( _mm_movemask_epi8( _mm_cmpeq_epi8( v, cl ) ) ) << ( i * 16 );
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    static const ORA_UINT8 s_Bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint8x16_t bits = vld1q_u8( s_Bits );
+    const uint8x16_t nl   = vdupq_n_u8( '\n' );
+    const uint8x16_t cl   = vdupq_n_u8( ':' );
+    uint8x16_t v0 = vld1q_u8( reinterpret_cast< const ORA_UINT8* >( p ) );
+    uint8x16_t v1 = vld1q_u8( reinterpret_cast< const ORA_UINT8* >( p + 16 ) );
+    uint8x16_t v2 = vld1q_u8( reinterpret_cast< const ORA_UINT8* >( p + 32 ) );
+    uint8x16_t v3 = vld1q_u8( reinterpret_cast< const ORA_UINT8* >( p + 48 ) );
+
+    uint8x16_t n01 = vpaddq_u8( vandq_u8( vceqq_u8( v0, nl ), bits ), vandq_u8( vceqq_u8( v1, nl ), bits ) );
+    uint8x16_t n23 = vpaddq_u8( vandq_u8( vceqq_u8( v2, nl ), bits ), vandq_u8( vceqq_u8( v3, nl ), bits ) );
+    uint8x16_t c01 = vpaddq_u8( vandq_u8( vceqq_u8( v0, cl ), bits ), vandq_u8( vceqq_u8( v1, cl ), bits ) );
+    uint8x16_t c23 = vpaddq_u8( vandq_u8( vceqq_u8( v2, cl ), bits ), vandq_u8( vceqq_u8( v3, cl ), bits ) );
+    uint8x16_t n   = vpaddq_u8( n01, n23 );
+    uint8x16_t c   = vpaddq_u8( c01, c23 );
+    nlMask    = vgetq_lane_u64( vreinterpretq_u64_u8( vpaddq_u8( n, n ) ), 0 );
+    colonMask = vgetq_lane_u64( vreinterpretq_u64_u8( vpaddq_u8( c, c ) ), 0 );
+#else
+    nlMask    = 0;
+    colonMask = 0;
+    for( ORA_UINT32 i = 0; i < 64; i++ )
+    {
+        nlMask    |= static_cast< ORA_UINT64 >( p[i] == '\n' ) << i;
+        colonMask |= static_cast< ORA_UINT64 >( p[i] == ':' ) << i;
+    }
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// BEG: CSSDPUtils tokenizer
+ORA_SIZE CSSDPUtils::ScanLines( const ORA_CHAR *pData, ORA_SIZE len, SSDP_LINE_T *pLines, ORA_SIZE maxLines )
+{
+    ORA_ASSERT( pData && pLines );
+
+    ORA_SIZE  start = 0;
+    ORA_INT32 colon = -1;
+    ORA_SIZE  count = 0;
+    ORA_SIZE  i     = 0;
+
+    // 1. 64 bytes per block
+    for( ; i + 64 <= len; i += 64 )
+    {
+        ORA_UINT64 nlMask, colonMask;
+        ScanBlock64( pData + i, nlMask, colonMask );
+        if( !EmitLines( pData, i, nlMask, colonMask, start, colon, pLines, count, maxLines ) )
+            return count;
+    }
+
+    // 2. tail
+    ORA_UINT64 nlMask = 0, colonMask = 0;
+    for( ORA_SIZE j = i; j < len; j++ )
+    {
+        nlMask    |= static_cast< ORA_UINT64 >( pData[j] == '\n' ) << ( j - i );
+        colonMask |= static_cast< ORA_UINT64 >( pData[j] == ':' ) << ( j - i );
+    }
+    EmitLines( pData, i, nlMask, colonMask, start, colon, pLines, count, maxLines );
+    return count;
+}
+
+ORA_SIZE CSSDPUtils::ScanLinesScalar( const ORA_CHAR *pData, ORA_SIZE len, SSDP_LINE_T *pLines, ORA_SIZE maxLines )
+{
+    ORA_ASSERT( pData && pLines );
+
+    ORA_SIZE  start = 0;
+    ORA_INT32 colon = -1;
+    ORA_SIZE  count = 0;
+
+    for( ORA_SIZE i = 0; i < len; i++ )
+    {
+        if( pData[i] == ':' )
+        {
+            if( colon < 0 )
+                colon = i;
+        }
+        else if( pData[i] == '\n' && i >= 1 && i - 1 >= start && pData[i - 1] == '\r' )
+        {
+            // an empty line is passed over without being emitted
+            if( i - 1 > start )
+            {
+                if( count == maxLines )
+                    break;
+
+                pLines[count].Start = static_cast< ORA_UINT16 >( start );
+                pLines[count].End   = static_cast< ORA_UINT16 >( i - 2 );
+                pLines[count].Colon = static_cast< ORA_INT16 >( colon );
+                count++;
+            }
+
+            start = i + 1;
+            colon = -1;
+        }
+    }
+    return count;
+}
+
+const ORA_CHAR* CSSDPUtils::ScannerISA()
+{
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSE2__)
+    return "SSE2";
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+SSDPFieldID CSSDPUtils::LookupField( const ORA_CHAR *pName, ORA_SIZE len )
+{
+    if( pName == ORA_NULL || len == 0 )
+        return SF_UNKNOWN;
+
+    ORA_SIZE slot = FieldHash( pName, len );
+    const ORA_CHAR *pKnown = s_FieldTable[slot].Name;
+    if( pKnown == ORA_NULL || s_FieldTable[slot].Length != len )
+        return SF_UNKNOWN;
+
+    for( ORA_SIZE i = 0; i < len; i++ )
+    {
+        if( ToLower( pName[i] ) != static_cast< ORA_UINT8 >( pKnown[i] ) )
+            return SF_UNKNOWN;
+    }
+    return s_FieldTable[slot].ID;
+}
+
+ORA_VOID CSSDPUtils::BloomPositions( ORA_UINT32 seed, const ORA_CHAR *pKey, ORA_SIZE len, ORA_UINT32 bitCount, ORA_UINT32 *pPositions )
+{
+    ORA_ASSERT( pKey && pPositions && bitCount > 0 && ( bitCount & ( bitCount - 1 ) ) == 0 );
+
+    ORA_UINT32 h  = Hash( pKey, len ) ^ seed;
+    ORA_UINT32 h1 = Mix( h );
+    ORA_UINT32 h2 = Mix( h ^ 0x9E3779B9u ) | 1;   // odd, so the positions don't collapse
+    for( ORA_UINT32 i = 0; i < SSDP_BLOOM_HASHES; i++ )
+    {
+        pPositions[i] = ( h1 + i * h2 ) & ( bitCount - 1 );
+    }
+}
+// END: CSSDPUtils tokenizer
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// BEG: CSSDPUtils formatter
+ORA_VOID CSSDPUtils::FormatHttpDate( time_t t, ORA_CHAR *pBuf )
+{
+    ORA_ASSERT( pBuf );
+
+    // the day and month names are written out, so the width does not depend on the locale
+    static const ORA_CHAR *s_Days[]   = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    static const ORA_CHAR *s_Months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+    struct tm gmt;
+    gmtime_r( &t, &gmt );
+    snprintf( pBuf, SSDP_DATE_LEN + 1, "%s, %02d %s %04d %02d:%02d:%02d GMT",
+              s_Days[gmt.tm_wday], gmt.tm_mday, s_Months[gmt.tm_mon], gmt.tm_year + 1900,
+              gmt.tm_hour, gmt.tm_min, gmt.tm_sec );
+}
+// END: CSSDPUtils formatter
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// BEG: CSSDPUtils token filter
+ORA_BOOL CSSDPUtils::BuildTokenFilter( const ORA_CHAR *pNeedle, ORA_SIZE len, std::vector< struct sock_filter > &program )
+{
+    ORA_ASSERT( pNeedle );
+    program.clear();
+
+    // 1. split the needle into 4, 2 and 1 byte loads, a block must fit in the 8 bits jump offset
+    ORA_UINT32 chunks[128];
+    ORA_UINT32 chunkNum = 0;
+    for( ORA_SIZE pos = 0; pos < len && chunkNum < 128; )
+    {
+        ORA_UINT32 size = ( len - pos >= 4 ) ? 4 : ( len - pos >= 2 ) ? 2 : 1;
+        chunks[chunkNum++] = size;
+        pos += size;
+    }
+
+    // a block per offset: (load, compare) per chunk, then accept
+    ORA_SIZE blockLen = 2 * chunkNum + 1;
+    if( len == 0 || blockLen > 255 || blockLen * SSDP_FILTER_WINDOW + 1 > BPF_MAXINSNS )
+    {
+        return ORA_FALSE;
+    }
+    program.reserve( blockLen * SSDP_FILTER_WINDOW + 1 );
+
+    // 2. unroll the search, a mismatch jumps to the block of the next offset
+    for( ORA_UINT32 offset = 0; offset < SSDP_FILTER_WINDOW; offset++ )
+    {
+        ORA_SIZE pos = 0;
+        for( ORA_UINT32 c = 0; c < chunkNum; c++ )
+        {
+            ORA_UINT32 size  = chunks[c];
+            ORA_UINT32 value = 0;
+            for( ORA_UINT32 i = 0; i < size; i++ )
+            {
+                value = ( value << 8 ) | static_cast< ORA_UINT8 >( pNeedle[pos + i] );   // loads are big endian
+            }
+
+            ORA_UINT16 mode = ( size == 4 ) ? BPF_W : ( size == 2 ) ? BPF_H : BPF_B;
+            struct sock_filter load  = BPF_STMT( BPF_LD | mode | BPF_ABS, static_cast< ORA_UINT32 >( SSDP_UDP_HEADER_LEN + offset + pos ) );
+            struct sock_filter match = BPF_JUMP( BPF_JMP | BPF_JEQ | BPF_K, value, 0,
+                                                 static_cast< ORA_UINT8 >( 2 * ( chunkNum - c - 1 ) + 1 ) );
+            program.push_back( load );
+            program.push_back( match );
+            pos += size;
+        }
+
+        struct sock_filter accept = BPF_STMT( BPF_RET | BPF_K, 0xFFFFFFFF );
+        program.push_back( accept );
+    }
+
+    // 3. not found within the window
+    struct sock_filter drop = BPF_STMT( BPF_RET | BPF_K, 0 );
+    program.push_back( drop );
+    return ORA_TRUE;
+}
+
+ORA_BOOL CSSDPUtils::MatchTokenFilter( const ORA_CHAR *pData, ORA_SIZE dataLen, const ORA_CHAR *pNeedle, ORA_SIZE len )
+{
+    ORA_ASSERT( pData && pNeedle );
+
+    if( len == 0 )
+        return ORA_FALSE;
+
+    for( ORA_SIZE offset = 0; offset < SSDP_FILTER_WINDOW && offset + len <= dataLen; offset++ )
+    {
+        if( pData[offset] == pNeedle[0] && memcmp( pData + offset, pNeedle, len ) == 0 )
+            return ORA_TRUE;
+    }
+    return ORA_FALSE;
+}
+// END: CSSDPUtils token filter
+///////////////////////////////////////////////////////////////////////////////
@@ -8,6 +8,15 @@
 #ifndef __SSDPUTILS_H__
 #define __SSDPUTILS_H__
 
+#include <vector>
+#include <linux/filter.h>   // struct sock_filter
+
+#define SSDP_DATE_LEN    29   // RFC 1123 date, "Sun, 06 Nov 1994 08:49:37 GMT"
+#define SSDP_BLOOM_HASHES 3   // hash functions of the known-answer Bloom filter
+#define SSDP_FILTER_WINDOW  384 // payload bytes where the ST/NT token is searched by the socket filter,
+                                // ~2K instructions, a larger program hits the socket option memory limit
+#define SSDP_UDP_HEADER_LEN 8   // the socket filter sees the UDP header before the payload
+
 /** Global Variable **/
 static struct {
     const ORA_CHAR * MSEARCH;
@@ -36,6 +45,30 @@ static struct {
     .ADDR_MULTICAST = "239.255.255.250",
 };
 
+/** Enum: SSDP header fields known by the parser **/
+enum SSDPFieldID
+{
+    SF_UNKNOWN = -1,
+    SF_ST,
+    SF_NT,
+    SF_USN,
+    SF_LOCATION,
+    SF_SM_ID,
+    SF_DEV_TYPE,
+    SF_MX,
+    SF_KNOWN,     // X-KNOWN, known-answer digest of M-SEARCH
+
+    SF_FIELD_COUNT
+};
+
+/** Struct: one CRLF terminated line located by the tokenizer **/
+typedef struct SSDP_LINE
+{
+    ORA_UINT16  Start;  // first byte of the line
+    ORA_UINT16  End;    // last byte of the line, CRLF excluded
+    ORA_INT16   Colon;  // first ':' of the line, -1 if there is none
+}SSDP_LINE_T;
+
 class CSSDPUtils
 {
 public:
@@ -56,12 +89,113 @@ public:
     }
 
 public:
-    string BuildSSDPSearchString();
     string GetUserId();
-    string BuildSSDPAliveString();
-    string BuildSSDPByebyeString();
     string ParseIP();
 
+    /**
+     * @brief format a time as the RFC 1123 date of HTTP DATE, always SSDP_DATE_LEN characters
+     *
+     * @param t     time to format
+     * @param pBuf  buffer of SSDP_DATE_LEN + 1 bytes, NUL terminated on return
+     */
+    static ORA_VOID FormatHttpDate( time_t t, ORA_CHAR *pBuf );
+
+// Tokenizer
+public:
+    /**
+     * @brief find every CRLF line and the first colon of each line in one pass.
+     * the lines are located with SSE2/AVX2 on x86, NEON on AArch64, or a scalar loop.
+     * empty lines are skipped, and a bare LF does not end a line.
+     *
+     * @param pData     packet data
+     * @param len       packet length, must not exceed SSDP_BUFFER_LEN
+     * @param pLines    array to receive the lines
+     * @param maxLines  capacity of pLines
+     *
+     * @return the number of lines written to pLines
+     */
+    static ORA_SIZE ScanLines( const ORA_CHAR *pData, ORA_SIZE len, SSDP_LINE_T *pLines, ORA_SIZE maxLines );
+
+    /**
+     * @brief the scalar reference of ScanLines, always available.
+     */
+    static ORA_SIZE ScanLinesScalar( const ORA_CHAR *pData, ORA_SIZE len, SSDP_LINE_T *pLines, ORA_SIZE maxLines );
+
+    /**
+     * @brief name of the instruction set used by ScanLines
+     */
+    static const ORA_CHAR* ScannerISA();
+
+    /**
+     * @brief case-insensitive lookup of a header name in the known SSDP fields,
+     * by a precomputed perfect hash and a single compare.
+     *
+     * @param pName  header name, not NUL terminated
+     * @param len    header name length
+     *
+     * @return SSDPFieldID of the header, SF_UNKNOWN if it is not a known field
+     */
+    static SSDPFieldID LookupField( const ORA_CHAR *pName, ORA_SIZE len );
+
+    /**
+     * @brief FNV-1a hash of a byte string, used to index the neighbor table
+     *
+     * @param pData  data to hash, not NUL terminated
+     * @param len    data length
+     *
+     * @return 32 bits hash value
+     */
+    static inline ORA_UINT32 Hash( const ORA_CHAR *pData, ORA_SIZE len )
+    {
+        ORA_UINT32 hash = 2166136261u;
+        for( ORA_SIZE i = 0; i < len; i++ )
+        {
+            hash ^= static_cast< ORA_UINT8 >( pData[i] );
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief bit positions of a key in a Bloom filter, SSDP_BLOOM_HASHES hash functions
+     * are derived from one seeded hash by double hashing.
+     *
+     * @param seed       per filter seed, so false positives don't repeat across filters
+     * @param pKey       key, not NUL terminated
+     * @param len        key length
+     * @param bitCount   filter size in bits, must be power of 2
+     * @param pPositions array of SSDP_BLOOM_HASHES positions to receive the result
+     */
+    static ORA_VOID BloomPositions( ORA_UINT32 seed, const ORA_CHAR *pKey, ORA_SIZE len, ORA_UINT32 bitCount, ORA_UINT32 *pPositions );
+
+// Token Filter
+public:
+    /**
+     * @brief build a classic BPF program for SO_ATTACH_FILTER which accepts a UDP datagram only if
+     * the needle starts within the first SSDP_FILTER_WINDOW bytes of the payload.
+     * cBPF has no loops, so the search is unrolled: per payload offset the needle is compared
+     * in 4, 2 and 1 byte loads, and a load beyond the datagram ends the search with a drop.
+     *
+     * @param pNeedle  needle, not NUL terminated
+     * @param len      needle length
+     * @param program  receives the program
+     *
+     * @return ORA_FALSE if the unrolled program exceeds BPF_MAXINSNS
+     */
+    static ORA_BOOL BuildTokenFilter( const ORA_CHAR *pNeedle, ORA_SIZE len, std::vector< struct sock_filter > &program );
+
+    /**
+     * @brief the userspace equivalent of the BuildTokenFilter program
+     *
+     * @param pData    UDP payload
+     * @param dataLen  payload length
+     * @param pNeedle  needle, not NUL terminated
+     * @param len      needle length
+     *
+     * @return ORA_TRUE if the datagram is accepted
+     */
+    static ORA_BOOL MatchTokenFilter( const ORA_CHAR *pData, ORA_SIZE dataLen, const ORA_CHAR *pNeedle, ORA_SIZE len );
+
 public:
     string ADDRESS = "239.255.255.250";
     ORA_INT32 MaxReplyTime = 5;
@@ -0,0 +1,197 @@
+#include "Base.h"
+#include "Network.h"
+#include "RoleEventCodec.h"
+
+#include <getopt.h>
+#include <time.h>
+
+#define CODEC_DEFAULT_ITERATIONS    1000000
+#define CODEC_TERM                  7           ///< stamped on the events, a varint of one byte
+#define CODEC_SENDER                0x0A0B0C0D
+#define CODEC_BUFFER_SIZE           512
+
+/* Struct : CODEC_CASE, a role event of each type, as the role states build them */
+typedef struct CODEC_CASE
+{
+    const ORA_CHAR   *pName;
+    const ROLE_EVENT *pEvent;
+}CODEC_CASE_T;
+
+/* Struct : CODEC_RESULT, the metrics of an event type */
+typedef struct CODEC_RESULT
+{
+    ORA_SIZE    StructBytes;    // the event as its struct, what went on the wire before
+    ORA_SIZE    WireBytes;      // the event encoded
+    double      EncodeNs;       // per event
+    double      DecodeNs;       // per event
+}CODEC_RESULT_T;
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: Assistants
+static ORA_VOID Usage( const ORA_CHAR *pName )
+{
+    printf( "usage: %s [options] > results.jsonl\n"
+            "  -i iterations    encodes and decodes timed per event type (%u)\n"
+            "every event type is round-tripped first, a mismatch exits 1.\n"
+            "the results are written to stdout as one JSON object per event type, the summary to stderr.\n",
+            pName, CODEC_DEFAULT_ITERATIONS );
+}
+
+static ORA_UINT64 GetNs()
+{
+    timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return static_cast< ORA_UINT64 >( now.tv_sec ) * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * @brief encode and decode the event, the decoded one must equal it with the term stamped
+ *
+ * @return ORA_TRUE if it round-trips
+ */
+static ORA_BOOL RoundTrip( const ROLE_EVENT &event )
+{
+    ORA_UINT8 wire[CODEC_BUFFER_SIZE];
+    ORA_UINT8 decoded[CODEC_BUFFER_SIZE];
+
+    ORA_SIZE size = CRoleEventCodec::Encode( event, CODEC_TERM, wire, sizeof( wire ) );
+    if( size == 0 || CRoleEventCodec::PacketSize( wire ) != size )
+        return ORA_FALSE;
+
+    // 1. a truncated event is refused
+    if( CRoleEventCodec::Decode( wire, size - 1, decoded, sizeof( decoded ) ) != 0 )
+        return ORA_FALSE;
+
+    // 2. the whole one comes back
+    if( CRoleEventCodec::Decode( wire, size, decoded, sizeof( decoded ) ) != size )
+        return ORA_FALSE;
+
+    const ROLE_EVENT *pDecoded = reinterpret_cast< const ROLE_EVENT* >( decoded );
+    return pDecoded->IsValid() &&
+           pDecoded->GetEventID()   == event.GetEventID() &&
+           pDecoded->GetSender()    == event.GetSender() &&
+           pDecoded->GetEventType() == event.GetEventType() &&
+           pDecoded->GetTerm()      == CODEC_TERM &&
+           pDecoded->GetDataSize()  == event.GetDataSize() &&
+           memcmp( decoded + sizeof( ROLE_EVENT ),
+                   reinterpret_cast< const ORA_UINT8* >( &event ) + sizeof( ROLE_EVENT ), event.GetDataSize() ) == 0;
+}
+
+static ORA_VOID Measure( const ROLE_EVENT &event, ORA_UINT32 iterations, CODEC_RESULT_T &result )
+{
+    ORA_UINT8  wire[CODEC_BUFFER_SIZE];
+    ORA_UINT8  decoded[CODEC_BUFFER_SIZE];
+    ORA_SIZE   sink = 0;
+
+    result.StructBytes = sizeof( ROLE_EVENT ) + event.GetDataSize();
+    result.WireBytes   = CRoleEventCodec::Encode( event, CODEC_TERM, wire, sizeof( wire ) );
+
+    // the results are summed, so the loops are not optimized away
+    ORA_UINT64 begin = GetNs();
+    for( ORA_UINT32 i = 0; i < iterations; i++ )
+        sink += CRoleEventCodec::Encode( event, i, wire, sizeof( wire ) );
+    result.EncodeNs = static_cast< double >( GetNs() - begin ) / iterations;
+
+    // the top byte of the decoded data size is 0, xor-ing it in keeps every decode in the loop
+    CRoleEventCodec::Encode( event, CODEC_TERM, wire, sizeof( wire ) );
+    begin = GetNs();
+    for( ORA_UINT32 i = 0; i < iterations; i++ )
+    {
+        sink += CRoleEventCodec::Decode( wire, result.WireBytes, decoded, sizeof( decoded ) );
+        wire[result.WireBytes - 1] ^= decoded[sizeof( ROLE_EVENT ) - 1];
+    }
+    result.DecodeNs = static_cast< double >( GetNs() - begin ) / iterations;
+
+    if( sink == 0 )
+        fprintf( stderr, "nothing was encoded\n" );
+}
+// END: Assistants
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: Program Entrance
+ORA_INT32 main( ORA_INT32 argc, ORA_CHAR *argv[] )
+{
+    ORA_UINT32 iterations = CODEC_DEFAULT_ITERATIONS;
+
+    ORA_INT32 opt;
+    while( ( opt = getopt( argc, argv, "i:h" ) ) != -1 )
+    {
+        switch( opt )
+        {
+        case 'i': iterations = strtoul( optarg, ORA_NULL, 10 ); break;
+
+        default:
+            Usage( argv[0] );
+            return opt == 'h' ? 0 : -1;
+        }
+    }
+
+    if( iterations < 1 )
+    {
+        Usage( argv[0] );
+        return -1;
+    }
+
+    // 1. an event of every type in RSEvent.h
+    MASTER_INFO info( CODEC_SENDER, "192.168.100.100" );
+    DEVICE_ID_T successors[ROLE_SUCCESSOR_COUNT] = { 0x0A0B0C0E, 0x0A0B0C0F, 0x0A0B0C10 };
+
+    REVENT_QUERY_MASTER_INFO   queryMaster( CODEC_SENDER );
+    REVENT_MASTER_DETECTED     masterDetected( CODEC_SENDER, info );
+    REVENT_SET_MASTER_INFO     setMaster( CODEC_SENDER );
+    REVENT_FETACH_AP_RSSI      fetchRssi( CODEC_SENDER );
+    REVENT_FETACH_AP_RSSI_RESP fetchRssiResp( CODEC_SENDER, -57 );
+    REVENT_DEFINER_DETECTED    definerDetected( CODEC_SENDER );
+    REVENT_MASTER_HEARTBEAT    heartbeat( CODEC_SENDER, info, 1234, successors, ROLE_SUCCESSOR_COUNT );
+    REVENT_SLAVE_ALIVE         slaveAlive( CODEC_SENDER, 1234 );
+    REVENT_BUNDLE              bundle( CODEC_SENDER, ET_BROADCAST, 0 );
+    REVENT_TIMEOUT             timeout;
+
+    const CODEC_CASE_T cases[] =
+    {
+        { "query_master_info",  &queryMaster },
+        { "master_detected",    &masterDetected },
+        { "set_master_info",    &setMaster },
+        { "fetch_ap_rssi",      &fetchRssi },
+        { "fetch_ap_rssi_resp", &fetchRssiResp },
+        { "definer_detected",   &definerDetected },
+        { "master_heartbeat",   &heartbeat },
+        { "slave_alive",        &slaveAlive },
+        { "event_bundle",       &bundle },
+        { "timer_timeout",      &timeout },
+    };
+
+    // 2. they all round-trip before anything is timed
+    ORA_UINT32 failures = 0;
+    for( ORA_UINT32 i = 0; i < ORA_COUNT_OF( cases ); i++ )
+    {
+        if( !RoundTrip( *cases[i].pEvent ) )
+        {
+            fprintf( stderr, "ROUND TRIP FAILED %s\n", cases[i].pName );
+            failures++;
+        }
+    }
+
+    if( failures )
+        return 1;
+
+    // 3. the bytes on the wire and the time
+    for( ORA_UINT32 i = 0; i < ORA_COUNT_OF( cases ); i++ )
+    {
+        CODEC_RESULT_T result;
+        Measure( *cases[i].pEvent, iterations, result );
+
+        printf( "{\"event\":\"%s\",\"struct_bytes\":%u,\"wire_bytes\":%u,\"encode_ns\":%.1f,\"decode_ns\":%.1f}\n",
+                cases[i].pName, static_cast< ORA_UINT32 >( result.StructBytes ), static_cast< ORA_UINT32 >( result.WireBytes ),
+                result.EncodeNs, result.DecodeNs );
+        fprintf( stderr, "%-20s %4u -> %4u bytes, encode %6.1f ns, decode %6.1f ns\n",
+                 cases[i].pName, static_cast< ORA_UINT32 >( result.StructBytes ), static_cast< ORA_UINT32 >( result.WireBytes ),
+                 result.EncodeNs, result.DecodeNs );
+    }
+    fflush( stdout );
+    return 0;
+}
+// END: Program Entrance
+//////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,763 @@
+#include "Base.h"
+#include "Network.h"
+
+#include <ctype.h>
+#include <getopt.h>
+#include <time.h>
+#include <queue>
+#include <sys/time.h>
+#include <sys/socket.h> // struct mmsghdr, CMSG_SPACE, used by SSDPService.h
+#include <netinet/in.h> // struct sockaddr_in
+#include "SSDPUtils.h"
+#include "SSDPNeighbor.h"
+#include "SSDPService.h"
+
+#define SSDP_BENCH_DEFAULT_ITERATIONS   1000000
+#define SSDP_BENCH_AGING_NODES          20      // the devices on the simulated mesh
+#define SSDP_BENCH_AGING_HOURS          4       // simulated time per case
+#define SSDP_BENCH_AGING_SEED           12345
+
+/* Recorded datagrams, as the daemons on the mesh send them */
+static const ORA_CHAR s_Notify[] =
+    "NOTIFY * HTTP/1.1\r\n"
+    "HOST:239.255.255.250:1900\r\n"
+    "CACHE-CONTROL:max-age=120\r\n"
+    "LOCATION:http://192.168.100.23:8080/description.xml\r\n"
+    "SERVER:OS/version product/version\r\n"
+    "NT:urn:harman-com:device:fastsetup:1\r\n"
+    "NTS:ssdp:alive\r\n"
+    "USN:uuid:4d696e69-0000-1000-8000-0050c2a1b2c3\r\n"
+    "SM_ID:168453133\r\n"
+    "DEV_TYPE:speaker\r\n"
+    "\r\n";
+
+static const ORA_CHAR s_Response[] =
+    "HTTP/1.1 200 OK\r\n"
+    "CACHE-CONTROL:max-age=120\r\n"
+    "DATE:Sat, 17 Oct 2026 08:49:37 GMT\r\n"
+    "EXT:\r\n"
+    "LOCATION:http://192.168.100.24:8080/description.xml\r\n"
+    "SERVER:OS/version product/version\r\n"
+    "ST:urn:harman-com:device:fastsetup:1\r\n"
+    "USN:uuid:4d696e69-0000-1000-8000-0050c2a1b2c4\r\n"
+    "SM_ID:168453134\r\n"
+    "DEV_TYPE:soundbar\r\n"
+    "\r\n";
+
+static const ORA_CHAR s_Msearch[] =
+    "M-SEARCH * HTTP/1.1\r\n"
+    "HOST:239.255.255.250:1900\r\n"
+    "MAN:\"ssdp:discover\"\r\n"
+    "MX:1\r\n"
+    "ST:urn:harman-com:device:fastsetup:1\r\n"
+    "USER-AGENT:OS/version product/version\r\n"
+    "X-KNOWN:5eed1234-00a0040001100200000800400000100200010040\r\n"
+    "\r\n";
+
+/* a field line behind an empty line, it must start right after the empty line */
+static const ORA_CHAR s_BlankLine[] =
+    "NOTIFY * HTTP/1.1\r\n"
+    "NT:urn:harman-com:device:fastsetup:1\r\n"
+    "\r\n"
+    "USN:uuid:4d696e69-0000-1000-8000-0050c2a1b2c3\r\n";
+
+/* the header fields of the recorded NOTIFY, the messages of the build bench announce them */
+#define SSDP_BENCH_PORT         1900
+#define SSDP_BENCH_LOCATION     "http://", "192.168.100.23", ":8080/description.xml"
+#define SSDP_BENCH_TARGET       "urn:harman-com:device:fastsetup:1"
+#define SSDP_BENCH_USN          "uuid:4d696e69-0000-1000-8000-0050c2a1b2c3"
+#define SSDP_BENCH_SM_ID        "168453133"
+#define SSDP_BENCH_DEV_TYPE     "speaker"
+
+/* Struct : SSDP_BENCH_CASE, a recorded datagram */
+typedef struct SSDP_BENCH_CASE
+{
+    const ORA_CHAR *pName;
+    const ORA_CHAR *pData;
+    ORA_SIZE        Length;
+}SSDP_BENCH_CASE_T;
+
+/* Struct : LEGACY_PACKET, the packet the parser filled before the views, every field a copy */
+typedef struct LEGACY_PACKET
+{
+    string      Method;
+    string      St;
+    string      Usn;
+    string      Location;
+    string      SmId;
+    string      DeviceType;
+    ORA_INT64   UpdateTime;
+}LEGACY_PACKET_T;
+
+/* Struct : BENCH_TEMPLATE, a prebuilt message as CSSDPService keeps it */
+typedef struct BENCH_TEMPLATE
+{
+    ORA_CHAR    Data[SSDP_BUFFER_LEN];
+    ORA_SIZE    Length;
+    ORA_INT32   DateOffset;     // -1 if there is no DATE
+}BENCH_TEMPLATE_T;
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: Message Builders
+// the messages as they were built before the templates: formatted in full on every send
+static ORA_INT32 LegacyBuildNotify( ORA_CHAR *pBuf, ORA_SIZE bufLen )
+{
+    return snprintf( pBuf, bufLen,
+        "%s"
+        "HOST:%s:%d\r\n"
+        "CACHE-CONTROL:max-age=120\r\n"
+        "LOCATION:%s%s%s\r\n"
+        "SERVER:OS/version product/version\r\n"
+        "NT:%s\r\n"
+        "NTS:ssdp:alive\r\n"
+        "USN:%s\r\n"
+        "SM_ID:%s\r\n"
+        "DEV_TYPE:%s\r\n"
+        "\r\n",
+        Global.HEADER_NOTIFY, Global.ADDR_MULTICAST, SSDP_BENCH_PORT, SSDP_BENCH_LOCATION,
+        SSDP_BENCH_TARGET, SSDP_BENCH_USN, SSDP_BENCH_SM_ID, SSDP_BENCH_DEV_TYPE );
+}
+
+static ORA_INT32 LegacyBuildResponse( ORA_CHAR *pBuf, ORA_SIZE bufLen, const ORA_CHAR *pDate )
+{
+    return snprintf( pBuf, bufLen,
+        "%s"
+        "CACHE-CONTROL:max-age=120\r\n"
+        "DATE:%s\r\n"
+        "EXT:\r\n"
+        "LOCATION:%s%s%s\r\n"
+        "SERVER:OS/version product/version\r\n"
+        "ST:%s\r\n"
+        "USN:%s\r\n"
+        "SM_ID:%s\r\n"
+        "DEV_TYPE:%s\r\n"
+        "\r\n",
+        Global.HEADER_RESPONSE, pDate, SSDP_BENCH_LOCATION,
+        SSDP_BENCH_TARGET, SSDP_BENCH_USN, SSDP_BENCH_SM_ID, SSDP_BENCH_DEV_TYPE );
+}
+
+// the templates, built once as CSSDPService::BuildLinkMessages does: the DATE value is reserved
+static ORA_VOID BuildTemplates( BENCH_TEMPLATE_T &notify, BENCH_TEMPLATE_T &response )
+{
+    notify.Length     = LegacyBuildNotify( notify.Data, sizeof( notify.Data ) );
+    notify.DateOffset = -1;
+
+    ORA_CHAR reserved[SSDP_DATE_LEN + 1];
+    memset( reserved, ' ', SSDP_DATE_LEN );
+    reserved[SSDP_DATE_LEN] = '\0';
+    response.Length     = LegacyBuildResponse( response.Data, sizeof( response.Data ), reserved );
+    response.DateOffset = strlen( Global.HEADER_RESPONSE ) + strlen( "CACHE-CONTROL:max-age=120\r\nDATE:" );
+}
+
+// what is left to do per send, as CSSDPService::PatchDate does: DATE is formatted once per second
+static ORA_VOID PatchDate( BENCH_TEMPLATE_T &msg, time_t &dateTime, ORA_CHAR *pDateValue )
+{
+    if( msg.DateOffset < 0 )
+        return;
+
+    time_t now = time( ORA_NULL );
+    if( now != dateTime )
+    {
+        CSSDPUtils::FormatHttpDate( now, pDateValue );
+        dateTime = now;
+    }
+    memcpy( msg.Data + msg.DateOffset, pDateValue, SSDP_DATE_LEN );
+}
+// END: Message Builders
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: Legacy Parser
+// the parser as it was: strlen over the datagram, a colon search and isprint/isspace trims per line,
+// a strncasecmp per known field name, and a string copy per field
+static ORA_INT32 LegacyTrimSpaces( const ORA_CHAR *pData, ORA_SIZE *pStart, ORA_SIZE *pEnd )
+{
+    ORA_INT32 i = *pStart;
+    ORA_INT32 j = *pEnd;
+
+    while( i <= (ORA_INT32)*pEnd   && ( !isprint(pData[i]) || isspace(pData[i]) ) ) i++;
+    while( j >= (ORA_INT32)*pStart && ( !isprint(pData[j]) || isspace(pData[j]) ) ) j--;
+
+    if( i > j )
+        return -1;
+
+    *pStart = i;
+    *pEnd   = j;
+    return 0;
+}
+
+static ORA_INT32 LegacyParseFieldLine( const ORA_CHAR *pData, ORA_SIZE start, ORA_SIZE end, LEGACY_PACKET_T *pPacket )
+{
+    if( pData[start] == ':' )
+        return -1;
+
+    ORA_INT32 colon = -1;
+    for( ORA_SIZE i = start + 1; i <= end; i++ )
+    {
+        if( pData[i] == ':' )
+        {
+            colon = i;
+            break;
+        }
+    }
+    if( colon == -1 || (ORA_SIZE)colon == end )
+        return -1;
+
+    ORA_SIZE i = start;
+    ORA_SIZE j = colon - 1;
+    if( LegacyTrimSpaces( pData, &i, &j ) == -1 )
+        return -1;
+    const ORA_CHAR *pField  = &pData[i];
+    ORA_SIZE        fieldLen = j - i + 1;
+
+    i = colon + 1;
+    j = end;
+    if( LegacyTrimSpaces( pData, &i, &j ) == -1 )
+        return -1;
+    const ORA_CHAR *pValue  = &pData[i];
+    ORA_SIZE        valueLen = j - i + 1;
+
+    if( fieldLen == strlen("st") && strncasecmp( pField, "st", fieldLen ) == 0 )
+        pPacket->St.assign( pValue, valueLen < SSDP_FIELD_LEN ? valueLen : SSDP_FIELD_LEN - 1 );
+    else if( fieldLen == strlen("nt") && strncasecmp( pField, "nt", fieldLen ) == 0 )
+        pPacket->St.assign( pValue, valueLen < SSDP_FIELD_LEN ? valueLen : SSDP_FIELD_LEN - 1 );
+    else if( fieldLen == strlen("usn") && strncasecmp( pField, "usn", fieldLen ) == 0 )
+        pPacket->Usn.assign( pValue, valueLen < SSDP_FIELD_LEN ? valueLen : SSDP_FIELD_LEN - 1 );
+    else if( fieldLen == strlen("location") && strncasecmp( pField, "location", fieldLen ) == 0 )
+        pPacket->Location.assign( pValue, valueLen < SSDP_LOCATION_LEN ? valueLen : SSDP_LOCATION_LEN - 1 );
+    else if( fieldLen == strlen("sm_id") && strncasecmp( pField, "sm_id", fieldLen ) == 0 )
+        pPacket->SmId.assign( pValue, valueLen < SSDP_FIELD_LEN ? valueLen : SSDP_FIELD_LEN - 1 );
+    else if( fieldLen == strlen("dev_type") && strncasecmp( pField, "dev_type", fieldLen ) == 0 )
+        pPacket->DeviceType.assign( pValue, valueLen < SSDP_FIELD_LEN ? valueLen : SSDP_FIELD_LEN - 1 );
+
+    return 0;
+}
+
+static ORA_INT32 LegacyPacketParser( const ORA_CHAR *pData, ORA_SIZE dataLen, LEGACY_PACKET_T *pPacket )
+{
+    if( dataLen != strlen( pData ) )
+        return -1;
+
+    // 1. the method, copied
+    ORA_SIZE i;
+    if( ( i = strlen( Global.HEADER_MSEARCH ) ) < dataLen && memcmp( pData, Global.HEADER_MSEARCH, i ) == 0 )
+        pPacket->Method = Global.MSEARCH;
+    else if( ( i = strlen( Global.HEADER_NOTIFY ) ) < dataLen && memcmp( pData, Global.HEADER_NOTIFY, i ) == 0 )
+        pPacket->Method = Global.NOTIFY;
+    else if( ( i = strlen( Global.HEADER_RESPONSE ) ) < dataLen && memcmp( pData, Global.HEADER_RESPONSE, i ) == 0 )
+        pPacket->Method = Global.RESPONSE;
+    else
+        return -1;
+
+    // 2. each field line
+    ORA_SIZE start = i;
+    for( i = start; i < dataLen; i++ )
+    {
+        if( pData[i] == '\n' && i - 1 > start && pData[i - 1] == '\r' )
+        {
+            LegacyParseFieldLine( pData, start, i - 2, pPacket );
+            start = i + 1;
+        }
+    }
+
+    struct timeval now = {};
+    gettimeofday( &now, ORA_NULL );
+    pPacket->UpdateTime = (ORA_INT64)now.tv_sec * 1000 + now.tv_usec / 1000;
+    return 0;
+}
+// END: Legacy Parser
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: Assistants
+static ORA_VOID Usage( const ORA_CHAR *pName )
+{
+    printf( "usage: %s [options] > results.jsonl\n"
+            "  -i iterations    runs timed per datagram and path (%u)\n"
+            "  -b name          run one bench only: parser, scan, build, aging\n"
+            "parser: the views parser against the legacy copying one, they must read the same fields first.\n"
+            "scan:   the line scanner of the instruction set built for against the scalar one, they must\n"
+            "        find the same lines first. build with ISA_FLAGS=-mavx2 etc. for the other sets.\n"
+            "build:  the messages sent per second from the prebuilt templates against formatting them\n"
+            "        per send, they must be the same bytes first.\n"
+            "aging:  the live neighbors timed out under the known-answer suppression, with and without\n"
+            "        the refresh by the requester's M-SEARCH, on a simulated mesh with datagram loss.\n"
+            "a mismatch exits 1.\n"
+            "the results are written to stdout as one JSON object per datagram, the summary to stderr.\n",
+            pName, SSDP_BENCH_DEFAULT_ITERATIONS );
+}
+
+static ORA_UINT64 GetNs()
+{
+    timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return static_cast< ORA_UINT64 >( now.tv_sec ) * 1000000000 + now.tv_nsec;
+}
+
+static ORA_BOOL ViewEquals( const ORA_CHAR *pData, CSSDPService::SSDP_FIELD_VIEW_T view, const string &value )
+{
+    return view.Length == value.size() && memcmp( pData + view.Offset, value.data(), view.Length ) == 0;
+}
+
+/**
+ * @brief parse the datagram with both parsers, they must read the same fields
+ *
+ * @return ORA_TRUE if they agree
+ */
+static ORA_BOOL CrossCheck( const SSDP_BENCH_CASE_T &bench )
+{
+    CSSDPService::SSDP_PACKET_VIEW_T view;
+    LEGACY_PACKET_T                  legacy;
+
+    if( CSSDPService::PacketParser( bench.pData, bench.Length, &view ) != 0 ||
+        LegacyPacketParser( bench.pData, bench.Length, &legacy ) != 0 )
+        return ORA_FALSE;
+
+    return ViewEquals( bench.pData, view.St,         legacy.St ) &&
+           ViewEquals( bench.pData, view.Usn,        legacy.Usn ) &&
+           ViewEquals( bench.pData, view.Location,   legacy.Location ) &&
+           ViewEquals( bench.pData, view.SmId,       legacy.SmId ) &&
+           ViewEquals( bench.pData, view.DeviceType, legacy.DeviceType );
+}
+
+static double MeasureViews( const SSDP_BENCH_CASE_T &bench, ORA_UINT32 iterations )
+{
+    CSSDPService::SSDP_PACKET_VIEW_T view;
+    ORA_SIZE sink = 0;
+
+    // the field lengths are summed, so the loop is not optimized away
+    ORA_UINT64 begin = GetNs();
+    for( ORA_UINT32 i = 0; i < iterations; i++ )
+    {
+        CSSDPService::PacketParser( bench.pData, bench.Length, &view );
+        sink += view.St.Length + view.Usn.Length;
+    }
+    double ns = static_cast< double >( GetNs() - begin ) / iterations;
+
+    if( sink == 0 )
+        fprintf( stderr, "nothing was parsed\n" );
+    return ns;
+}
+
+static double MeasureLegacy( const SSDP_BENCH_CASE_T &bench, ORA_UINT32 iterations )
+{
+    ORA_SIZE sink = 0;
+
+    // a packet per datagram, as the receive path declared it
+    ORA_UINT64 begin = GetNs();
+    for( ORA_UINT32 i = 0; i < iterations; i++ )
+    {
+        LEGACY_PACKET_T legacy;
+        LegacyPacketParser( bench.pData, bench.Length, &legacy );
+        sink += legacy.St.size() + legacy.Usn.size();
+    }
+    double ns = static_cast< double >( GetNs() - begin ) / iterations;
+
+    if( sink == 0 )
+        fprintf( stderr, "nothing was parsed\n" );
+    return ns;
+}
+/**
+ * @brief scan the datagram with the vector and the scalar scanner, they must find the same lines
+ *
+ * @return ORA_TRUE if they agree
+ */
+static ORA_BOOL ScanCheck( const ORA_CHAR *pData, ORA_SIZE length )
+{
+    SSDP_LINE_T vector[SSDP_MAX_LINES];
+    SSDP_LINE_T scalar[SSDP_MAX_LINES];
+
+    ORA_SIZE count = CSSDPUtils::ScanLines( pData, length, vector, SSDP_MAX_LINES );
+    if( CSSDPUtils::ScanLinesScalar( pData, length, scalar, SSDP_MAX_LINES ) != count )
+        return ORA_FALSE;
+
+    for( ORA_SIZE i = 0; i < count; i++ )
+    {
+        if( vector[i].Start != scalar[i].Start || vector[i].End != scalar[i].End || vector[i].Colon != scalar[i].Colon )
+            return ORA_FALSE;
+    }
+    return ORA_TRUE;
+}
+
+/**
+ * @brief time a scanner on the datagram
+ *
+ * @return header lines per second
+ */
+static double MeasureScan( ORA_SIZE (*pScan)( const ORA_CHAR*, ORA_SIZE, SSDP_LINE_T*, ORA_SIZE ),
+                           const SSDP_BENCH_CASE_T &bench, ORA_UINT32 iterations )
+{
+    SSDP_LINE_T lines[SSDP_MAX_LINES];
+    ORA_SIZE    sink = 0;
+
+    // the line counts are summed, so the loop is not optimized away
+    ORA_UINT64 begin = GetNs();
+    for( ORA_UINT32 i = 0; i < iterations; i++ )
+        sink += pScan( bench.pData, bench.Length, lines, SSDP_MAX_LINES );
+    ORA_UINT64 ns = GetNs() - begin;
+
+    return ns > 0 ? static_cast< double >( sink ) * 1000000000 / ns : 0;
+}
+
+static ORA_BOOL RunParser( const SSDP_BENCH_CASE_T *pCases, ORA_UINT32 count, ORA_UINT32 iterations )
+{
+    // 1. both parsers read the same fields before anything is timed
+    ORA_UINT32 failures = 0;
+    for( ORA_UINT32 i = 0; i < count; i++ )
+    {
+        if( !CrossCheck( pCases[i] ) )
+        {
+            fprintf( stderr, "PARSERS DISAGREE %s\n", pCases[i].pName );
+            failures++;
+        }
+    }
+
+    if( failures )
+        return ORA_FALSE;
+
+    // 2. the time per datagram
+    for( ORA_UINT32 i = 0; i < count; i++ )
+    {
+        double legacyNs = MeasureLegacy( pCases[i], iterations );
+        double viewsNs  = MeasureViews( pCases[i], iterations );
+
+        printf( "{\"bench\":\"parser\",\"packet\":\"%s\",\"bytes\":%u,\"legacy_ns\":%.1f,\"views_ns\":%.1f,\"speedup\":%.2f}\n",
+                pCases[i].pName, static_cast< ORA_UINT32 >( pCases[i].Length ), legacyNs, viewsNs, legacyNs / viewsNs );
+        fprintf( stderr, "parser %-10s %4u bytes, legacy %7.1f ns, views %7.1f ns, x%.2f\n",
+                 pCases[i].pName, static_cast< ORA_UINT32 >( pCases[i].Length ), legacyNs, viewsNs, legacyNs / viewsNs );
+    }
+    return ORA_TRUE;
+}
+
+static ORA_BOOL RunScan( const SSDP_BENCH_CASE_T *pCases, ORA_UINT32 count, ORA_UINT32 iterations )
+{
+    // 1. both scanners find the same lines, an empty line is passed over
+    ORA_UINT32 failures = 0;
+    for( ORA_UINT32 i = 0; i < count; i++ )
+    {
+        if( !ScanCheck( pCases[i].pData, pCases[i].Length ) )
+        {
+            fprintf( stderr, "SCANNERS DISAGREE %s\n", pCases[i].pName );
+            failures++;
+        }
+    }
+
+    SSDP_LINE_T lines[SSDP_MAX_LINES];
+    ORA_SIZE    blankLen = sizeof( s_BlankLine ) - 1;
+    if( !ScanCheck( s_BlankLine, blankLen ) ||
+        CSSDPUtils::ScanLines( s_BlankLine, blankLen, lines, SSDP_MAX_LINES ) != 3 ||
+        memcmp( s_BlankLine + lines[2].Start, "USN:", 4 ) != 0 )
+    {
+        fprintf( stderr, "SCANNERS KEEP THE EMPTY LINE\n" );
+        failures++;
+    }
+
+    if( failures )
+        return ORA_FALSE;
+
+    // 2. header lines per second of each path
+    for( ORA_UINT32 i = 0; i < count; i++ )
+    {
+        double isaRate    = MeasureScan( CSSDPUtils::ScanLines, pCases[i], iterations );
+        double scalarRate = MeasureScan( CSSDPUtils::ScanLinesScalar, pCases[i], iterations );
+
+        printf( "{\"bench\":\"scan\",\"packet\":\"%s\",\"isa\":\"%s\",\"isa_headers_per_s\":%.0f,\"scalar_headers_per_s\":%.0f,\"speedup\":%.2f}\n",
+                pCases[i].pName, CSSDPUtils::ScannerISA(), isaRate, scalarRate, isaRate / scalarRate );
+        fprintf( stderr, "scan   %-10s %-6s %6.1f M headers/s, scalar %6.1f M headers/s, x%.2f\n",
+                 pCases[i].pName, CSSDPUtils::ScannerISA(), isaRate / 1000000, scalarRate / 1000000, isaRate / scalarRate );
+    }
+    return ORA_TRUE;
+}
+/**
+ * @brief the patched templates must be the messages formatted in full
+ *
+ * @return ORA_TRUE if they are the same bytes
+ */
+static ORA_BOOL BuildCheck()
+{
+    BENCH_TEMPLATE_T notify, response;
+    ORA_CHAR         legacy[SSDP_BUFFER_LEN];
+    ORA_CHAR         dateValue[SSDP_DATE_LEN + 1];
+    time_t           dateTime = 0;
+
+    BuildTemplates( notify, response );
+    PatchDate( notify, dateTime, dateValue );
+    PatchDate( response, dateTime, dateValue );
+
+    ORA_INT32 len = LegacyBuildNotify( legacy, sizeof( legacy ) );
+    if( len != (ORA_INT32)notify.Length || memcmp( legacy, notify.Data, len ) != 0 )
+        return ORA_FALSE;
+
+    len = LegacyBuildResponse( legacy, sizeof( legacy ), dateValue );
+    return len == (ORA_INT32)response.Length && memcmp( legacy, response.Data, len ) == 0;
+}
+
+static ORA_BOOL RunBuild( ORA_UINT32 iterations )
+{
+    // 1. the same bytes go out
+    if( !BuildCheck() )
+    {
+        fprintf( stderr, "TEMPLATES DIFFER FROM THE FORMATTED MESSAGES\n" );
+        return ORA_FALSE;
+    }
+
+    BENCH_TEMPLATE_T templates[2];
+    BuildTemplates( templates[0], templates[1] );
+
+    const ORA_CHAR *pNames[2] = { "notify", "response" };
+    for( ORA_UINT32 m = 0; m < 2; m++ )
+    {
+        ORA_CHAR   legacy[SSDP_BUFFER_LEN];
+        ORA_CHAR   dateValue[SSDP_DATE_LEN + 1];
+        time_t     dateTime = 0;
+        ORA_SIZE   sink = 0;
+
+        // 2. formatted per send, DATE was left empty then
+        ORA_UINT64 begin = GetNs();
+        for( ORA_UINT32 i = 0; i < iterations; i++ )
+            sink += m == 0 ? LegacyBuildNotify( legacy, sizeof( legacy ) ) : LegacyBuildResponse( legacy, sizeof( legacy ), "" );
+        ORA_UINT64 legacyNs = GetNs() - begin;
+
+        // 3. the template is sent as it is, after DATE is patched; the byte read keeps the patch in the loop
+        begin = GetNs();
+        for( ORA_UINT32 i = 0; i < iterations; i++ )
+        {
+            PatchDate( templates[m], dateTime, dateValue );
+            sink += templates[m].Length + templates[m].Data[templates[m].Length - 1];
+        }
+        ORA_UINT64 templateNs = GetNs() - begin;
+
+        if( sink == 0 )
+            fprintf( stderr, "nothing was built\n" );
+
+        double legacyRate   = legacyNs   > 0 ? static_cast< double >( iterations ) * 1000000000 / legacyNs   : 0;
+        double templateRate = templateNs > 0 ? static_cast< double >( iterations ) * 1000000000 / templateNs : 0;
+        printf( "{\"bench\":\"build\",\"message\":\"%s\",\"bytes\":%u,\"legacy_per_s\":%.0f,\"template_per_s\":%.0f,\"speedup\":%.2f}\n",
+                pNames[m], static_cast< ORA_UINT32 >( templates[m].Length ), legacyRate, templateRate, templateRate / legacyRate );
+        fprintf( stderr, "build  %-10s %4u bytes, legacy %7.2f M msgs/s, template %8.2f M msgs/s, x%.1f\n",
+                 pNames[m], static_cast< ORA_UINT32 >( templates[m].Length ), legacyRate / 1000000, templateRate / 1000000,
+                 templateRate / legacyRate );
+    }
+    return ORA_TRUE;
+}
+
+/* Struct : AGING_EVENT, an M-SEARCH of Node, or the RESPONSE of From to Node */
+typedef struct AGING_EVENT
+{
+    ORA_INT64   Time;       // ms
+    ORA_UINT32  Node;
+    ORA_INT32   From;       // -1 for the M-SEARCH
+
+    inline bool operator>( const AGING_EVENT &other ) const
+    {
+        return Time > other.Time;
+    }
+}AGING_EVENT_T;
+
+/* Struct : AGING_RESULT, the counters of a simulated case */
+typedef struct AGING_RESULT
+{
+    ORA_UINT64  Probes;     // M-SEARCHes sent
+    ORA_UINT64  Responses;  // RESPONSEs sent
+    ORA_UINT64  Suppressed; // RESPONSEs not sent, the requester knew the responder
+    ORA_UINT64  AgedOut;    // live neighbors timed out
+}AGING_RESULT_T;
+
+/**
+ * @brief time out the neighbors of a node, as NeighborCheckTimeout() does
+ *
+ * @return the number of neighbors timed out
+ */
+static ORA_UINT32 AgingExpire( CSSDPNeighborTable &table, ORA_INT64 now )
+{
+    ORA_UINT32 count = 0;
+    while( table.Size() > 0 && table.NextDeadline() < now )
+    {
+        table.Remove( table.Earliest() );
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief every node probes at the stable interval with its jitter, and leaves the fresh neighbors,
+ * refreshed within half the neighbor timeout as BuildKnownAnswer() counts them, out of the responses.
+ * a datagram is lost at the given rate. all the nodes stay up, so every neighbor timed out is a false one.
+ * the digest is taken as exact, its false positives would only suppress more.
+ *
+ * @param bRefresh  the M-SEARCH refreshes the requester on the receivers
+ * @param loss      %, of every datagram
+ * @param result    receives the counters
+ */
+static ORA_VOID SimulateAging( ORA_BOOL bRefresh, ORA_UINT32 loss, AGING_RESULT_T &result )
+{
+    const ORA_INT64 interval = SSDP_MSEARCH_INTERVAL;
+    const ORA_INT64 timeout  = SSDP_NEIGHBOR_TIMEOUT_PROBES * SSDP_MSEARCH_INTERVAL;
+    const ORA_INT64 end      = static_cast< ORA_INT64 >( SSDP_BENCH_AGING_HOURS ) * 3600 * 1000;
+    ORA_UINT32      seed     = SSDP_BENCH_AGING_SEED;
+
+    vector< CSSDPNeighborTable > tables( SSDP_BENCH_AGING_NODES );
+    vector< string >             locations( SSDP_BENCH_AGING_NODES );
+    priority_queue< AGING_EVENT_T, vector< AGING_EVENT_T >, greater< AGING_EVENT_T > > events;
+    memset( &result, 0, sizeof( result ) );
+
+    // 1. the mesh is settled: everyone knows everyone, the probes are spread over one interval
+    for( ORA_UINT32 n = 0; n < SSDP_BENCH_AGING_NODES; n++ )
+    {
+        ORA_CHAR location[SSDP_LOCATION_LEN];
+        snprintf( location, sizeof( location ), "http://192.168.100.%u:8080/description.xml", n + 1 );
+        locations[n] = location;
+    }
+    for( ORA_UINT32 n = 0; n < SSDP_BENCH_AGING_NODES; n++ )
+    {
+        for( ORA_UINT32 peer = 0; peer < SSDP_BENCH_AGING_NODES; peer++ )
+        {
+            if( peer != n )
+                tables[n].Insert( locations[peer].data(), locations[peer].size(), timeout );
+        }
+        AGING_EVENT_T probe = { rand_r( &seed ) % interval, n, -1 };
+        events.push( probe );
+    }
+
+    // 2. run the events in time order
+    while( !events.empty() && events.top().Time < end )
+    {
+        AGING_EVENT_T event = events.top();
+        events.pop();
+        CSSDPNeighborTable &table = tables[event.Node];
+        result.AgedOut += AgingExpire( table, event.Time );
+
+        // a RESPONSE reached the requester
+        if( event.From >= 0 )
+        {
+            const string &location = locations[event.From];
+            ORA_UINT32    handle   = table.Find( location.data(), location.size() );
+            if( handle == SSDP_NBR_INVALID )
+                table.Insert( location.data(), location.size(), event.Time + timeout );
+            else
+                table.SetDeadline( handle, event.Time + timeout );
+            continue;
+        }
+
+        // an M-SEARCH of the node, every receiver answers unless the node knows it fresh
+        result.Probes++;
+        for( ORA_UINT32 peer = 0; peer < SSDP_BENCH_AGING_NODES; peer++ )
+        {
+            if( peer == event.Node || rand_r( &seed ) % 100 < loss )
+                continue;
+
+            CSSDPNeighborTable &peerTable = tables[peer];
+            result.AgedOut += AgingExpire( peerTable, event.Time );
+            if( bRefresh )
+            {
+                const string &location = locations[event.Node];
+                ORA_UINT32    handle   = peerTable.Find( location.data(), location.size() );
+                if( handle != SSDP_NBR_INVALID )
+                    peerTable.SetDeadline( handle, event.Time + timeout );
+            }
+
+            ORA_UINT32 handle = table.Find( locations[peer].data(), locations[peer].size() );
+            if( handle != SSDP_NBR_INVALID && table.At( handle ).Deadline >= event.Time + timeout / 2 )
+            {
+                result.Suppressed++;
+                continue;
+            }
+
+            result.Responses++;
+            if( rand_r( &seed ) % 100 >= loss )
+            {
+                AGING_EVENT_T response = { event.Time + rand_r( &seed ) % ( SSDP_MX_DEFAULT * 1000 ),
+                                           event.Node, static_cast< ORA_INT32 >( peer ) };
+                events.push( response );
+            }
+        }
+
+        ORA_INT64 jitter = interval * SSDP_PROBE_JITTER / 100;
+        AGING_EVENT_T probe = { event.Time + interval - jitter + rand_r( &seed ) % ( 2 * jitter + 1 ), event.Node, -1 };
+        events.push( probe );
+    }
+}
+
+static ORA_BOOL RunAging()
+{
+    static const ORA_UINT32 s_Losses[] = { 0, 5, 10, 20 };
+
+    for( ORA_UINT32 i = 0; i < ORA_COUNT_OF( s_Losses ); i++ )
+    {
+        for( ORA_UINT32 refresh = 0; refresh < 2; refresh++ )
+        {
+            AGING_RESULT_T result;
+            SimulateAging( refresh ? ORA_TRUE : ORA_FALSE, s_Losses[i], result );
+
+            double nodeHours     = static_cast< double >( SSDP_BENCH_AGING_NODES ) * SSDP_BENCH_AGING_HOURS;
+            double agedPerHour   = result.AgedOut / nodeHours;
+            double answeredRatio = result.Probes ? static_cast< double >( result.Responses ) / result.Probes : 0;
+            printf( "{\"bench\":\"aging\",\"refresh\":%u,\"loss_pct\":%u,\"nodes\":%u,\"hours\":%u,\"probes\":%llu,"
+                    "\"responses_per_probe\":%.2f,\"suppressed\":%llu,\"aged_out\":%llu,\"aged_out_per_node_hour\":%.2f}\n",
+                    refresh, s_Losses[i], SSDP_BENCH_AGING_NODES, SSDP_BENCH_AGING_HOURS,
+                    static_cast< unsigned long long >( result.Probes ), answeredRatio,
+                    static_cast< unsigned long long >( result.Suppressed ),
+                    static_cast< unsigned long long >( result.AgedOut ), agedPerHour );
+            fprintf( stderr, "aging  loss %2u%% %-10s %6.2f responses/M-SEARCH, %8.2f neighbors timed out/node/hour\n",
+                     s_Losses[i], refresh ? "refresh" : "no refresh", answeredRatio, agedPerHour );
+        }
+    }
+    return ORA_TRUE;
+}
+// END: Assistants
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: Program Entrance
+ORA_INT32 main( ORA_INT32 argc, ORA_CHAR *argv[] )
+{
+    ORA_UINT32      iterations = SSDP_BENCH_DEFAULT_ITERATIONS;
+    const ORA_CHAR *pBench     = ORA_NULL;
+
+    ORA_INT32 opt;
+    while( ( opt = getopt( argc, argv, "i:b:h" ) ) != -1 )
+    {
+        switch( opt )
+        {
+        case 'i': iterations = strtoul( optarg, ORA_NULL, 10 ); break;
+        case 'b': pBench     = optarg; break;
+
+        default:
+            Usage( argv[0] );
+            return opt == 'h' ? 0 : -1;
+        }
+    }
+
+    if( iterations < 1 )
+    {
+        Usage( argv[0] );
+        return -1;
+    }
+
+    const SSDP_BENCH_CASE_T cases[] =
+    {
+        { "notify",   s_Notify,   sizeof( s_Notify ) - 1 },
+        { "response", s_Response, sizeof( s_Response ) - 1 },
+        { "msearch",  s_Msearch,  sizeof( s_Msearch ) - 1 },
+    };
+
+    if( ( pBench == ORA_NULL || strcmp( pBench, "parser" ) == 0 ) && !RunParser( cases, ORA_COUNT_OF( cases ), iterations ) )
+        return 1;
+
+    if( ( pBench == ORA_NULL || strcmp( pBench, "scan" ) == 0 ) && !RunScan( cases, ORA_COUNT_OF( cases ), iterations ) )
+        return 1;
+
+    if( ( pBench == ORA_NULL || strcmp( pBench, "build" ) == 0 ) && !RunBuild( iterations ) )
+        return 1;
+
+    if( ( pBench == ORA_NULL || strcmp( pBench, "aging" ) == 0 ) && !RunAging() )
+        return 1;
+
+    fflush( stdout );
+    return 0;
+}
+// END: Program Entrance
+//////////////////////////////////////////////////////////////////////////////
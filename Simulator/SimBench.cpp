@@ -0,0 +1,396 @@
+#include "Base.h"
+#include "Simulator.h"
+
+#include <getopt.h>
+#include <algorithm>
+#include <fstream>
+
+#define BENCH_DEFAULT_NODES     100
+#define BENCH_DEFAULT_RUNS      20
+#define BENCH_DEFAULT_TOLERANCE 5       ///< %, for the simulated metrics, they are deterministic
+#define BENCH_DEFAULT_CPU_TOL   50      ///< %, for the CPU time, it depends on the host
+
+/* Struct : BENCH_SCENARIO, a standard scenario of the election */
+typedef struct BENCH_SCENARIO
+{
+    const ORA_CHAR *pName;
+    ORA_VOID      (*Setup)( SIM_CONFIG_T &config );
+}BENCH_SCENARIO_T;
+
+/* Struct : BENCH_RESULT, the metrics of a scenario over all its runs */
+typedef struct BENCH_RESULT
+{
+    string      Scenario;
+    ORA_UINT32  Nodes;
+    ORA_UINT32  Runs;
+    ORA_UINT32  Converged;          // runs which reached the single master
+    double      LatencyP50;         // ms from the disturbance to the single master, -1 if none converged
+    double      LatencyP90;
+    double      LatencyP99;
+    double      LatencyMax;
+    double      MsgsPerNode;        // packets sent per node and run
+    double      TransitionsPerNode; // state changes per node and run
+    double      CpuMs;              // CPU time per run
+    double      DetectP50;          // ms from the crash to the first suspicion of the master, -1 if no crash was detected
+    double      DetectP90;
+    double      FalsePerNodeHour;   // slaves leaving a live master, per node and hour of virtual time
+}BENCH_RESULT_T;
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: Scenarios
+// all the nodes boot within the boot window
+static ORA_VOID SetupColdBoot( SIM_CONFIG_T &config )
+{
+    config.Duration = 120 * 1000;
+}
+
+// the mesh settles, then its master stops dead
+static ORA_VOID SetupMasterCrash( SIM_CONFIG_T &config )
+{
+    config.CrashTime = 60 * 1000;
+    config.Duration  = 180 * 1000;
+}
+
+// the mesh boots split in two halves, which join later
+static ORA_VOID SetupPartitionHeal( SIM_CONFIG_T &config )
+{
+    SIM_PARTITION_T partition;
+    partition.Start  = 0;
+    partition.End    = 45 * 1000;
+    partition.Groups = 2;
+    config.Partitions.push_back( partition );
+    config.Duration = 165 * 1000;
+}
+
+// a tenth of the nodes join a settled mesh
+static ORA_VOID SetupLateJoiner( SIM_CONFIG_T &config )
+{
+    config.LateJoiners = config.Nodes / 10 ? config.Nodes / 10 : 1;
+    config.JoinTime    = 60 * 1000;
+    config.Duration    = 180 * 1000;
+}
+
+// a settled mesh on a lossy medium with irregular delays, the master never fails:
+// every slave leaving it is a false suspicion
+static ORA_VOID SetupLossySteady( SIM_CONFIG_T &config )
+{
+    config.Loss      = 50;
+    config.Jitter    = 300;
+    config.bRunToEnd = ORA_TRUE;
+    config.Duration  = 600 * 1000;
+}
+
+static const BENCH_SCENARIO_T s_Scenarios[] =
+{
+    { "cold_boot",      SetupColdBoot },
+    { "master_crash",   SetupMasterCrash },
+    { "partition_heal", SetupPartitionHeal },
+    { "late_joiner",    SetupLateJoiner },
+    { "lossy_steady",   SetupLossySteady },
+};
+// END: Scenarios
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: Assistants
+static ORA_VOID Usage( const ORA_CHAR *pName )
+{
+    printf( "usage: %s [options] > results.jsonl\n"
+            "  -n nodes         devices in the mesh (%u)\n"
+            "  -r runs          runs per scenario, each with its own seed (%u)\n"
+            "  -s seed          seed of the first run (1)\n"
+            "  -S scenario      run this scenario only, repeatable\n"
+            "  -b baseline      compare with the results of an earlier run, exit 2 on a regression\n"
+            "  -T percent       tolerance of the simulated metrics (%u)\n"
+            "  -U percent       tolerance of the CPU time (%u)\n"
+            "the results are written to stdout as one JSON object per scenario, the summary to stderr.\n",
+            pName, BENCH_DEFAULT_NODES, BENCH_DEFAULT_RUNS, BENCH_DEFAULT_TOLERANCE, BENCH_DEFAULT_CPU_TOL );
+}
+
+/**
+ * @brief nearest-rank percentile of sorted values
+ */
+static double Percentile( const vector< double > &sorted, ORA_UINT32 percent )
+{
+    if( sorted.empty() )
+        return -1;
+
+    ORA_SIZE rank = ( sorted.size() * percent + 99 ) / 100;
+    return sorted[ rank ? rank - 1 : 0 ];
+}
+
+/**
+ * @brief run one scenario with runs seeds
+ */
+static ORA_VOID RunScenario( const BENCH_SCENARIO_T &scenario, ORA_UINT32 nodes, ORA_UINT32 runs,
+                             ORA_UINT64 seed, BENCH_RESULT_T &result )
+{
+    vector< double > latencies, detections;
+    ORA_UINT64 sent = 0, transitions = 0, cpu = 0, falseSuspicions = 0;
+    double     nodeHours = 0;
+
+    result.Scenario  = scenario.pName;
+    result.Nodes     = nodes;
+    result.Runs      = runs;
+    result.Converged = 0;
+
+    for( ORA_UINT32 run = 0; run < runs; run++ )
+    {
+        SIM_CONFIG_T config;
+        config.Nodes = nodes;
+        config.Seed  = seed + run;
+        scenario.Setup( config );
+
+        SIM_RESULT_T simResult;
+        {
+            CSimulator simulator( config );
+            simulator.Run( simResult );
+        }
+
+        if( simResult.bConverged )
+        {
+            result.Converged++;
+            latencies.push_back( static_cast< double >( simResult.ConvergeTime - simResult.Disturbance ) );
+        }
+
+        if( simResult.DetectTime != SIM_INVALID )
+            detections.push_back( static_cast< double >( simResult.DetectTime ) );
+
+        for( ORA_UINT32 i = 0; i < simResult.Nodes.size(); i++ )
+        {
+            sent        += simResult.Nodes[i].Sent;
+            transitions += simResult.Nodes[i].Transitions;
+        }
+        cpu             += simResult.CpuTime;
+        falseSuspicions += simResult.FalseSuspicions;
+        nodeHours       += static_cast< double >( nodes ) * simResult.EndTime / ( 3600 * 1000 );
+    }
+
+    sort( latencies.begin(), latencies.end() );
+    result.LatencyP50         = Percentile( latencies, 50 );
+    result.LatencyP90         = Percentile( latencies, 90 );
+    result.LatencyP99         = Percentile( latencies, 99 );
+    result.LatencyMax         = Percentile( latencies, 100 );
+    result.MsgsPerNode        = static_cast< double >( sent ) / nodes / runs;
+    result.TransitionsPerNode = static_cast< double >( transitions ) / nodes / runs;
+    result.CpuMs              = static_cast< double >( cpu ) / 1000 / runs;
+
+    sort( detections.begin(), detections.end() );
+    result.DetectP50          = Percentile( detections, 50 );
+    result.DetectP90          = Percentile( detections, 90 );
+    result.FalsePerNodeHour   = nodeHours > 0 ? falseSuspicions / nodeHours : 0;
+}
+
+static ORA_VOID WriteResult( const BENCH_RESULT_T &result )
+{
+    printf( "{\"scenario\":\"%s\",\"nodes\":%u,\"runs\":%u,\"converged\":%u,"
+            "\"latency_p50\":%.0f,\"latency_p90\":%.0f,\"latency_p99\":%.0f,\"latency_max\":%.0f,"
+            "\"msgs_per_node\":%.3f,\"transitions_per_node\":%.3f,\"cpu_ms\":%.3f,"
+            "\"detect_p50\":%.0f,\"detect_p90\":%.0f,\"false_per_node_hour\":%.4f,"
+            "\"no_role_timeout\":%u,\"pre_role_timeout\":%u,\"master_heartbeat_timeout\":%u,\"suspicion_threshold\":%.1f}\n",
+            result.Scenario.c_str(), result.Nodes, result.Runs, result.Converged,
+            result.LatencyP50, result.LatencyP90, result.LatencyP99, result.LatencyMax,
+            result.MsgsPerNode, result.TransitionsPerNode, result.CpuMs,
+            result.DetectP50, result.DetectP90, result.FalsePerNodeHour,
+            NO_ROLE_LEISURE_TIMEOUT, PRE_ROLE_LEISURE_TIMEOUT, MASTER_HEAT_BEAT_TIMEOUT,
+            static_cast< double >( MASTER_SUSPICION_THRESHOLD ) );
+    fflush( stdout );
+
+    fprintf( stderr, "%-16s converged %3u/%-3u latency p50 %7.0f p90 %7.0f p99 %7.0f ms, "
+             "%8.2f msgs/node, %6.2f transitions/node, %9.3f ms cpu/run\n",
+             result.Scenario.c_str(), result.Converged, result.Runs,
+             result.LatencyP50, result.LatencyP90, result.LatencyP99,
+             result.MsgsPerNode, result.TransitionsPerNode, result.CpuMs );
+    if( result.DetectP50 >= 0 || result.FalsePerNodeHour > 0 )
+        fprintf( stderr, "%-16s detection p50 %7.0f p90 %7.0f ms, %8.4f false suspicions/node/hour\n", "",
+                 result.DetectP50, result.DetectP90, result.FalsePerNodeHour );
+}
+
+/**
+ * @brief read a number of a flat JSON object written by WriteResult()
+ */
+static ORA_BOOL JsonNumber( const string &line, const ORA_CHAR *pKey, double &value )
+{
+    string key = string( "\"" ) + pKey + "\":";
+    ORA_SIZE pos = line.find( key );
+    if( pos == string::npos )
+        return ORA_FALSE;
+
+    ORA_CHAR *pEnd;
+    value = strtod( line.c_str() + pos + key.size(), &pEnd );
+    return pEnd != line.c_str() + pos + key.size();
+}
+
+/**
+ * @brief compare the result with the line of the same scenario in the baseline
+ *
+ * @return the number of regressions
+ */
+static ORA_UINT32 Compare( const BENCH_RESULT_T &result, const vector< string > &baseline,
+                           ORA_UINT32 tolerance, ORA_UINT32 cpuTolerance )
+{
+    string tag = "\"scenario\":\"" + result.Scenario + "\"";
+    const string *pLine = ORA_NULL;
+    for( ORA_UINT32 i = 0; i < baseline.size(); i++ )
+    {
+        if( baseline[i].find( tag ) != string::npos )
+        {
+            pLine = &baseline[i];
+            break;
+        }
+    }
+
+    if( !pLine )
+    {
+        fprintf( stderr, "%-16s no baseline\n", result.Scenario.c_str() );
+        return 0;
+    }
+
+    double nodes, runs;
+    if( !JsonNumber( *pLine, "nodes", nodes ) || !JsonNumber( *pLine, "runs", runs ) ||
+            nodes != result.Nodes || runs != result.Runs )
+    {
+        fprintf( stderr, "%-16s baseline has another size, not compared\n", result.Scenario.c_str() );
+        return 0;
+    }
+
+    // the lower the better, except the converged runs
+    struct
+    {
+        const ORA_CHAR *pKey;
+        double          Value;
+        ORA_UINT32      Tolerance;
+    } metrics[] =
+    {
+        { "latency_p50",            result.LatencyP50,          tolerance },
+        { "latency_p90",            result.LatencyP90,          tolerance },
+        { "latency_p99",            result.LatencyP99,          tolerance },
+        { "msgs_per_node",          result.MsgsPerNode,         tolerance },
+        { "transitions_per_node",   result.TransitionsPerNode,  tolerance },
+        { "cpu_ms",                 result.CpuMs,               cpuTolerance },
+        { "detect_p50",             result.DetectP50,           tolerance },
+        { "detect_p90",             result.DetectP90,           tolerance },
+        { "false_per_node_hour",    result.FalsePerNodeHour,    tolerance },
+    };
+
+    ORA_UINT32 regressions = 0;
+    double     base;
+    if( JsonNumber( *pLine, "converged", base ) && result.Converged < base )
+    {
+        fprintf( stderr, "REGRESSION %s converged %u < baseline %.0f\n", result.Scenario.c_str(), result.Converged, base );
+        regressions++;
+    }
+
+    for( ORA_UINT32 i = 0; i < ORA_COUNT_OF( metrics ); i++ )
+    {
+        // a latency of -1 means no run converged, it's covered by the converged runs
+        if( !JsonNumber( *pLine, metrics[i].pKey, base ) || base < 0 || metrics[i].Value < 0 )
+            continue;
+
+        if( metrics[i].Value > base * ( 100 + metrics[i].Tolerance ) / 100 )
+        {
+            fprintf( stderr, "REGRESSION %s %s %.3f > baseline %.3f (+%u%%)\n", result.Scenario.c_str(),
+                     metrics[i].pKey, metrics[i].Value, base, metrics[i].Tolerance );
+            regressions++;
+        }
+    }
+    return regressions;
+}
+// END: Assistants
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: Program Entrance
+ORA_INT32 main( ORA_INT32 argc, ORA_CHAR *argv[] )
+{
+    ORA_UINT32      nodes        = BENCH_DEFAULT_NODES;
+    ORA_UINT32      runs         = BENCH_DEFAULT_RUNS;
+    ORA_UINT64      seed         = 1;
+    ORA_UINT32      tolerance    = BENCH_DEFAULT_TOLERANCE;
+    ORA_UINT32      cpuTolerance = BENCH_DEFAULT_CPU_TOL;
+    vector< string > only;
+    const ORA_CHAR *pBaseline    = ORA_NULL;
+
+    ORA_INT32 opt;
+    while( ( opt = getopt( argc, argv, "n:r:s:S:b:T:U:h" ) ) != -1 )
+    {
+        switch( opt )
+        {
+        case 'n': nodes        = strtoul( optarg, ORA_NULL, 10 ); break;
+        case 'r': runs         = strtoul( optarg, ORA_NULL, 10 ); break;
+        case 's': seed         = strtoull( optarg, ORA_NULL, 10 ); break;
+        case 'S': only.push_back( optarg ); break;
+        case 'b': pBaseline    = optarg; break;
+        case 'T': tolerance    = strtoul( optarg, ORA_NULL, 10 ); break;
+        case 'U': cpuTolerance = strtoul( optarg, ORA_NULL, 10 ); break;
+
+        default:
+            Usage( argv[0] );
+            return opt == 'h' ? 0 : -1;
+        }
+    }
+
+    if( nodes < 2 || runs < 1 )
+    {
+        Usage( argv[0] );
+        return -1;
+    }
+
+    // 1. load the baseline
+    vector< string > baseline;
+    if( pBaseline )
+    {
+        ifstream file( pBaseline );
+        if( !file )
+        {
+            fprintf( stderr, "Can't open baseline %s\n", pBaseline );
+            return -1;
+        }
+
+        string line;
+        while( getline( file, line ) )
+            baseline.push_back( line );
+    }
+
+    if( !ORAInitialize() )
+    {
+        fprintf( stderr, "Utils initialize failed! Application is exitting now." );
+        return -1;
+    }
+
+    // 2. run the scenarios
+    ORA_UINT32 regressions = 0;
+    ORA_UINT32 count       = 0;
+    for( ORA_UINT32 i = 0; i < ORA_COUNT_OF( s_Scenarios ); i++ )
+    {
+        if( !only.empty() && find( only.begin(), only.end(), s_Scenarios[i].pName ) == only.end() )
+            continue;
+
+        BENCH_RESULT_T result;
+        RunScenario( s_Scenarios[i], nodes, runs, seed, result );
+        WriteResult( result );
+        count++;
+
+        if( pBaseline )
+            regressions += Compare( result, baseline, tolerance, cpuTolerance );
+    }
+
+    ORAUninitialize();
+
+    if( count < ( only.empty() ? 1 : only.size() ) )
+    {
+        fprintf( stderr, "unknown scenario in -S\n" );
+        return -1;
+    }
+
+    if( regressions )
+    {
+        fprintf( stderr, "%u regressions against %s\n", regressions, pBaseline );
+        return 2;
+    }
+    return 0;
+}
+// END: Program Entrance
+//////////////////////////////////////////////////////////////////////////////
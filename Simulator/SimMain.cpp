@@ -0,0 +1,190 @@
+#include "Base.h"
+#include "Simulator.h"
+
+#include <getopt.h>
+
+static const ORA_CHAR *s_StateNames[CRoleManager::RST_STATE_TYPE_COUNT] =
+{
+    "none", "no_role", "definer", "pre_role", "slave", "master"
+};
+
+static ORA_VOID Usage( const ORA_CHAR *pName )
+{
+    printf( "usage: %s [options]\n"
+            "  -n nodes         devices in the mesh (%u)\n"
+            "  -l latency       ms, one way latency (%u)\n"
+            "  -j jitter        ms, added uniformly to the latency (%u)\n"
+            "  -d loss          per mille, packets lost per receiver (0)\n"
+            "  -b window        ms, the nodes boot uniformly within it (%u)\n"
+            "  -t duration      ms of virtual time (%u)\n"
+            "  -s seed          random seed (1)\n"
+            "  -p start:end:n   split the mesh into n groups between start and end ms, repeatable\n"
+            "  -c time          ms, the master crashes then\n"
+            "  -J count:time    the last count nodes join at time ms\n"
+            "  -r               keep running after the single master is reached\n"
+            "  -v               report every node\n",
+            pName, SIM_DEFAULT_NODES, SIM_DEFAULT_LATENCY, SIM_DEFAULT_JITTER,
+            SIM_DEFAULT_BOOT_WINDOW, SIM_DEFAULT_DURATION );
+}
+
+/**
+ * @brief print min / avg / max of a node counter
+ */
+static ORA_VOID ReportCounter( const ORA_CHAR *pName, const SIM_RESULT_T &result, ORA_UINT32 SIM_NODE_STATS_T::*pField )
+{
+    ORA_UINT32 min = 0xFFFFFFFF, max = 0;
+    ORA_UINT64 sum = 0;
+    for( ORA_UINT32 i = 0; i < result.Nodes.size(); i++ )
+    {
+        ORA_UINT32 value = result.Nodes[i].*pField;
+        min  = value < min ? value : min;
+        max  = value > max ? value : max;
+        sum += value;
+    }
+
+    printf( "%-16s total %llu, per node min %u / avg %.2f / max %u\n", pName,
+            static_cast< unsigned long long >( sum ), min,
+            static_cast< double >( sum ) / result.Nodes.size(), max );
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: Program Entrance
+ORA_INT32 main( ORA_INT32 argc, ORA_CHAR *argv[] )
+{
+    SIM_CONFIG_T config;
+    ORA_BOOL     bVerbose = ORA_FALSE;
+
+    ORA_INT32 opt;
+    while( ( opt = getopt( argc, argv, "n:l:j:d:b:t:s:p:c:J:rvh" ) ) != -1 )
+    {
+        switch( opt )
+        {
+        case 'n': config.Nodes      = strtoul( optarg, ORA_NULL, 10 ); break;
+        case 'l': config.Latency    = strtoul( optarg, ORA_NULL, 10 ); break;
+        case 'j': config.Jitter     = strtoul( optarg, ORA_NULL, 10 ); break;
+        case 'd': config.Loss       = strtoul( optarg, ORA_NULL, 10 ); break;
+        case 'b': config.BootWindow = strtoul( optarg, ORA_NULL, 10 ); break;
+        case 't': config.Duration   = strtoull( optarg, ORA_NULL, 10 ); break;
+        case 's': config.Seed       = strtoull( optarg, ORA_NULL, 10 ); break;
+        case 'c': config.CrashTime  = strtoull( optarg, ORA_NULL, 10 ); break;
+        case 'r': config.bRunToEnd  = ORA_TRUE; break;
+        case 'v': bVerbose          = ORA_TRUE; break;
+
+        case 'p':
+            {
+                unsigned long long start, end;
+                unsigned int       groups;
+                if( sscanf( optarg, "%llu:%llu:%u", &start, &end, &groups ) != 3 || start >= end || groups < 2 )
+                {
+                    printf( "bad partition %s\n", optarg );
+                    return -1;
+                }
+
+                SIM_PARTITION_T partition;
+                partition.Start  = start;
+                partition.End    = end;
+                partition.Groups = groups;
+                config.Partitions.push_back( partition );
+            }
+            break;
+
+        case 'J':
+            {
+                unsigned long long time;
+                if( sscanf( optarg, "%u:%llu", &config.LateJoiners, &time ) != 2 )
+                {
+                    printf( "bad late joiners %s\n", optarg );
+                    return -1;
+                }
+                config.JoinTime = time;
+            }
+            break;
+
+        default:
+            Usage( argv[0] );
+            return opt == 'h' ? 0 : -1;
+        }
+    }
+
+    if( config.Nodes < 1 || config.Loss > 1000 )
+    {
+        Usage( argv[0] );
+        return -1;
+    }
+
+    if( !ORAInitialize() )
+    {
+        printf( "Utils initialize failed! Application is exitting now." );
+        return -1;
+    }
+
+    SIM_RESULT_T result;
+    {
+        CSimulator simulator( config );
+        simulator.Run( result );
+    }
+
+    // 1. the election
+    printf( "nodes %u, latency %u+%u ms, loss %u/1000, boot window %u ms, %zu partitions, seed %llu\n",
+            config.Nodes, config.Latency, config.Jitter, config.Loss, config.BootWindow,
+            config.Partitions.size(), static_cast< unsigned long long >( config.Seed ) );
+    if( result.CrashedNode != SIM_INVALID )
+        printf( "%-16s node %u at %llu ms\n", "crash", result.CrashedNode,
+                static_cast< unsigned long long >( config.CrashTime ) );
+    if( result.bConverged )
+        printf( "%-16s %llu ms, %llu ms after the disturbance at %llu ms\n", "single master",
+                static_cast< unsigned long long >( result.ConvergeTime ),
+                static_cast< unsigned long long >( result.ConvergeTime - result.Disturbance ),
+                static_cast< unsigned long long >( result.Disturbance ) );
+    else
+        printf( "%-16s not reached in %llu ms\n", "single master", static_cast< unsigned long long >( result.EndTime ) );
+
+    // 2. the cost
+    ReportCounter( "messages sent", result, &SIM_NODE_STATS_T::Sent );
+    ReportCounter( "events sent", result, &SIM_NODE_STATS_T::EventsSent );
+    ReportCounter( "messages recv", result, &SIM_NODE_STATS_T::Received );
+    ReportCounter( "transitions", result, &SIM_NODE_STATS_T::Transitions );
+    ReportCounter( "suspicions", result, &SIM_NODE_STATS_T::Suspicions );
+    if( result.DetectTime != SIM_INVALID )
+        printf( "%-16s %llu ms after the crash, %u false suspicions\n", "detection",
+                static_cast< unsigned long long >( result.DetectTime ), result.FalseSuspicions );
+    else
+        printf( "%-16s %u false suspicions\n", "detection", result.FalseSuspicions );
+    printf( "%-16s delivered %llu, dropped %llu\n", "medium",
+            static_cast< unsigned long long >( result.Delivered ), static_cast< unsigned long long >( result.Dropped ) );
+
+    ORA_UINT32 roles[CRoleManager::RST_STATE_TYPE_COUNT] = { 0 };
+    ORA_UINT32 crashed = 0;
+    for( ORA_UINT32 i = 0; i < result.Nodes.size(); i++ )
+    {
+        if( result.Nodes[i].bCrashed )
+            crashed++;
+        else
+            roles[ result.Nodes[i].FinalState ]++;
+    }
+    printf( "%-16s", "final roles" );
+    for( ORA_UINT32 i = 0; i < CRoleManager::RST_STATE_TYPE_COUNT; i++ )
+        printf( " %s %u", s_StateNames[i], roles[i] );
+    printf( " crashed %u\n", crashed );
+
+    printf( "%-16s %llu events at %llu ms virtual, %.3f s wall, %.3f s cpu\n", "run",
+            static_cast< unsigned long long >( result.Events ), static_cast< unsigned long long >( result.EndTime ),
+            result.WallTime / 1000000.0, result.CpuTime / 1000000.0 );
+
+    // 3. the nodes
+    if( bVerbose )
+    {
+        printf( "\n%8s %10s %8s %8s %12s %s\n", "node", "device", "sent", "recv", "transitions", "role" );
+        for( ORA_UINT32 i = 0; i < result.Nodes.size(); i++ )
+        {
+            const SIM_NODE_STATS_T &node = result.Nodes[i];
+            printf( "%8u %10u %8u %8u %12u %s\n", i, SIM_DEVICE_ID_BASE + i,
+                    node.Sent, node.Received, node.Transitions, node.bCrashed ? "crashed" : s_StateNames[node.FinalState] );
+        }
+    }
+
+    ORAUninitialize();
+    return result.bConverged ? 0 : 1;
+}
+// END: Program Entrance
+//////////////////////////////////////////////////////////////////////////////
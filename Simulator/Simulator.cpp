@@ -0,0 +1,510 @@
+#include "Base.h"
+#include "Simulator.h"
+
+#include <time.h>
+
+CSimulator *CSimulator::s_pActive = ORA_NULL;
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: CSimulator::CSimNode
+CSimulator::CSimNode::CSimNode( CSimulator *pSim, ORA_UINT32 index )
+{
+    ORA_ASSERT( pSim );
+    m_pSim     = pSim;
+    m_Index    = index;
+    m_DeviceID = static_cast< DEVICE_ID_T >( SIM_DEVICE_ID_BASE + index );
+    m_bAlive   = ORA_FALSE;
+    memset( &m_Stats, 0, sizeof( m_Stats ) );
+    m_Stats.FinalState = CRoleManager::RST_NONE;
+
+    m_pRoleManager = new CRoleManager( this );
+    ORA_ASSERT( m_pRoleManager );
+    m_pRoleManager->SetDeviceID( m_DeviceID );
+}
+
+CSimulator::CSimNode::~CSimNode()
+{
+    delete m_pRoleManager;
+    m_pRoleManager = ORA_NULL;
+}
+
+ORA_VOID CSimulator::CSimNode::BroadcastDataPacket( const ORA_VOID *pPacket )
+{
+    m_pSim->Send( this, ORA_TRUE, 0, pPacket );
+}
+
+ORA_VOID CSimulator::CSimNode::UnicastDataPacket( DEVICE_ID_T targetID, const ORA_VOID *pPacket )
+{
+    // an unknown device wraps to an index beyond the nodes, and is dropped
+    m_pSim->Send( this, ORA_FALSE, static_cast< ORA_UINT32 >( targetID ) - SIM_DEVICE_ID_BASE, pPacket );
+}
+// END: CSimulator::CSimNode
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: CSimulator
+/**
+ * @brief constructor
+ *
+ * @param config    the scenario
+ */
+CSimulator::CSimulator( const SIM_CONFIG_T &config )
+    : m_Config( config )
+{
+    m_Now         = 0;
+    m_Seq         = 0;
+    m_RandomState = config.Seed;
+    m_FreePacket  = SIM_INVALID;
+    m_FreeTimer   = SIM_INVALID;
+    m_CurrNode    = SIM_INVALID;
+    m_Masters     = 0;
+    m_Slaves      = 0;
+    m_Alive       = 0;
+    m_Delivered   = 0;
+    m_Dropped     = 0;
+    m_CrashedAt   = 0;
+    m_DetectTime  = SIM_INVALID;
+    m_FalseSuspicions = 0;
+
+    // the convergence is measured from the last scheduled disturbance
+    m_Disturbance = config.CrashTime;
+    if( config.LateJoiners && config.JoinTime > m_Disturbance )
+        m_Disturbance = config.JoinTime;
+    for( ORA_UINT32 i = 0; i < config.Partitions.size(); i++ )
+    {
+        if( config.Partitions[i].End > m_Disturbance )
+            m_Disturbance = config.Partitions[i].End;
+    }
+
+    m_DelayBuckets.resize( config.Jitter + 1 );
+    m_Nodes.reserve( config.Nodes );
+    for( ORA_UINT32 i = 0; i < config.Nodes; i++ )
+        m_Nodes.push_back( new CSimNode( this, i ) );
+}
+
+CSimulator::~CSimulator()
+{
+    for( ORA_UINT32 i = 0; i < m_Nodes.size(); i++ )
+        delete m_Nodes[i];
+    m_Nodes.clear();
+
+    if( s_pActive == this )
+        s_pActive = ORA_NULL;
+}
+
+/**
+ * @brief run the scenario until the single master is reached or the duration ends
+ *
+ * @param result    the outcome of the run
+ */
+ORA_VOID CSimulator::Run( SIM_RESULT_T &result )
+{
+    ORA_ASSERT( s_pActive == ORA_NULL );
+    s_pActive = this;
+
+    timespec wallBegin, wallEnd, cpuBegin, cpuEnd;
+    clock_gettime( CLOCK_MONOTONIC, &wallBegin );
+    clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &cpuBegin );
+
+    result.bConverged   = ORA_FALSE;
+    result.Disturbance  = m_Disturbance;
+    result.ConvergeTime = 0;
+    result.Events       = 0;
+    result.CrashedNode  = SIM_INVALID;
+
+    // 1. boot the nodes within the boot window, the late joiners at the join time
+    ORA_UINT32 joinFrom = m_Config.LateJoiners < m_Nodes.size() ? m_Nodes.size() - m_Config.LateJoiners : 0;
+    for( ORA_UINT32 i = 0; i < m_Nodes.size(); i++ )
+    {
+        ORA_UINT32 delay = m_Config.BootWindow ? RandomBelow( m_Config.BootWindow ) : 0;
+        Schedule( i < joinFrom ? delay : m_Config.JoinTime, SEK_BOOT, i, 0 );
+    }
+
+    if( m_Config.CrashTime )
+        Schedule( m_Config.CrashTime, SEK_CRASH, 0, 0 );
+
+    // 2. run the events in time order
+    while( !m_Events.empty() && m_Events.top().Time <= m_Config.Duration )
+    {
+        SIM_EVENT event = m_Events.top();
+        m_Events.pop();
+        m_Now = event.Time;
+        result.Events++;
+
+        switch( event.Kind )
+        {
+        case SEK_BOOT:
+            m_Nodes[event.Node]->m_bAlive = ORA_TRUE;
+            m_Alive++;
+            m_Nodes[event.Node]->m_pRoleManager->PostState( CRoleManager::RST_NO_ROLE );
+            Drive( m_Nodes[event.Node] );
+            break;
+
+        case SEK_DELIVER:
+            // a receiver may send while being driven, which can move m_Packets
+            for( ORA_UINT32 i = 0; i < m_Packets[event.Ref].Receivers.size(); i++ )
+            {
+                const SIM_PACKET &packet = m_Packets[event.Ref];
+                CSimNode *pNode = m_Nodes[ packet.Receivers[i] ];
+                if( !pNode->m_bAlive )
+                {
+                    m_Dropped++;
+                    continue;
+                }
+
+                pNode->m_Stats.Received++;
+                m_Delivered++;
+                pNode->m_pRoleManager->RecvDataPacket( packet.Sender, &packet.Data[0], packet.Data.size() );
+                Drive( pNode );
+            }
+            ReleasePacket( event.Ref );
+            break;
+
+        case SEK_TIMER:
+            {
+                // the timer has been set again or destroyed since
+                SIM_TIMER &timer = m_Timers[event.Ref];
+                if( !timer.bInUse || timer.Gen != event.Gen )
+                    break;
+
+                ORA_UINT32 node = timer.Node;
+                if( !m_Nodes[node]->m_bAlive )
+                    break;
+
+                timer.pHandler( reinterpret_cast< ORA_HTIMER >( static_cast< ORA_INT_PTR >( event.Ref + 1 ) ), timer.pContext );
+                Drive( m_Nodes[node] );
+            }
+            break;
+
+        case SEK_CRASH:
+            result.CrashedNode = Crash();
+            m_CrashedAt        = m_Now;
+            break;
+        }
+
+        if( !result.bConverged && m_Now >= m_Disturbance && IsSingleMaster() )
+        {
+            result.bConverged   = ORA_TRUE;
+            result.ConvergeTime = m_Now;
+            if( !m_Config.bRunToEnd )
+                break;
+        }
+    }
+
+    // a mesh which went quiet before the disturbance ended is judged as it is
+    if( !result.bConverged && m_Disturbance <= m_Config.Duration && IsSingleMaster() )
+    {
+        result.bConverged   = ORA_TRUE;
+        result.ConvergeTime = m_Now > m_Disturbance ? m_Now : m_Disturbance;
+    }
+
+    // 3. collect the counters
+    clock_gettime( CLOCK_MONOTONIC, &wallEnd );
+    clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &cpuEnd );
+    result.EndTime   = ( result.bConverged && !m_Config.bRunToEnd ) ? m_Now : m_Config.Duration;
+    result.Delivered = m_Delivered;
+    result.Dropped   = m_Dropped;
+    result.DetectTime      = m_DetectTime;
+    result.FalseSuspicions = m_FalseSuspicions;
+    result.WallTime  = ( wallEnd.tv_sec - wallBegin.tv_sec ) * 1000000LL + ( wallEnd.tv_nsec - wallBegin.tv_nsec ) / 1000;
+    result.CpuTime   = ( cpuEnd.tv_sec - cpuBegin.tv_sec ) * 1000000LL + ( cpuEnd.tv_nsec - cpuBegin.tv_nsec ) / 1000;
+    result.Nodes.resize( m_Nodes.size() );
+    for( ORA_UINT32 i = 0; i < m_Nodes.size(); i++ )
+        result.Nodes[i] = m_Nodes[i]->m_Stats;
+
+    s_pActive = ORA_NULL;
+}
+
+ORA_HTIMER CSimulator::CreateTimer( ORA_VOID (*pHandler)( ORA_HTIMER, ORA_VOID* ), ORA_VOID *pContext )
+{
+    ORA_ASSERT( pHandler );
+    ORA_ASSERT( m_CurrNode < m_Nodes.size() );
+
+    ORA_UINT32 slot = m_FreeTimer;
+    if( slot == SIM_INVALID )
+    {
+        slot = m_Timers.size();
+        m_Timers.resize( slot + 1 );
+        m_Timers[slot].Gen = 0;
+    }
+    else
+    {
+        m_FreeTimer = m_Timers[slot].NextFree;
+    }
+
+    SIM_TIMER &timer = m_Timers[slot];
+    timer.pHandler = pHandler;
+    timer.pContext = pContext;
+    timer.Node     = m_CurrNode;
+    timer.bInUse   = ORA_TRUE;
+    timer.NextFree = SIM_INVALID;
+    return reinterpret_cast< ORA_HTIMER >( static_cast< ORA_INT_PTR >( slot + 1 ) );
+}
+
+ORA_VOID CSimulator::SetTimer( ORA_HTIMER hTimer, ORA_UINT32 timeout )
+{
+    ORA_UINT32 slot = static_cast< ORA_UINT32 >( reinterpret_cast< ORA_INT_PTR >( hTimer ) ) - 1;
+    ORA_ASSERT( slot < m_Timers.size() && m_Timers[slot].bInUse );
+
+    // a timer expires once, setting it again replaces the pending expiry
+    SIM_TIMER &timer = m_Timers[slot];
+    timer.Gen++;
+    Schedule( m_Now + timeout, SEK_TIMER, timer.Node, slot, timer.Gen );
+}
+
+ORA_VOID CSimulator::DestroyTimer( ORA_HTIMER hTimer )
+{
+    if( hTimer == ORA_NULL )
+        return;
+
+    ORA_UINT32 slot = static_cast< ORA_UINT32 >( reinterpret_cast< ORA_INT_PTR >( hTimer ) ) - 1;
+    ORA_ASSERT( slot < m_Timers.size() && m_Timers[slot].bInUse );
+
+    // the generation survives the reuse of the slot, so the pending expiry is dropped
+    SIM_TIMER &timer = m_Timers[slot];
+    timer.Gen++;
+    timer.bInUse   = ORA_FALSE;
+    timer.NextFree = m_FreeTimer;
+    m_FreeTimer    = slot;
+}
+
+ORA_VOID CSimulator::Schedule( ORA_UINT64 time, SimEventKind kind, ORA_UINT32 node, ORA_UINT32 ref, ORA_UINT32 gen /* = 0 */ )
+{
+    SIM_EVENT event;
+    event.Time = time;
+    event.Seq  = m_Seq++;
+    event.Kind = kind;
+    event.Node = node;
+    event.Ref  = ref;
+    event.Gen  = gen;
+    m_Events.push( event );
+}
+
+/**
+ * @brief put a packet on the medium
+ *
+ * @param pFrom       the sender node
+ * @param bBroadcast  to all the other nodes, or to target only
+ * @param target      the receiver node
+ * @param pPacket     the encoded role event
+ */
+ORA_VOID CSimulator::Send( CSimNode *pFrom, ORA_BOOL bBroadcast, ORA_UINT32 target, const ORA_VOID *pPacket )
+{
+    ORA_ASSERT( pFrom && pPacket );
+    pFrom->m_Stats.Sent++;
+
+    // 1. every receiver has its own latency and loss
+    ORA_UINT32 first = 0, last = m_Nodes.size();
+    if( !bBroadcast )
+    {
+        first = target;
+        last  = target + 1;
+        if( target >= m_Nodes.size() )
+        {
+            m_Dropped++;
+            first = last = 0;
+        }
+    }
+
+    for( ORA_UINT32 i = first; i < last; i++ )
+    {
+        if( i == pFrom->m_Index )
+            continue;
+
+        if( !m_Nodes[i]->m_bAlive || !IsConnected( pFrom->m_Index, i ) || ( m_Config.Loss && RandomBelow( 1000 ) < m_Config.Loss ) )
+        {
+            m_Dropped++;
+            continue;
+        }
+
+        ORA_UINT32 jitter = m_Config.Jitter ? RandomBelow( m_Config.Jitter + 1 ) : 0;
+        m_DelayBuckets[jitter].push_back( i );
+    }
+
+    // 2. the receivers with the same delay share one copy and one event, so a broadcast
+    // costs at most Jitter + 1 events instead of one per receiver
+    const ORA_UINT8 *pData = reinterpret_cast< const ORA_UINT8* >( pPacket );
+    ORA_SIZE         size  = CRoleEventCodec::PacketSize( pPacket );
+    for( ORA_UINT32 jitter = 0; jitter < m_DelayBuckets.size(); jitter++ )
+    {
+        if( m_DelayBuckets[jitter].empty() )
+            continue;
+
+        ORA_UINT32  slot   = AllocPacket();
+        SIM_PACKET &packet = m_Packets[slot];
+        packet.Data.assign( pData, pData + size );
+        packet.Sender = pFrom->m_DeviceID;
+        packet.Receivers.swap( m_DelayBuckets[jitter] );
+        m_DelayBuckets[jitter].clear();
+        Schedule( m_Now + m_Config.Latency + jitter, SEK_DELIVER, 0, slot );
+    }
+}
+
+/**
+ * @brief let the node process what is queued, and account its state change
+ */
+ORA_VOID CSimulator::Drive( CSimNode *pNode )
+{
+    ORA_UINT32 previous = pNode->m_Stats.FinalState;
+    ORA_UINT32 master   = previous == CRoleManager::RST_SLAVE ?
+                          static_cast< ORA_UINT32 >( pNode->m_pRoleManager->GetMasterInfo().DeviceID ) - SIM_DEVICE_ID_BASE : SIM_INVALID;
+
+    m_CurrNode = pNode->m_Index;
+    pNode->m_pRoleManager->ProcessQueue();
+    m_CurrNode = SIM_INVALID;
+
+    ORA_UINT32 current  = pNode->m_pRoleManager->CurrentState();
+    pNode->m_Stats.FinalState  = current;
+    pNode->m_Stats.Transitions = pNode->m_pRoleManager->GetStateEpoch();
+    pNode->m_Stats.EventsSent  = static_cast< ORA_UINT32 >( pNode->m_pRoleManager->GetCoalesceStats().Events );
+    if( previous == current )
+        return;
+
+    m_Masters += ( current == CRoleManager::RST_MASTER ) - ( previous == CRoleManager::RST_MASTER );
+    m_Slaves  += ( current == CRoleManager::RST_SLAVE ) - ( previous == CRoleManager::RST_SLAVE );
+
+    // a slave left its master: a detection if the master is gone, a false suspicion if not
+    if( previous == CRoleManager::RST_SLAVE )
+    {
+        pNode->m_Stats.Suspicions++;
+        if( master < m_Nodes.size() && m_Nodes[master]->m_bAlive &&
+                m_Nodes[master]->m_Stats.FinalState == CRoleManager::RST_MASTER && IsConnected( master, pNode->m_Index ) )
+            m_FalseSuspicions++;
+        else if( m_CrashedAt && m_DetectTime == SIM_INVALID )
+            m_DetectTime = m_Now - m_CrashedAt;
+    }
+}
+
+/**
+ * @brief stop the master dead: it sends nothing, and receives nothing any more.
+ * without a master, the lowest device, which the election favours, is stopped instead.
+ *
+ * @return the crashed node, SIM_INVALID if no node is alive
+ */
+ORA_UINT32 CSimulator::Crash()
+{
+    ORA_UINT32 victim = SIM_INVALID;
+    for( ORA_UINT32 i = 0; i < m_Nodes.size(); i++ )
+    {
+        if( !m_Nodes[i]->m_bAlive )
+            continue;
+
+        if( m_Nodes[i]->m_Stats.FinalState == CRoleManager::RST_MASTER )
+        {
+            victim = i;
+            break;
+        }
+
+        if( victim == SIM_INVALID )
+            victim = i;
+    }
+
+    if( victim == SIM_INVALID )
+        return SIM_INVALID;
+
+    CSimNode *pNode = m_Nodes[victim];
+    pNode->m_bAlive         = ORA_FALSE;
+    pNode->m_Stats.bCrashed = ORA_TRUE;
+    m_Alive--;
+    m_Masters -= ( pNode->m_Stats.FinalState == CRoleManager::RST_MASTER );
+    m_Slaves  -= ( pNode->m_Stats.FinalState == CRoleManager::RST_SLAVE );
+    return victim;
+}
+
+ORA_BOOL CSimulator::IsConnected( ORA_UINT32 from, ORA_UINT32 to ) const
+{
+    for( ORA_UINT32 i = 0; i < m_Config.Partitions.size(); i++ )
+    {
+        const SIM_PARTITION_T &partition = m_Config.Partitions[i];
+        if( m_Now >= partition.Start && m_Now < partition.End && partition.Groups > 1 &&
+                from % partition.Groups != to % partition.Groups )
+            return ORA_FALSE;
+    }
+    return ORA_TRUE;
+}
+
+/**
+ * @brief exactly one node is the master, and all the other live nodes follow it as slaves
+ */
+ORA_BOOL CSimulator::IsSingleMaster() const
+{
+    return m_Masters == 1 && m_Masters + m_Slaves == m_Alive;
+}
+
+ORA_UINT32 CSimulator::AllocPacket()
+{
+    ORA_UINT32 slot = m_FreePacket;
+    if( slot == SIM_INVALID )
+    {
+        slot = m_Packets.size();
+        m_Packets.resize( slot + 1 );
+    }
+    else
+    {
+        m_FreePacket = m_Packets[slot].NextFree;
+    }
+
+    m_Packets[slot].NextFree = SIM_INVALID;
+    return slot;
+}
+
+ORA_VOID CSimulator::ReleasePacket( ORA_UINT32 slot )
+{
+    // the buffers keep their capacity for the next packet
+    m_Packets[slot].NextFree = m_FreePacket;
+    m_FreePacket = slot;
+}
+
+/**
+ * @brief splitmix64, the only source of randomness of a run
+ */
+ORA_UINT64 CSimulator::Random()
+{
+    ORA_UINT64 z = ( m_RandomState += 0x9E3779B97F4A7C15ULL );
+    z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+    return z ^ ( z >> 31 );
+}
+
+ORA_UINT32 CSimulator::RandomBelow( ORA_UINT32 bound )
+{
+    ORA_ASSERT( bound > 0 );
+    return static_cast< ORA_UINT32 >( Random() % bound );
+}
+// END: CSimulator
+//////////////////////////////////////////////////////////////////////////////
+
+
+//////////////////////////////////////////////////////////////////////////////
+// BEG: Virtual Clock Timers
+// the role code of the simulator is built with ORACreateTimer / ORASetTimer / ORADestroyTimer
+// renamed to these, and with ROLE_TICK_CLOCK=SimGetTickMs (see Makefile), so its timers expire
+// and its heartbeats are timed on the virtual clock.
+ORA_HTIMER SimCreateTimer( ORA_VOID (*pHandler)( ORA_HTIMER, ORA_VOID* ), ORA_VOID *pContext )
+{
+    ORA_ASSERT( CSimulator::GetActive() );
+    return CSimulator::GetActive()->CreateTimer( pHandler, pContext );
+}
+
+ORA_BOOL SimSetTimer( ORA_HTIMER hTimer, ORA_UINT32 timeout )
+{
+    ORA_ASSERT( CSimulator::GetActive() );
+    CSimulator::GetActive()->SetTimer( hTimer, timeout );
+    return ORA_TRUE;
+}
+
+ORA_VOID SimDestroyTimer( ORA_HTIMER hTimer )
+{
+    // the role managers are deleted after the run, their timers go with the simulator
+    if( CSimulator::GetActive() )
+        CSimulator::GetActive()->DestroyTimer( hTimer );
+}
+
+ORA_UINT64 SimGetTickMs()
+{
+    ORA_ASSERT( CSimulator::GetActive() );
+    return CSimulator::GetActive()->GetNow();
+}
+// END: Virtual Clock Timers
+//////////////////////////////////////////////////////////////////////////////
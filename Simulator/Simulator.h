@@ -0,0 +1,255 @@
+#ifndef __FS_SIMULATOR_H__
+#define __FS_SIMULATOR_H__
+
+#include "RoleState.h"
+
+#include <queue>
+#include <vector>
+
+using namespace std;
+
+#define SIM_DEFAULT_NODES       100
+#define SIM_DEFAULT_LATENCY     5           ///< ms, one way
+#define SIM_DEFAULT_JITTER      3           ///< ms, added uniformly to the latency
+#define SIM_DEFAULT_BOOT_WINDOW 2000        ///< ms, the nodes boot uniformly within it
+#define SIM_DEFAULT_DURATION    ( 120 * 1000 )  ///< ms of virtual time
+#define SIM_DEVICE_ID_BASE      1000        ///< device id of node 0
+#define SIM_INVALID             0xFFFFFFFF  ///< no slot / no node
+
+/* Struct : SIM_PARTITION, the mesh is split into Groups between Start and End */
+typedef struct SIM_PARTITION
+{
+    ORA_UINT64  Start;      // ms
+    ORA_UINT64  End;        // ms
+    ORA_UINT32  Groups;     // node i is in group i % Groups
+}SIM_PARTITION_T;
+
+/* Struct : SIM_CONFIG, the scenario of a simulation run */
+typedef struct SIM_CONFIG
+{
+    ORA_UINT32  Nodes;
+    ORA_UINT32  Latency;        // ms
+    ORA_UINT32  Jitter;         // ms
+    ORA_UINT32  Loss;           // per mille, each receiver loses a packet independently
+    ORA_UINT32  BootWindow;     // ms
+    ORA_UINT64  Duration;       // ms
+    ORA_UINT64  Seed;
+    ORA_BOOL    bRunToEnd;      // keep running after the single master is reached
+    ORA_UINT64  CrashTime;      // ms, the master crashes then, 0 for no crash
+    ORA_UINT32  LateJoiners;    // the last nodes boot at JoinTime instead of the boot window
+    ORA_UINT64  JoinTime;       // ms
+    vector< SIM_PARTITION_T > Partitions;
+
+    SIM_CONFIG()
+    {
+        Nodes      = SIM_DEFAULT_NODES;
+        Latency    = SIM_DEFAULT_LATENCY;
+        Jitter     = SIM_DEFAULT_JITTER;
+        Loss       = 0;
+        BootWindow = SIM_DEFAULT_BOOT_WINDOW;
+        Duration   = SIM_DEFAULT_DURATION;
+        Seed       = 1;
+        bRunToEnd  = ORA_FALSE;
+        CrashTime  = 0;
+        LateJoiners = 0;
+        JoinTime   = 0;
+    }
+}SIM_CONFIG_T;
+
+/* Struct : SIM_NODE_STATS, the counters of one node */
+typedef struct SIM_NODE_STATS
+{
+    ORA_UINT32  Sent;           // packets sent, a broadcast is counted once
+    ORA_UINT32  EventsSent;     // role events sent, several are coalesced into one packet
+    ORA_UINT32  Received;       // packets delivered to the node
+    ORA_UINT32  Transitions;    // state changes
+    ORA_UINT32  Suspicions;     // times the node left SLAVE suspecting its master
+    ORA_UINT32  FinalState;     // CRoleManager::RoleStateType at the end
+    ORA_BOOL    bCrashed;
+}SIM_NODE_STATS_T;
+
+/* Struct : SIM_RESULT, the outcome of a simulation run */
+typedef struct SIM_RESULT
+{
+    ORA_BOOL    bConverged;     // a single master was reached after the last disturbance
+    ORA_UINT64  Disturbance;    // ms, the last crash, partition heal or late join, 0 for a cold boot
+    ORA_UINT64  ConvergeTime;   // ms, when the single master was reached after the disturbance
+    ORA_UINT64  EndTime;        // ms, the virtual time the run stopped at
+    ORA_UINT64  Events;         // simulation events processed
+    ORA_UINT64  Delivered;      // packets delivered
+    ORA_UINT64  Dropped;        // packets lost or cut by a partition
+    ORA_UINT64  WallTime;       // us, real time the run took
+    ORA_UINT64  CpuTime;        // us, process CPU time the run took
+    ORA_UINT32  CrashedNode;    // SIM_INVALID if no node crashed
+    ORA_UINT64  DetectTime;     // ms from the crash to the first slave suspecting the master, SIM_INVALID if none
+    ORA_UINT32  FalseSuspicions;    // slaves which left a master that was alive and reachable
+    vector< SIM_NODE_STATS_T > Nodes;
+}SIM_RESULT_T;
+
+/**
+ * @name CSimulator a deterministic discrete-event simulator for the role election.
+ *
+ * @note the nodes are real CRoleManager instances which are never started: they are driven
+ * by ProcessQueue() from the simulation loop, their timers run on the virtual clock (see
+ * SimCreateTimer), and their packets go through a simulated broadcast medium with latency,
+ * loss and partitions. everything runs in one thread, and every random choice comes from
+ * the seed, so a run is reproduced exactly by its configuration.
+ * @{ */
+class CSimulator
+{
+// Constructor & Destructor
+public:
+    /**
+     * @brief constructor
+     *
+     * @param config    the scenario
+     */
+    CSimulator( const SIM_CONFIG_T &config );
+    ~CSimulator();
+
+// Operations
+public:
+    /**
+     * @brief run the scenario until the single master is reached after the last disturbance,
+     * or the duration ends
+     *
+     * @param result    the outcome of the run
+     */
+    ORA_VOID Run( SIM_RESULT_T &result );
+
+    /**
+     * @brief the simulator which is running, the timer functions are routed to it
+     */
+    static inline CSimulator* GetActive()
+    {
+        return s_pActive;
+    }
+
+    /**
+     * @brief the virtual clock, the role code reads it by SimGetTickMs
+     *
+     * @return ms
+     */
+    inline ORA_UINT64 GetNow() const
+    {
+        return m_Now;
+    }
+
+// Timer (the virtual clock behind SimCreateTimer / SimSetTimer / SimDestroyTimer / SimGetTickMs)
+public:
+    ORA_HTIMER CreateTimer( ORA_VOID (*pHandler)( ORA_HTIMER, ORA_VOID* ), ORA_VOID *pContext );
+    ORA_VOID   SetTimer( ORA_HTIMER hTimer, ORA_UINT32 timeout );
+    ORA_VOID   DestroyTimer( ORA_HTIMER hTimer );
+
+// Assistant Structure
+private:
+    enum SimEventKind
+    {
+        SEK_BOOT,       ///< the node starts in NO_ROLE
+        SEK_DELIVER,    ///< a packet arrives at its receivers
+        SEK_TIMER,      ///< a timer expires
+        SEK_CRASH       ///< the master stops dead
+    };
+
+    struct SIM_EVENT
+    {
+        ORA_UINT64  Time;       ///< ms
+        ORA_UINT64  Seq;        ///< keeps the events of the same time in schedule order
+        ORA_UINT32  Kind;       ///< SimEventKind
+        ORA_UINT32  Node;       ///< SEK_BOOT: the node
+        ORA_UINT32  Ref;        ///< SEK_DELIVER: packet slot, SEK_TIMER: timer slot
+        ORA_UINT32  Gen;        ///< SEK_TIMER: the timer generation it was armed with
+
+        inline ORA_BOOL operator< ( const SIM_EVENT &other ) const
+        {
+            // the priority queue keeps the largest on top
+            return Time != other.Time ? Time > other.Time : Seq > other.Seq;
+        }
+    };
+
+    /* a packet in flight, with the receivers it arrives at the same time */
+    struct SIM_PACKET
+    {
+        vector< ORA_UINT8 >  Data;
+        DEVICE_ID_T          Sender;
+        vector< ORA_UINT32 > Receivers;
+        ORA_UINT32           NextFree;
+    };
+
+    struct SIM_TIMER
+    {
+        ORA_VOID  (*pHandler)( ORA_HTIMER, ORA_VOID* );
+        ORA_VOID   *pContext;
+        ORA_UINT32  Node;       ///< the node which created it
+        ORA_UINT32  Gen;        ///< bumped by every set and destroy, older expiries are dropped
+        ORA_BOOL    bInUse;
+        ORA_UINT32  NextFree;
+    };
+
+    /**
+     * @name CSimNode one simulated device: the role manager and its delivery interface
+     * @{ */
+    class CSimNode : public INwDataDelivery
+    {
+    public:
+        CSimNode( CSimulator *pSim, ORA_UINT32 index );
+        ~CSimNode();
+
+    // Overrides
+    public:
+        ORA_VOID BroadcastDataPacket( const ORA_VOID *pPacket );
+        ORA_VOID UnicastDataPacket( DEVICE_ID_T targetID, const ORA_VOID *pPacket );
+
+    // Properties
+    public:
+        CSimulator      *m_pSim;
+        ORA_UINT32       m_Index;
+        DEVICE_ID_T      m_DeviceID;
+        CRoleManager    *m_pRoleManager;
+        ORA_BOOL         m_bAlive;      ///< booted and not crashed
+        SIM_NODE_STATS_T m_Stats;
+    };
+    /**  @} */
+
+// Assistants
+private:
+    ORA_VOID   Schedule( ORA_UINT64 time, SimEventKind kind, ORA_UINT32 node, ORA_UINT32 ref, ORA_UINT32 gen = 0 );
+    ORA_VOID   Send( CSimNode *pFrom, ORA_BOOL bBroadcast, ORA_UINT32 target, const ORA_VOID *pPacket );
+    ORA_VOID   Drive( CSimNode *pNode );
+    ORA_UINT32 Crash();
+    ORA_BOOL   IsConnected( ORA_UINT32 from, ORA_UINT32 to ) const;
+    ORA_BOOL   IsSingleMaster() const;
+    ORA_UINT32 AllocPacket();
+    ORA_VOID   ReleasePacket( ORA_UINT32 slot );
+    ORA_UINT64 Random();
+    ORA_UINT32 RandomBelow( ORA_UINT32 bound );
+
+// Properties
+private:
+    SIM_CONFIG_T                m_Config;
+    ORA_UINT64                  m_Now;          ///< ms, the virtual clock
+    ORA_UINT64                  m_Seq;
+    ORA_UINT64                  m_RandomState;
+    priority_queue< SIM_EVENT > m_Events;
+    vector< CSimNode* >         m_Nodes;
+    vector< SIM_PACKET >        m_Packets;
+    ORA_UINT32                  m_FreePacket;
+    vector< vector< ORA_UINT32 > > m_DelayBuckets;  ///< receivers of the packet being sent, by jitter
+    vector< SIM_TIMER >         m_Timers;
+    ORA_UINT32                  m_FreeTimer;
+    ORA_UINT32                  m_CurrNode;     ///< the node being driven, it owns the timers created now
+    ORA_UINT32                  m_Masters;      ///< nodes in MASTER
+    ORA_UINT32                  m_Slaves;       ///< nodes in SLAVE
+    ORA_UINT32                  m_Alive;        ///< nodes booted and not crashed
+    ORA_UINT64                  m_Disturbance;  ///< ms, see SIM_RESULT
+    ORA_UINT64                  m_Delivered;
+    ORA_UINT64                  m_Dropped;
+    ORA_UINT64                  m_CrashedAt;    ///< ms, 0 before the crash
+    ORA_UINT64                  m_DetectTime;   ///< see SIM_RESULT
+    ORA_UINT32                  m_FalseSuspicions;
+
+    static CSimulator          *s_pActive;
+};
+/**  @} */
+
+#endif /* __FS_SIMULATOR_H__ */